@@ -0,0 +1,243 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyAdpcm.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POLLY_ADPCM_SSE2
+#endif
+
+namespace
+{
+	const char Magic[4] = { 'P', 'A', 'D', 'P' };
+	const size_t HeaderBytes = 8;
+
+	const int16_t StepSizes[89] = {
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+		50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+		337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+		2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+		15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+	};
+	const int IndexSteps[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+	// Applies `nibble` to the decoder state; the encoder runs it too, so
+	// both stay in step.
+	int16_t DecodeNibble(int nibble, int& predictor, int& index)
+	{
+		int step = StepSizes[index];
+		int diff = step >> 3;
+		if (nibble & 4) diff += step;
+		if (nibble & 2) diff += step >> 1;
+		if (nibble & 1) diff += step >> 2;
+		predictor += (nibble & 8) ? -diff : diff;
+		predictor = std::min(32767, std::max(-32768, predictor));
+		index = std::min(88, std::max(0, index + IndexSteps[nibble & 7]));
+		return static_cast<int16_t>(predictor);
+	}
+
+	int EncodeSample(int sample, int& predictor, int& index)
+	{
+		int step = StepSizes[index];
+		int diff = sample - predictor;
+		int nibble = 0;
+		if (diff < 0)
+		{
+			nibble = 8;
+			diff = -diff;
+		}
+		for (int bit = 4; bit != 0; bit >>= 1, step >>= 1)
+		{
+			if (diff >= step)
+			{
+				nibble |= bit;
+				diff -= step;
+			}
+		}
+		DecodeNibble(nibble, predictor, index);
+		return nibble;
+	}
+
+	int16_t ReadSample(const uint8_t* p)
+	{
+		return static_cast<int16_t>(p[0] | p[1] << 8);
+	}
+
+	void DecodeBlock(const uint8_t* block, int16_t* pcm)
+	{
+		int predictor = ReadSample(block);
+		int index = std::min<int>(88, block[2]);
+		pcm[0] = static_cast<int16_t>(predictor);
+		for (size_t i = 0; i < PollyAdpcm::BlockBytes - 4; i++)
+		{
+			pcm[1 + 2 * i] = DecodeNibble(block[4 + i] & 0xF, predictor, index);
+			pcm[2 + 2 * i] = DecodeNibble(block[4 + i] >> 4, predictor, index);
+		}
+	}
+
+#ifdef POLLY_ADPCM_SSE2
+	// Decodes four blocks with one block in each 32-bit lane. Only the step
+	// size lookup is done lane by lane.
+	void DecodeFourBlocks(const uint8_t* blocks, int16_t* pcm)
+	{
+		const size_t B = PollyAdpcm::BlockBytes;
+		const size_t S = PollyAdpcm::BlockSamples;
+		__m128i predictor = _mm_set_epi32(ReadSample(blocks + 3 * B), ReadSample(blocks + 2 * B),
+			ReadSample(blocks + B), ReadSample(blocks));
+		__m128i index = _mm_set_epi32(std::min<int>(88, blocks[3 * B + 2]), std::min<int>(88, blocks[2 * B + 2]),
+			std::min<int>(88, blocks[B + 2]), std::min<int>(88, blocks[2]));
+		for (int lane = 0; lane < 4; lane++)
+		{
+			pcm[lane * S] = ReadSample(blocks + lane * B);
+		}
+		const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), four = _mm_set1_epi32(4);
+		const __m128i eight = _mm_set1_epi32(8), seven = _mm_set1_epi32(7), three = _mm_set1_epi32(3);
+		const __m128i low = _mm_set1_epi32(0xF), allOnes = _mm_set1_epi32(-1);
+		const __m128i zero = _mm_setzero_si128(), maxIndex = _mm_set1_epi32(88);
+		for (size_t i = 0; i < B - 4; i++)
+		{
+			__m128i bytes = _mm_set_epi32(blocks[3 * B + 4 + i], blocks[2 * B + 4 + i], blocks[B + 4 + i], blocks[4 + i]);
+			for (int half = 0; half < 2; half++)
+			{
+				__m128i nibble = half == 0 ? _mm_and_si128(bytes, low) : _mm_srli_epi32(bytes, 4);
+				__m128i step = _mm_set_epi32(StepSizes[_mm_extract_epi16(index, 6)], StepSizes[_mm_extract_epi16(index, 4)],
+					StepSizes[_mm_extract_epi16(index, 2)], StepSizes[_mm_extract_epi16(index, 0)]);
+				__m128i diff = _mm_srli_epi32(step, 3);
+				diff = _mm_add_epi32(diff, _mm_and_si128(step, _mm_cmpeq_epi32(_mm_and_si128(nibble, four), four)));
+				diff = _mm_add_epi32(diff, _mm_and_si128(_mm_srli_epi32(step, 1),
+					_mm_cmpeq_epi32(_mm_and_si128(nibble, two), two)));
+				diff = _mm_add_epi32(diff, _mm_and_si128(_mm_srli_epi32(step, 2),
+					_mm_cmpeq_epi32(_mm_and_si128(nibble, one), one)));
+				__m128i negative = _mm_cmpeq_epi32(_mm_and_si128(nibble, eight), eight);
+				predictor = _mm_add_epi32(predictor, _mm_sub_epi32(_mm_xor_si128(diff, negative), negative));
+				// Saturate to 16 bits and widen again
+				__m128i saturated = _mm_packs_epi32(predictor, predictor);
+				predictor = _mm_srai_epi32(_mm_unpacklo_epi16(saturated, saturated), 16);
+
+				__m128i magnitude = _mm_and_si128(nibble, seven);
+				__m128i grows = _mm_cmpgt_epi32(magnitude, three);
+				__m128i growth = _mm_slli_epi32(_mm_sub_epi32(magnitude, three), 1);
+				index = _mm_add_epi32(index, _mm_or_si128(_mm_and_si128(grows, growth), _mm_andnot_si128(grows, allOnes)));
+				// The index stays within 16 bits, so the 16-bit min and max clamp it
+				index = _mm_min_epi16(_mm_max_epi16(index, zero), maxIndex);
+
+				size_t at = 1 + 2 * i + half;
+				pcm[at] = static_cast<int16_t>(_mm_extract_epi16(saturated, 0));
+				pcm[S + at] = static_cast<int16_t>(_mm_extract_epi16(saturated, 1));
+				pcm[2 * S + at] = static_cast<int16_t>(_mm_extract_epi16(saturated, 2));
+				pcm[3 * S + at] = static_cast<int16_t>(_mm_extract_epi16(saturated, 3));
+			}
+		}
+	}
+#endif
+
+	uint32_t SampleCount(const std::string& entry)
+	{
+		auto p = reinterpret_cast<const uint8_t*>(entry.data()) + sizeof(Magic);
+		return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+	}
+}
+
+std::string PollyAdpcm::Encode(const std::string& pcm)
+{
+	auto in = reinterpret_cast<const uint8_t*>(pcm.data());
+	size_t count = pcm.size() / 2;
+	size_t blocks = (count + BlockSamples - 1) / BlockSamples;
+	std::string entry(HeaderBytes + blocks * BlockBytes, '\0');
+	memcpy(&entry[0], Magic, sizeof(Magic));
+	for (int i = 0; i < 4; i++)
+	{
+		entry[sizeof(Magic) + i] = static_cast<char>((count >> (8 * i)) & 0xFF);
+	}
+
+	int index = 0;
+	for (size_t b = 0; b < blocks; b++)
+	{
+		auto block = reinterpret_cast<uint8_t*>(&entry[HeaderBytes + b * BlockBytes]);
+		size_t first = b * BlockSamples;
+		int predictor = ReadSample(in + 2 * first);
+		block[0] = in[2 * first];
+		block[1] = in[2 * first + 1];
+		block[2] = static_cast<uint8_t>(index);
+		for (size_t i = 1; i < BlockSamples && first + i < count; i++)
+		{
+			int nibble = EncodeSample(ReadSample(in + 2 * (first + i)), predictor, index);
+			block[4 + (i - 1) / 2] |= static_cast<uint8_t>(i % 2 == 1 ? nibble : nibble << 4);
+		}
+	}
+	return entry;
+}
+
+bool PollyAdpcm::IsEncoded(const std::string& entry)
+{
+	if (entry.size() < HeaderBytes || memcmp(entry.data(), Magic, sizeof(Magic)) != 0)
+	{
+		return false;
+	}
+	size_t blocks = (SampleCount(entry) + BlockSamples - 1) / BlockSamples;
+	return entry.size() == HeaderBytes + blocks * BlockBytes;
+}
+
+size_t PollyAdpcm::DecodedSize(const std::string& entry)
+{
+	return 2 * static_cast<size_t>(SampleCount(entry));
+}
+
+void PollyAdpcm::DecodeBlocks(const uint8_t* blocks, size_t count, int16_t* pcm, bool simd)
+{
+	size_t b = 0;
+#ifdef POLLY_ADPCM_SSE2
+	for (; simd && b + 4 <= count; b += 4)
+	{
+		DecodeFourBlocks(blocks + b * BlockBytes, pcm + b * BlockSamples);
+	}
+#endif
+	for (; b < count; b++)
+	{
+		DecodeBlock(blocks + b * BlockBytes, pcm + b * BlockSamples);
+	}
+}
+
+std::string PollyAdpcm::Decode(const std::string& entry)
+{
+	std::string pcm;
+	pcm.reserve(DecodedSize(entry));
+	Decode(entry, [&](const char* data, size_t size) {
+		pcm.append(data, size);
+		return true;
+	}, SIZE_MAX / 2);
+	return pcm;
+}
+
+bool PollyAdpcm::Decode(const std::string& entry, const Sink& sink, size_t pieceBytes)
+{
+	size_t count = SampleCount(entry);
+	size_t blocks = (count + BlockSamples - 1) / BlockSamples;
+	// Whole groups of four blocks, so that every piece takes the SSE2 path
+	size_t pieceBlocks = std::max<size_t>(4, pieceBytes / (2 * BlockSamples) / 4 * 4);
+	std::vector<int16_t> pcm(std::min(pieceBlocks, blocks) * BlockSamples);
+	auto data = reinterpret_cast<const uint8_t*>(entry.data()) + HeaderBytes;
+	for (size_t b = 0; b < blocks; b += pieceBlocks)
+	{
+		size_t n = std::min(pieceBlocks, blocks - b);
+		DecodeBlocks(data + b * BlockBytes, n, pcm.data());
+		size_t samples = std::min(n * BlockSamples, count - b * BlockSamples);
+		// The engine's PCM is little-endian, as is every Windows target
+		if (!sink(reinterpret_cast<const char*>(pcm.data()), 2 * samples))
+		{
+			return false;
+		}
+	}
+	return true;
+}
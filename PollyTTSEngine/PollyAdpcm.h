@@ -0,0 +1,52 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// IMA-ADPCM for cached 16-bit PCM: 4 bits a sample, a little over a quarter
+// of the size, with no audible loss for speech. As in WAV files, the audio
+// is coded in blocks that each start from a sample stored as it is, so
+// blocks decode independently: several at once with SSE2, and a few at a
+// time when streaming.
+//
+// An entry is "PADP", the sample count (32-bit little-endian) and the
+// blocks of BlockBytes bytes. The last block is padded.
+class PollyAdpcm
+{
+public:
+	static const size_t BlockBytes = 256;
+	static const size_t BlockSamples = 1 + 2 * (BlockBytes - 4);
+
+	// Receives decoded PCM. Returning false stops decoding.
+	typedef std::function<bool(const char* data, size_t size)> Sink;
+
+	// Encodes 16-bit little-endian PCM; a trailing odd byte is dropped.
+	static std::string Encode(const std::string& pcm);
+
+	// True if `entry` is an encoded entry rather than PCM.
+	static bool IsEncoded(const std::string& entry);
+	// Bytes of PCM that `entry` decodes to
+	static size_t DecodedSize(const std::string& entry);
+
+	static std::string Decode(const std::string& entry);
+	// Decodes in pieces of about `pieceBytes` bytes of PCM, each passed to
+	// `sink` as soon as it is ready. Returns false if `sink` stopped.
+	static bool Decode(const std::string& entry, const Sink& sink, size_t pieceBytes = 64 * 1024);
+
+	// Decodes `count` whole blocks to BlockSamples samples each. Exposed
+	// for the benchmark, with `simd` false for the one-block-at-a-time path.
+	static void DecodeBlocks(const uint8_t* blocks, size_t count, int16_t* pcm, bool simd = true);
+};
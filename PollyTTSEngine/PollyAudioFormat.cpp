@@ -0,0 +1,171 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyAudioFormat.h"
+
+namespace
+{
+	// Reference encoders. They take the top 14 (mu-law) or 13 (A-law) bits
+	// of the sample, one's complement for negative samples as in the ITU-T
+	// G.191 reference, and search for the segment; they only fill the tables.
+	uint8_t ReferenceMuLaw(int16_t sample)
+	{
+		static const int segmentEnds[8] = { 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF };
+		int value = sample >> 2;
+		uint8_t mask = 0xFF;
+		if (value < 0)
+		{
+			value = ~value;
+			mask = 0x7F;
+		}
+		if (value > 8159)
+		{
+			value = 8159;
+		}
+		value += 0x84 >> 2;
+		int segment = 0;
+		while (segment < 8 && value > segmentEnds[segment])
+		{
+			segment++;
+		}
+		if (segment >= 8)
+		{
+			return 0x7F ^ mask;
+		}
+		return static_cast<uint8_t>(((segment << 4) | ((value >> (segment + 1)) & 0xF)) ^ mask);
+	}
+
+	uint8_t ReferenceALaw(int16_t sample)
+	{
+		static const int segmentEnds[8] = { 0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF };
+		int value = sample >> 3;
+		uint8_t mask = 0xD5;
+		if (value < 0)
+		{
+			value = ~value;
+			mask = 0x55;
+		}
+		int segment = 0;
+		while (segment < 8 && value > segmentEnds[segment])
+		{
+			segment++;
+		}
+		if (segment >= 8)
+		{
+			return 0x7F ^ mask;
+		}
+		int quantized = segment < 2 ? (value >> 1) & 0xF : (value >> segment) & 0xF;
+		return static_cast<uint8_t>(((segment << 4) | quantized) ^ mask);
+	}
+
+	// Code for every value of the bits the encoder looks at, indexed by the
+	// sample's unsigned bit pattern shifted right: 16 KB for mu-law, 8 KB for A-law
+	template <int Shift>
+	struct G711Table
+	{
+		uint8_t codes[0x10000 >> Shift];
+
+		explicit G711Table(uint8_t (*encode)(int16_t))
+		{
+			for (uint32_t i = 0; i < sizeof(codes); i++)
+			{
+				codes[i] = encode(static_cast<int16_t>(static_cast<uint16_t>(i << Shift)));
+			}
+		}
+	};
+
+	template <int Shift>
+	void EncodeG711(const G711Table<Shift>& table, const char* pcm, size_t count, char* out)
+	{
+		static const size_t Block = 16;
+		auto in = reinterpret_cast<const uint8_t*>(pcm);
+		auto codes = reinterpret_cast<uint8_t*>(out);
+		size_t i = 0;
+		// Table indexes for a block are computed together, then looked up
+		for (; i + Block <= count; i += Block)
+		{
+			uint16_t index[Block];
+			for (size_t j = 0; j < Block; j++)
+			{
+				index[j] = static_cast<uint16_t>((in[2 * (i + j)] | in[2 * (i + j) + 1] << 8) >> Shift);
+			}
+			for (size_t j = 0; j < Block; j++)
+			{
+				codes[i + j] = table.codes[index[j]];
+			}
+		}
+		for (; i < count; i++)
+		{
+			codes[i] = table.codes[(in[2 * i] | in[2 * i + 1] << 8) >> Shift];
+		}
+	}
+}
+
+const char* PollyAudio::SampleRate(PollyAudioFormat format)
+{
+	return format == PollyAudioFormat::Pcm16k ? "16000" : "8000";
+}
+
+const char* PollyAudio::CacheKind(PollyAudioFormat format)
+{
+	switch (format)
+	{
+	case PollyAudioFormat::Pcm8k:
+		return "pcm8000";
+	case PollyAudioFormat::MuLaw8k:
+		return "mulaw8000";
+	case PollyAudioFormat::ALaw8k:
+		return "alaw8000";
+	default:
+		return "pcm16000";
+	}
+}
+
+uint32_t PollyAudio::BytesPerMs(PollyAudioFormat format)
+{
+	return (format == PollyAudioFormat::Pcm16k ? 16 : 8) * SampleBytes(format);
+}
+
+uint32_t PollyAudio::SampleBytes(PollyAudioFormat format)
+{
+	return format == PollyAudioFormat::MuLaw8k || format == PollyAudioFormat::ALaw8k ? 1 : 2;
+}
+
+std::string PollyAudio::Encode(PollyAudioFormat format, const std::string& pcm)
+{
+	size_t count = pcm.size() / 2;
+	if (SampleBytes(format) == 2)
+	{
+		return pcm.size() % 2 == 0 ? pcm : pcm.substr(0, 2 * count);
+	}
+	std::string encoded(count, '\0');
+	if (format == PollyAudioFormat::MuLaw8k)
+	{
+		EncodeMuLaw(pcm.data(), count, &encoded[0]);
+	}
+	else
+	{
+		EncodeALaw(pcm.data(), count, &encoded[0]);
+	}
+	return encoded;
+}
+
+void PollyAudio::EncodeMuLaw(const char* pcm, size_t count, char* out)
+{
+	static const G711Table<2> table(ReferenceMuLaw);
+	EncodeG711(table, pcm, count, out);
+}
+
+void PollyAudio::EncodeALaw(const char* pcm, size_t count, char* out)
+{
+	static const G711Table<3> table(ReferenceALaw);
+	EncodeG711(table, pcm, count, out);
+}
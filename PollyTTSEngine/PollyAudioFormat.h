@@ -0,0 +1,51 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Formats the engine renders in. Polly returns 16-bit little-endian PCM at
+// 8 or 16 kHz; the G.711 formats that telephony sinks want are encoded here
+// from 8 kHz PCM, so SAPI has nothing left to convert.
+enum class PollyAudioFormat
+{
+	Pcm16k,
+	Pcm8k,
+	MuLaw8k,
+	ALaw8k,
+};
+
+class PollyAudio
+{
+public:
+	// Value for SynthesizeSpeechRequest::SetSampleRate
+	static const char* SampleRate(PollyAudioFormat format);
+	// Output kind in cache keys. Each format is cached already encoded;
+	// Pcm16k is PollyPhraseStore::PcmOutput.
+	static const char* CacheKind(PollyAudioFormat format);
+	static uint32_t BytesPerMs(PollyAudioFormat format);
+	// Bytes per sample of the format
+	static uint32_t SampleBytes(PollyAudioFormat format);
+
+	// Converts `pcm`, as Polly returned it for `format`, to `format`.
+	// PCM is returned unchanged; a trailing odd byte is dropped.
+	static std::string Encode(PollyAudioFormat format, const std::string& pcm);
+
+	// G.711 encoders, bit-exact with the ITU-T G.191 reference: `count`
+	// 16-bit little-endian samples from `pcm` to `count` bytes in `out`.
+	// Each sample is one load from a table that fits in the L1 cache, with
+	// no branches, in blocks the compiler vectorizes.
+	static void EncodeMuLaw(const char* pcm, size_t count, char* out);
+	static void EncodeALaw(const char* pcm, size_t count, char* out);
+};
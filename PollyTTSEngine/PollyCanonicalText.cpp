@@ -0,0 +1,278 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyCanonicalText.h"
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+	}
+
+	bool StartsWithIgnoreCase(const std::string& text, size_t at, const char* prefix)
+	{
+		for (; *prefix != '\0'; prefix++, at++)
+		{
+			if (at >= text.size() || std::tolower(static_cast<unsigned char>(text[at])) != *prefix)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Appends [begin, end) with each run of whitespace made a single space,
+	// or a single line break if the run had one. A run that would follow
+	// whitespace already in `out` is dropped.
+	void AppendCollapsed(std::string& out, const std::string& text, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; )
+		{
+			if (!IsSpace(text[i]))
+			{
+				out += text[i++];
+				continue;
+			}
+			char separator = ' ';
+			for (; i < end && IsSpace(text[i]); i++)
+			{
+				if (text[i] == '\n')
+				{
+					separator = '\n';
+				}
+			}
+			if (!out.empty() && !IsSpace(out.back()))
+			{
+				out += separator;
+			}
+		}
+	}
+
+	void TrimRight(std::string& text, size_t floor)
+	{
+		while (text.size() > floor && IsSpace(text.back()))
+		{
+			text.pop_back();
+		}
+	}
+
+	// Index of the '>' that ends the tag starting at `begin`, skipping
+	// quoted attribute values
+	size_t TagEnd(const std::string& text, size_t begin, size_t end)
+	{
+		char quote = '\0';
+		for (size_t i = begin + 1; i < end; i++)
+		{
+			if (quote != '\0')
+			{
+				quote = text[i] == quote ? '\0' : quote;
+			}
+			else if (text[i] == '"' || text[i] == '\'')
+			{
+				quote = text[i];
+			}
+			else if (text[i] == '>')
+			{
+				return i;
+			}
+		}
+		return std::string::npos;
+	}
+
+	// Rewrites the SSML document in [begin, end); false if it cannot be
+	// taken apart safely
+	bool CanonicalizeSsml(const std::string& text, size_t begin, size_t end, std::string& out, bool& plain)
+	{
+		int speakDepth = 0;
+		size_t contentStart = 0;
+		size_t contentEnd = std::string::npos;
+		bool rootAttributes = false;
+		bool markup = false;
+		for (size_t pos = begin; pos < end; )
+		{
+			if (text[pos] != '<')
+			{
+				size_t next = std::min(text.find('<', pos), end);
+				if (speakDepth == 0)
+				{
+					return false;
+				}
+				markup = markup || text.find('&', pos) < next;
+				// Whitespace at the start of the document is not spoken
+				while (out.size() == contentStart && pos < next && IsSpace(text[pos]))
+				{
+					pos++;
+				}
+				AppendCollapsed(out, text, pos, next);
+				pos = next;
+				continue;
+			}
+			if (text.compare(pos, 4, "<!--") == 0)
+			{
+				size_t close = text.find("-->", pos + 4);
+				if (close == std::string::npos || close + 3 > end)
+				{
+					return false;
+				}
+				pos = close + 3;
+				continue;
+			}
+			size_t close = TagEnd(text, pos, end);
+			if (close == std::string::npos)
+			{
+				return false;
+			}
+			bool closing = text[pos + 1] == '/';
+			size_t nameStart = pos + (closing ? 2 : 1);
+			size_t nameEnd = nameStart;
+			while (nameEnd < close && !IsSpace(text[nameEnd]) && text[nameEnd] != '/')
+			{
+				nameEnd++;
+			}
+			std::string name = text.substr(nameStart, nameEnd - nameStart);
+			std::transform(name.begin(), name.end(), name.begin(),
+				[](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			bool selfClosing = text[close - 1] == '/';
+			pos = close + 1;
+
+			if (name != "speak" || name.empty())
+			{
+				if (speakDepth == 0 || name.empty() || name[0] == '!' || name[0] == '?')
+				{
+					return false;
+				}
+				out.append(closing ? "</" : "<").append(name).append(text, nameEnd, close + 1 - nameEnd);
+				markup = true;
+				continue;
+			}
+			if (selfClosing)
+			{
+				return false;
+			}
+			if (!closing)
+			{
+				// Only the outermost <speak> is kept
+				if (speakDepth++ == 0)
+				{
+					std::string attributes = text.substr(nameEnd, close - nameEnd);
+					rootAttributes = std::any_of(attributes.begin(), attributes.end(), [](char c) { return !IsSpace(c); });
+					out.append("<speak").append(rootAttributes ? attributes : "").append(">");
+					contentStart = out.size();
+				}
+				continue;
+			}
+			if (speakDepth == 0)
+			{
+				return false;
+			}
+			if (--speakDepth == 0)
+			{
+				TrimRight(out, contentStart);
+				contentEnd = out.size();
+				out.append("</speak>");
+				// Nothing may follow the document but whitespace
+				for (; pos < end; pos++)
+				{
+					if (!IsSpace(text[pos]))
+					{
+						return false;
+					}
+				}
+				break;
+			}
+		}
+		if (contentEnd == std::string::npos)
+		{
+			return false;
+		}
+		// Plain text between the tags is billed and spoken the same without them
+		plain = !markup && !rootAttributes && contentEnd > contentStart;
+		if (plain)
+		{
+			out = out.substr(contentStart, contentEnd - contentStart);
+		}
+		return true;
+	}
+}
+
+PollyCanonicalText PollyCanonicalText::Canonicalize(const std::string& text)
+{
+	PollyCanonicalText result;
+	size_t begin = 0;
+	size_t end = text.size();
+	while (begin < end && IsSpace(text[begin]))
+	{
+		begin++;
+	}
+	while (end > begin && IsSpace(text[end - 1]))
+	{
+		end--;
+	}
+	bool inputSsml = StartsWithIgnoreCase(text, begin, "<speak");
+
+	size_t root = begin;
+	if (text.compare(begin, 5, "<?xml") == 0)
+	{
+		size_t declarationEnd = text.find("?>", begin);
+		root = declarationEnd == std::string::npos || declarationEnd >= end ? begin : declarationEnd + 2;
+		while (root < end && IsSpace(text[root]))
+		{
+			root++;
+		}
+	}
+	bool ssml = StartsWithIgnoreCase(text, root, "<speak") && root + 6 < end &&
+		(text[root + 6] == '>' || IsSpace(text[root + 6]));
+
+	bool plain = false;
+	if (!ssml)
+	{
+		AppendCollapsed(result.Text, text, begin, end);
+		result.Ssml = inputSsml;
+	}
+	else if (CanonicalizeSsml(text, root, end, result.Text, plain))
+	{
+		result.Ssml = !plain;
+	}
+	else
+	{
+		result.Text = text.substr(begin, end - begin);
+		result.Ssml = inputSsml;
+	}
+
+	size_t billedBefore = BilledCharacters(text, inputSsml);
+	size_t billedAfter = BilledCharacters(result.Text, result.Ssml);
+	result.SavedCharacters = billedBefore > billedAfter ? billedBefore - billedAfter : 0;
+	result.SavedBytes = text.size() > result.Text.size() ? text.size() - result.Text.size() : 0;
+	return result;
+}
+
+size_t PollyCanonicalText::BilledCharacters(const std::string& text, bool ssml)
+{
+	size_t characters = 0;
+	bool inTag = false;
+	for (char c : text)
+	{
+		if (ssml && (c == '<' || c == '>'))
+		{
+			inTag = c == '<';
+			continue;
+		}
+		// Count code points, not UTF-8 continuation bytes
+		if (!inTag && (static_cast<unsigned char>(c) & 0xC0) != 0x80)
+		{
+			characters++;
+		}
+	}
+	return characters;
+}
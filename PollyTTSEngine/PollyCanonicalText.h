@@ -0,0 +1,40 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+// The shortest text that Polly speaks and bills the same way as the one
+// SAPI gave us, so that trivially different inputs share one request and
+// one cache entry:
+// - outer whitespace is trimmed and runs of whitespace become one space,
+//   or one line break if the run had any;
+// - an XML declaration and comments are dropped and element names are
+//   lower-cased, so <SPEAK> and <speak> are the same;
+// - nested <speak> elements are unwrapped, and a <speak> wrapper around
+//   plain text that needs no escaping is removed altogether.
+// Input that is not well-formed enough to take apart is only trimmed.
+struct PollyCanonicalText
+{
+	std::string Text;
+	bool Ssml = false;
+	// Billed characters, and payload characters, that the canonical form saves
+	size_t SavedCharacters = 0;
+	size_t SavedBytes = 0;
+
+	static PollyCanonicalText Canonicalize(const std::string& text);
+
+	// Characters Polly bills for: all of plain text, and for SSML only the
+	// text between tags
+	static size_t BilledCharacters(const std::string& text, bool ssml);
+};
@@ -0,0 +1,87 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyConfig.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+static const char* ENV_PREFIX = "POLLY_TTS_";
+#ifdef _WIN32
+static const char* REGISTRY_KEY = "SOFTWARE\\Amazon\\PollyTTS";
+#endif
+
+bool PollyConfig::Lookup(const char* name, std::string& value)
+{
+	std::string envName = std::string(ENV_PREFIX) + name;
+#ifdef _WIN32
+	char* envValue = nullptr;
+	size_t envLength = 0;
+	if (_dupenv_s(&envValue, &envLength, envName.c_str()) == 0 && envValue != nullptr)
+	{
+		value = envValue;
+		free(envValue);
+		return true;
+	}
+
+	for (HKEY root : { HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE })
+	{
+		char buffer[1024];
+		DWORD size = sizeof(buffer);
+		if (RegGetValueA(root, REGISTRY_KEY, name, RRF_RT_REG_SZ, nullptr, buffer, &size) == ERROR_SUCCESS)
+		{
+			value = buffer;
+			return true;
+		}
+	}
+	return false;
+#else
+	const char* envValue = std::getenv(envName.c_str());
+	if (envValue == nullptr)
+	{
+		return false;
+	}
+	value = envValue;
+	return true;
+#endif
+}
+
+std::string PollyConfig::GetString(const char* name, const std::string& defaultValue)
+{
+	std::string value;
+	return Lookup(name, value) ? value : defaultValue;
+}
+
+long PollyConfig::GetLong(const char* name, long defaultValue)
+{
+	std::string value;
+	if (!Lookup(name, value) || value.empty())
+	{
+		return defaultValue;
+	}
+	char* end = nullptr;
+	long parsed = strtol(value.c_str(), &end, 10);
+	return (end != nullptr && *end == '\0') ? parsed : defaultValue;
+}
+
+bool PollyConfig::GetBool(const char* name, bool defaultValue)
+{
+	std::string value;
+	if (!Lookup(name, value) || value.empty())
+	{
+		return defaultValue;
+	}
+	return value == "1" || value == "true" || value == "TRUE" || value == "yes" || value == "on";
+}
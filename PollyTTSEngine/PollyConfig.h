@@ -0,0 +1,28 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <string>
+
+// Engine settings. A setting called "METRICS_FILE" is read from the
+// POLLY_TTS_METRICS_FILE environment variable first and, on Windows, from the
+// METRICS_FILE string value under HKCU and then HKLM\SOFTWARE\Amazon\PollyTTS.
+class PollyConfig
+{
+public:
+	static std::string GetString(const char* name, const std::string& defaultValue = "");
+	static long GetLong(const char* name, long defaultValue);
+	static bool GetBool(const char* name, bool defaultValue);
+
+private:
+	static bool Lookup(const char* name, std::string& value);
+};
@@ -0,0 +1,70 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyCredentials.h"
+#include "PollyConfig.h"
+#include "PollyLog.h"
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static const char* ALLOCATION_TAG = "PollyTTSEngine::Credentials";
+
+std::shared_ptr<PollyCredentialsProvider> PollyCredentialsProvider::Instance()
+{
+	static std::shared_ptr<PollyCredentialsProvider> instance(new PollyCredentialsProvider());
+	return instance;
+}
+
+PollyCredentialsProvider::PollyCredentialsProvider()
+	: m_loaded(false), m_credentialsModified(0), m_configModified(0)
+{
+	m_profile = PollyConfig::GetString("PROFILE", "polly-windows");
+	m_checkInterval = std::chrono::milliseconds(std::max(0L, PollyConfig::GetLong("CREDENTIALS_CHECK_MS", 1000)));
+}
+
+int64_t PollyCredentialsProvider::ModifiedTime(const Aws::String& path)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	return _stat64(path.c_str(), &info) == 0 ? static_cast<int64_t>(info.st_mtime) : 0;
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? static_cast<int64_t>(info.st_mtime) : 0;
+#endif
+}
+
+Aws::Auth::AWSCredentials PollyCredentialsProvider::GetAWSCredentials()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto now = std::chrono::steady_clock::now();
+	if (m_loaded && now - m_lastCheck < m_checkInterval)
+	{
+		return m_credentials;
+	}
+	m_lastCheck = now;
+
+	auto credentialsModified = ModifiedTime(Aws::Auth::ProfileConfigFileAWSCredentialsProvider::GetCredentialsProfileFilename());
+	auto configModified = ModifiedTime(Aws::Auth::ProfileConfigFileAWSCredentialsProvider::GetConfigProfileFilename());
+	if (m_loaded && credentialsModified == m_credentialsModified && configModified == m_configModified)
+	{
+		return m_credentials;
+	}
+
+	POLLY_LOG_DEBUG(PollyLog::Get(), "Loading credentials for profile {}", m_profile);
+	// A fresh provider, so that the files are parsed now rather than on its own refresh schedule
+	auto profile = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>(ALLOCATION_TAG, m_profile.c_str());
+	m_credentials = profile->GetAWSCredentials();
+	m_credentialsModified = credentialsModified;
+	m_configModified = configModified;
+	m_loaded = true;
+	return m_credentials;
+}
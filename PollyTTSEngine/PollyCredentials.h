@@ -0,0 +1,48 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <aws/core/auth/AWSCredentialsProvider.h>
+
+// Process-wide credentials for the PROFILE profile (default
+// "polly-windows"). The shared credentials and config files are parsed
+// once; after that the provider only compares their modification times,
+// at most once every CREDENTIALS_CHECK_MS, and parses them again when
+// either file has changed.
+class PollyCredentialsProvider : public Aws::Auth::AWSCredentialsProvider
+{
+public:
+	static std::shared_ptr<PollyCredentialsProvider> Instance();
+
+	Aws::Auth::AWSCredentials GetAWSCredentials() override;
+
+	const std::string& Profile() const { return m_profile; }
+
+private:
+	PollyCredentialsProvider();
+
+	static int64_t ModifiedTime(const Aws::String& path);
+
+	std::string m_profile;
+	std::chrono::milliseconds m_checkInterval;
+	std::mutex m_lock;
+	bool m_loaded;
+	Aws::Auth::AWSCredentials m_credentials;
+	int64_t m_credentialsModified;
+	int64_t m_configModified;
+	std::chrono::steady_clock::time_point m_lastCheck;
+};
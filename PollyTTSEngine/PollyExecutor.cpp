@@ -0,0 +1,224 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyExecutor.h"
+#include "PollyConfig.h"
+#include <algorithm>
+
+PollyExecutor& PollyExecutor::Shared()
+{
+	// Never destroyed: the DLL stays pinned, so the threads can safely
+	// outlive every engine object, as the warm-up thread does
+	static PollyExecutor* executor = new PollyExecutor(
+		static_cast<size_t>(std::max(1L, PollyConfig::GetLong("EXECUTOR_THREADS", 4))),
+		static_cast<size_t>(std::max(1L, PollyConfig::GetLong("BLOCKING_THREADS", 4))));
+	return *executor;
+}
+
+PollyExecutor::PollyExecutor(size_t threads, size_t blockingThreads)
+	: m_stopping(false)
+{
+	if (blockingThreads > 0)
+	{
+		m_blocking.reset(new PollyExecutor(blockingThreads));
+	}
+	for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+	{
+		m_threads.emplace_back(&PollyExecutor::Run, this);
+	}
+}
+
+PollyExecutor::~PollyExecutor()
+{
+	// First, as the blocking calls move back to this pool when they finish
+	m_blocking.reset();
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stopping = true;
+	}
+	m_changed.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void PollyExecutor::Post(std::function<void()> work)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_ready.push_back(std::move(work));
+	}
+	m_changed.notify_one();
+}
+
+void PollyExecutor::PostAfter(Clock::duration delay, std::function<void()> work)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_timers.emplace(Clock::now() + delay, std::move(work));
+	}
+	// The waking thread works out the next deadline again
+	m_changed.notify_one();
+}
+
+void PollyExecutor::Run()
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	for (;;)
+	{
+		auto now = Clock::now();
+		while (!m_timers.empty() && m_timers.begin()->first <= now)
+		{
+			m_ready.push_back(std::move(m_timers.begin()->second));
+			m_timers.erase(m_timers.begin());
+		}
+		if (!m_ready.empty())
+		{
+			auto work = std::move(m_ready.front());
+			m_ready.pop_front();
+			// Another thread picks up the rest while this one works
+			if (!m_ready.empty())
+			{
+				m_changed.notify_one();
+			}
+			guard.unlock();
+			work();
+			guard.lock();
+			continue;
+		}
+		if (m_stopping)
+		{
+			return;
+		}
+		if (m_timers.empty())
+		{
+			m_changed.wait(guard);
+		}
+		else
+		{
+			// A copy: another thread can run the timer while this one waits
+			auto deadline = m_timers.begin()->first;
+			m_changed.wait_until(guard, deadline);
+		}
+	}
+}
+
+void PollyAsyncEvent::Set()
+{
+	std::vector<Waiter> waiters;
+	{
+		std::lock_guard<std::mutex> guard(m_state->Lock);
+		if (m_state->IsSet)
+		{
+			return;
+		}
+		m_state->IsSet = true;
+		waiters.swap(m_state->Waiters);
+	}
+	for (auto& waiter : waiters)
+	{
+		if (!waiter.Claimed->exchange(true))
+		{
+			auto handle = waiter.Handle;
+			PollyExecutor::Shared().Post([handle]() { handle.resume(); });
+		}
+	}
+}
+
+bool PollyAsyncEvent::IsSet() const
+{
+	std::lock_guard<std::mutex> guard(m_state->Lock);
+	return m_state->IsSet;
+}
+
+PollyAsyncEvent::Awaiter PollyAsyncEvent::Wait() const
+{
+	Awaiter awaiter;
+	awaiter.Event = m_state;
+	awaiter.Timeout = PollyExecutor::Clock::duration::zero();
+	awaiter.HasTimeout = false;
+	return awaiter;
+}
+
+PollyAsyncEvent::Awaiter PollyAsyncEvent::WaitFor(PollyExecutor::Clock::duration timeout) const
+{
+	Awaiter awaiter = Wait();
+	awaiter.Timeout = timeout;
+	awaiter.HasTimeout = true;
+	return awaiter;
+}
+
+bool PollyAsyncEvent::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	RequestId = PollyTrace::CurrentRequestId();
+	// Once the waiter is listed the coroutine can resume on another thread,
+	// and this awaiter lives in its frame, so nothing of it is used after
+	bool hasTimeout = HasTimeout;
+	auto timeout = Timeout;
+	auto claimed = std::make_shared<std::atomic<bool>>(false);
+	{
+		std::lock_guard<std::mutex> guard(Event->Lock);
+		if (Event->IsSet)
+		{
+			// Set since await_ready; carry on without suspending
+			return false;
+		}
+		Event->Waiters.push_back(Waiter{ handle, claimed });
+	}
+	if (hasTimeout)
+	{
+		// Only the claim is shared with the timer, so the event and the
+		// waiter can both be gone by the time it fires
+		PollyExecutor::Shared().PostAfter(timeout, [handle, claimed]() {
+			if (!claimed->exchange(true))
+			{
+				handle.resume();
+			}
+		});
+	}
+	return true;
+}
+
+void PollyCallerLoop::Post(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_ready.push_back(handle);
+	m_changed.notify_all();
+}
+
+void PollyCallerLoop::Finish()
+{
+	// Notified under the lock: Run returns, and the loop may be destroyed,
+	// as soon as the lock is released
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_done = true;
+	m_changed.notify_all();
+}
+
+void PollyCallerLoop::Drain()
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	for (;;)
+	{
+		m_changed.wait(guard, [&]() { return m_done || !m_ready.empty(); });
+		if (m_ready.empty())
+		{
+			m_done = false;
+			return;
+		}
+		auto handle = m_ready.front();
+		m_ready.pop_front();
+		guard.unlock();
+		handle.resume();
+		guard.lock();
+	}
+}
@@ -0,0 +1,333 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "PollyTask.h"
+#include "PollyTrace.h"
+
+template <typename T>
+class PollyFuture;
+
+namespace PollyExecutorDetail
+{
+	// Coroutine that starts at once and frees itself when it ends.
+	struct Detached
+	{
+		struct promise_type
+		{
+			Detached get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	// Base of the awaiters that move a coroutine to another thread. The
+	// trace request ID is per thread, so it travels with the coroutine.
+	struct Hop
+	{
+		uint64_t RequestId = 0;
+
+		bool await_ready() const noexcept { return false; }
+		void await_resume() { PollyTrace::SetCurrentRequestId(RequestId); }
+	};
+}
+
+// Small pool of threads shared by every engine object in the process.
+// Coroutines run on it between awaits, so concurrent Speak calls share
+// EXECUTOR_THREADS threads instead of each holding threads while Polly
+// answers. It also keeps the timers behind Delay and
+// PollyAsyncEvent::WaitFor, and a second, bounded pool for the calls that
+// still block.
+class PollyExecutor
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static PollyExecutor& Shared();
+
+	// With `blockingThreads` 0, blocking calls run on this pool itself.
+	explicit PollyExecutor(size_t threads, size_t blockingThreads = 0);
+	// Joins the blocking pool, then runs the work already posted; timers
+	// that are not due are dropped.
+	~PollyExecutor();
+
+	void Post(std::function<void()> work);
+	void PostAfter(Clock::duration delay, std::function<void()> work);
+	size_t ThreadCount() const { return m_threads.size(); }
+
+	struct ScheduleAwaiter : PollyExecutorDetail::Hop
+	{
+		PollyExecutor* Executor;
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			RequestId = PollyTrace::CurrentRequestId();
+			Executor->Post([handle]() { handle.resume(); });
+		}
+	};
+	// co_await Schedule(): continues on one of the pool's threads
+	ScheduleAwaiter Schedule() { ScheduleAwaiter awaiter; awaiter.Executor = this; return awaiter; }
+
+	struct DelayAwaiter : PollyExecutorDetail::Hop
+	{
+		PollyExecutor* Executor;
+		Clock::duration Delay;
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			RequestId = PollyTrace::CurrentRequestId();
+			Executor->PostAfter(Delay, [handle]() { handle.resume(); });
+		}
+	};
+	// co_await Delay(d): continues on the pool after `d`, without holding a thread
+	DelayAwaiter Delay(Clock::duration delay)
+	{
+		DelayAwaiter awaiter;
+		awaiter.Executor = this;
+		awaiter.Delay = delay;
+		return awaiter;
+	}
+
+	// co_await Detach(): continues on the blocking pool, for calls that
+	// block and would otherwise hold one of this pool's threads. When all
+	// of its threads are busy, the coroutine waits for one.
+	ScheduleAwaiter Detach() { return Blocking().Schedule(); }
+
+	// Starts `task` on the pool. The task runs to the end even if the
+	// future is dropped, so it must own everything it uses.
+	template <typename T>
+	PollyFuture<T> Spawn(PollyTask<T> task);
+
+private:
+	PollyExecutor& Blocking() { return m_blocking ? *m_blocking : *this; }
+	void Run();
+	template <typename T>
+	static PollyExecutorDetail::Detached RunSpawned(PollyExecutor& executor, PollyTask<T> task,
+		std::shared_ptr<typename PollyFuture<T>::State> state);
+
+	std::mutex m_lock;
+	std::condition_variable m_changed;
+	std::deque<std::function<void()>> m_ready;
+	std::multimap<Clock::time_point, std::function<void()>> m_timers;
+	bool m_stopping;
+	std::vector<std::thread> m_threads;
+	std::unique_ptr<PollyExecutor> m_blocking;
+};
+
+// Event that is set once. Coroutines waiting on it continue on the shared
+// executor, never on the thread that sets it, so an SDK callback can set
+// it without running the rest of a request on the SDK's thread. Copies
+// share the event.
+class PollyAsyncEvent
+{
+	struct Waiter
+	{
+		std::coroutine_handle<> Handle;
+		// Whichever of Set and the timeout claims it resumes the waiter
+		std::shared_ptr<std::atomic<bool>> Claimed;
+	};
+	struct State
+	{
+		std::mutex Lock;
+		bool IsSet = false;
+		std::vector<Waiter> Waiters;
+	};
+
+public:
+	PollyAsyncEvent() : m_state(std::make_shared<State>()) {}
+
+	void Set();
+	bool IsSet() const;
+
+	struct Awaiter : PollyExecutorDetail::Hop
+	{
+		std::shared_ptr<State> Event;
+		PollyExecutor::Clock::duration Timeout;
+		bool HasTimeout;
+
+		bool await_ready() const { return IsSetLocked(); }
+		bool await_suspend(std::coroutine_handle<> handle);
+		// True if the event is set, false after a timeout
+		bool await_resume()
+		{
+			Hop::await_resume();
+			return IsSetLocked();
+		}
+
+	private:
+		bool IsSetLocked() const
+		{
+			std::lock_guard<std::mutex> guard(Event->Lock);
+			return Event->IsSet;
+		}
+	};
+	// co_await Wait(): continues once the event is set
+	Awaiter Wait() const;
+	// co_await WaitFor(d): continues when the event is set or after `d`,
+	// whichever comes first, with whether it is set
+	Awaiter WaitFor(PollyExecutor::Clock::duration timeout) const;
+
+private:
+	std::shared_ptr<State> m_state;
+};
+
+// Result of a task started with PollyExecutor::Spawn. Await it once.
+template <typename T>
+class PollyFuture
+{
+public:
+	struct State
+	{
+		PollyAsyncEvent Done;
+		std::optional<T> Value;
+		std::exception_ptr Error;
+	};
+
+	PollyFuture() : m_state(std::make_shared<State>()) {}
+
+	bool IsReady() const { return m_state->Done.IsSet(); }
+
+	struct Awaiter
+	{
+		std::shared_ptr<State> Future;
+		PollyAsyncEvent::Awaiter Done;
+
+		bool await_ready() const { return Done.await_ready(); }
+		bool await_suspend(std::coroutine_handle<> handle) { return Done.await_suspend(handle); }
+		T await_resume()
+		{
+			Done.await_resume();
+			if (Future->Error)
+			{
+				std::rethrow_exception(Future->Error);
+			}
+			return std::move(*Future->Value);
+		}
+	};
+	Awaiter operator co_await() const { return Awaiter{ m_state, m_state->Done.Wait() }; }
+
+private:
+	friend class PollyExecutor;
+	std::shared_ptr<State> m_state;
+};
+
+template <typename T>
+PollyFuture<T> PollyExecutor::Spawn(PollyTask<T> task)
+{
+	PollyFuture<T> future;
+	RunSpawned(*this, std::move(task), future.m_state);
+	return future;
+}
+
+template <typename T>
+PollyExecutorDetail::Detached PollyExecutor::RunSpawned(PollyExecutor& executor, PollyTask<T> task,
+	std::shared_ptr<typename PollyFuture<T>::State> state)
+{
+	co_await executor.Schedule();
+	try
+	{
+		state->Value.emplace(co_await task);
+	}
+	catch (...)
+	{
+		state->Error = std::current_exception();
+	}
+	state->Done.Set();
+}
+
+// Runs a task on the calling thread and blocks until it finishes. While
+// it waits, the thread also runs the coroutines that move onto it with
+// Schedule(): the Speak thread runs its pipeline on one, since SAPI is
+// only called from the thread that called Speak. Never run one on a pool
+// thread; it would hold the thread for the whole task.
+class PollyCallerLoop
+{
+public:
+	PollyCallerLoop() : m_done(false) {}
+
+	template <typename T>
+	T Run(PollyTask<T> task);
+
+	struct ScheduleAwaiter : PollyExecutorDetail::Hop
+	{
+		PollyCallerLoop* Loop;
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			RequestId = PollyTrace::CurrentRequestId();
+			Loop->Post(handle);
+		}
+	};
+	// co_await Schedule(): continues on the thread in Run
+	ScheduleAwaiter Schedule() { ScheduleAwaiter awaiter; awaiter.Loop = this; return awaiter; }
+
+	PollyCallerLoop(const PollyCallerLoop&) = delete;
+	PollyCallerLoop& operator=(const PollyCallerLoop&) = delete;
+
+private:
+	template <typename T>
+	static PollyExecutorDetail::Detached Await(PollyCallerLoop& loop, PollyTask<T>& task,
+		std::optional<T>& value, std::exception_ptr& error);
+	void Post(std::coroutine_handle<> handle);
+	void Finish();
+	// Resumes posted coroutines until Finish is called
+	void Drain();
+
+	std::mutex m_lock;
+	std::condition_variable m_changed;
+	std::deque<std::coroutine_handle<>> m_ready;
+	bool m_done;
+};
+
+template <typename T>
+T PollyCallerLoop::Run(PollyTask<T> task)
+{
+	std::optional<T> value;
+	std::exception_ptr error;
+	// Runs here until the task first waits
+	Await(*this, task, value, error);
+	Drain();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return std::move(*value);
+}
+
+template <typename T>
+PollyExecutorDetail::Detached PollyCallerLoop::Await(PollyCallerLoop& loop, PollyTask<T>& task,
+	std::optional<T>& value, std::exception_ptr& error)
+{
+	try
+	{
+		value.emplace(co_await task);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	loop.Finish();
+}
@@ -0,0 +1,109 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// MurmurHash3_x64_128 (Austin Appleby, public domain). Fast on the short
+// texts the engine speaks and wide enough that a digest can stand in for
+// the text it was taken from.
+namespace PollyHash
+{
+	inline uint64_t Rotate(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t Mix(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xFF51AFD7ED558CCDull;
+		k ^= k >> 33;
+		k *= 0xC4CEB9FE1A85EC53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	inline uint64_t Load(const unsigned char* p)
+	{
+		uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline void Murmur3(const void* data, size_t length, uint64_t seed, uint64_t out[2])
+	{
+		const uint64_t c1 = 0x87C37B91114253D5ull;
+		const uint64_t c2 = 0x4CF5AD432745937Full;
+		auto bytes = static_cast<const unsigned char*>(data);
+		uint64_t h1 = seed;
+		uint64_t h2 = seed;
+
+		size_t blocks = length / 16;
+		for (size_t i = 0; i < blocks; i++)
+		{
+			uint64_t k1 = Load(bytes + i * 16);
+			uint64_t k2 = Load(bytes + i * 16 + 8);
+			k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+			h1 = Rotate(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+			k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+			h2 = Rotate(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+		}
+
+		const unsigned char* tail = bytes + blocks * 16;
+		uint64_t k1 = 0;
+		uint64_t k2 = 0;
+		switch (length & 15)
+		{
+		case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48; // fall through
+		case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40; // fall through
+		case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32; // fall through
+		case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24; // fall through
+		case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16; // fall through
+		case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8;   // fall through
+		case 9:  k2 ^= static_cast<uint64_t>(tail[8]);
+			k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+			// fall through
+		case 8:  k1 ^= static_cast<uint64_t>(tail[7]) << 56;  // fall through
+		case 7:  k1 ^= static_cast<uint64_t>(tail[6]) << 48;  // fall through
+		case 6:  k1 ^= static_cast<uint64_t>(tail[5]) << 40;  // fall through
+		case 5:  k1 ^= static_cast<uint64_t>(tail[4]) << 32;  // fall through
+		case 4:  k1 ^= static_cast<uint64_t>(tail[3]) << 24;  // fall through
+		case 3:  k1 ^= static_cast<uint64_t>(tail[2]) << 16;  // fall through
+		case 2:  k1 ^= static_cast<uint64_t>(tail[1]) << 8;   // fall through
+		case 1:  k1 ^= static_cast<uint64_t>(tail[0]);
+			k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+		}
+
+		h1 ^= length;
+		h2 ^= length;
+		h1 += h2;
+		h2 += h1;
+		h1 = Mix(h1);
+		h2 = Mix(h2);
+		h1 += h2;
+		h2 += h1;
+		out[0] = h1;
+		out[1] = h2;
+	}
+
+	// The 128-bit hash as a 16-byte string, for use as a map key
+	inline std::string Digest(const std::string& data)
+	{
+		uint64_t hash[2];
+		Murmur3(data.data(), data.size(), 0, hash);
+		return std::string(reinterpret_cast<const char*>(hash), sizeof(hash));
+	}
+}
@@ -0,0 +1,93 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyHedge.h"
+#include "PollyConfig.h"
+#include <algorithm>
+#include <vector>
+
+PollyHedgePolicy& PollyHedgePolicy::ForAudio()
+{
+	static PollyHedgePolicy policy;
+	return policy;
+}
+
+PollyHedgePolicy& PollyHedgePolicy::ForMarks()
+{
+	static PollyHedgePolicy policy;
+	return policy;
+}
+
+PollyHedgePolicy::PollyHedgePolicy()
+	: m_sampleIndex(0), m_tokens(0)
+{
+	m_enabled = PollyConfig::GetBool("HEDGE", false);
+	m_percentile = std::min(99L, std::max(50L, PollyConfig::GetLong("HEDGE_PERCENTILE", 95)));
+	m_minDelayMs = std::max(1L, PollyConfig::GetLong("HEDGE_MIN_DELAY_MS", 50));
+	m_maxDelayMs = std::max(m_minDelayMs, static_cast<int64_t>(PollyConfig::GetLong("HEDGE_MAX_DELAY_MS", 2000)));
+	m_tokensPerRequest = std::max(0L, PollyConfig::GetLong("HEDGE_MAX_RATE_PERCENT", 5)) * TokenScale / 100;
+	// Allow a short burst of hedges after a quiet period, but no more
+	m_maxTokens = 10 * TokenScale;
+	for (auto& sample : m_samples)
+	{
+		sample.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::chrono::milliseconds PollyHedgePolicy::HedgeDelay() const
+{
+	uint64_t seen = m_sampleIndex.load(std::memory_order_relaxed);
+	if (seen < MinSamples)
+	{
+		return std::chrono::milliseconds(m_maxDelayMs);
+	}
+
+	size_t count = static_cast<size_t>(std::min<uint64_t>(seen, SampleCount));
+	std::vector<uint32_t> window(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		window[i] = m_samples[i].load(std::memory_order_relaxed);
+	}
+	auto nth = window.begin() + (count - 1) * m_percentile / 100;
+	std::nth_element(window.begin(), nth, window.end());
+	int64_t delayMs = static_cast<int64_t>(*nth) / 1000;
+	return std::chrono::milliseconds(std::min(m_maxDelayMs, std::max(m_minDelayMs, delayMs)));
+}
+
+void PollyHedgePolicy::RecordFirstByte(std::chrono::steady_clock::duration elapsed)
+{
+	auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	uint64_t slot = m_sampleIndex.fetch_add(1, std::memory_order_relaxed) % SampleCount;
+	m_samples[slot].store(static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(micros, 0), UINT32_MAX)),
+		std::memory_order_relaxed);
+}
+
+void PollyHedgePolicy::RecordRequest()
+{
+	int64_t tokens = m_tokens.load(std::memory_order_relaxed);
+	while (tokens < m_maxTokens &&
+		!m_tokens.compare_exchange_weak(tokens, std::min(m_maxTokens, tokens + m_tokensPerRequest)))
+	{
+	}
+}
+
+bool PollyHedgePolicy::TryAcquireHedge()
+{
+	int64_t tokens = m_tokens.load(std::memory_order_relaxed);
+	while (tokens >= TokenScale)
+	{
+		if (m_tokens.compare_exchange_weak(tokens, tokens - TokenScale))
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,61 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Decides when a Polly request is slow enough to send a duplicate; off
+// unless HEDGE is set. The delay follows a running percentile
+// (HEDGE_PERCENTILE, default p95) of recent times to first byte of every
+// attempt, won or lost. Hedges are paid for from a token bucket that
+// earns HEDGE_MAX_RATE_PERCENT of a hedge per request, which caps the extra
+// Polly traffic.
+class PollyHedgePolicy
+{
+public:
+	static PollyHedgePolicy& ForAudio();
+	static PollyHedgePolicy& ForMarks();
+
+	bool IsEnabled() const { return m_enabled; }
+
+	// Delay after which a duplicate request is worth sending. Until enough
+	// samples have been seen this is the configured maximum.
+	std::chrono::milliseconds HedgeDelay() const;
+
+	void RecordFirstByte(std::chrono::steady_clock::duration elapsed);
+
+	// Called once per primary request; earns budget for future hedges.
+	void RecordRequest();
+
+	// Spends budget for one hedge. Returns false if the cap is reached.
+	bool TryAcquireHedge();
+
+private:
+	PollyHedgePolicy();
+
+	static const int SampleCount = 256;
+	static const int MinSamples = 20;
+	static const int64_t TokenScale = 1000;
+
+	bool m_enabled;
+	int m_percentile;
+	int64_t m_minDelayMs;
+	int64_t m_maxDelayMs;
+	int64_t m_tokensPerRequest;
+	int64_t m_maxTokens;
+
+	std::atomic<uint32_t> m_samples[SampleCount];
+	std::atomic<uint64_t> m_sampleIndex;
+	std::atomic<int64_t> m_tokens;
+};
@@ -0,0 +1,170 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyJitterBuffer.h"
+#include "PollyConfig.h"
+#include <algorithm>
+#include <cmath>
+
+bool PollyJitterBuffer::IsEnabled()
+{
+	static const bool enabled = PollyConfig::GetBool("JITTER_BUFFER", false);
+	return enabled;
+}
+
+PollyJitterBuffer::PollyJitterBuffer(uint32_t bytesPerMs)
+	: PollyJitterBuffer(bytesPerMs, static_cast<uint32_t>(std::max(0L, PollyConfig::GetLong("JITTER_MIN_MS", 60))),
+		static_cast<uint32_t>(std::max(0L, PollyConfig::GetLong("JITTER_MAX_MS", 2000))))
+{
+}
+
+PollyJitterBuffer::PollyJitterBuffer(uint32_t bytesPerMs, uint32_t lowMs, uint32_t highMs)
+	: m_read(0), m_bytesPerMs(bytesPerMs), m_closed(false), m_cancelled(false),
+	m_playing(false), m_started(false), m_producerWaiting(false), m_lastGapMs(0), m_jitterMs(0), m_arrivals(0),
+	m_underruns(0), m_overruns(0), m_starvedMs(0), m_depthSumMs(0), m_pops(0), m_maxDepthMs(0)
+{
+	m_frameBytes = FrameMs * bytesPerMs;
+	m_lowMs = lowMs;
+	// Room for a target of up to half the high watermark
+	m_highMs = std::max(highMs, 2 * (lowMs + FrameMs));
+	m_targetMs = m_lowMs;
+}
+
+bool PollyJitterBuffer::Push(const char* data, size_t size)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	if (m_cancelled)
+	{
+		return false;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (m_arrivals > 0)
+	{
+		double gapMs = std::chrono::duration<double, std::milli>(now - m_lastArrival).count();
+		if (m_arrivals > 1)
+		{
+			m_jitterMs += (std::fabs(gapMs - m_lastGapMs) - m_jitterMs) / 16;
+		}
+		m_lastGapMs = gapMs;
+	}
+	m_lastArrival = now;
+	m_arrivals++;
+	// Enough to ride out a few times the usual variation between arrivals
+	m_targetMs = std::min(m_highMs / 2, m_lowMs + static_cast<uint32_t>(3 * m_jitterMs));
+
+	size_t highBytes = static_cast<size_t>(m_highMs) * m_bytesPerMs;
+	if (Depth() > 0 && Depth() + size > highBytes)
+	{
+		m_overruns++;
+		m_producerWaiting = true;
+		m_changed.notify_all();
+		m_changed.wait(guard, [&]() { return m_cancelled || Depth() == 0 || Depth() + size <= highBytes; });
+		m_producerWaiting = false;
+		if (m_cancelled)
+		{
+			return false;
+		}
+	}
+	if (m_read > 0 && m_read >= m_data.size() / 2)
+	{
+		m_data.erase(0, m_read);
+		m_read = 0;
+	}
+	m_data.append(data, size);
+	m_changed.notify_all();
+	return true;
+}
+
+void PollyJitterBuffer::Close()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_closed = true;
+	m_changed.notify_all();
+}
+
+void PollyJitterBuffer::Cancel()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_cancelled = true;
+	m_changed.notify_all();
+}
+
+void PollyJitterBuffer::Take(std::string& frame, size_t size)
+{
+	uint32_t depthMs = static_cast<uint32_t>(Depth() / m_bytesPerMs);
+	m_depthSumMs += depthMs;
+	m_maxDepthMs = std::max(m_maxDepthMs, depthMs);
+	m_pops++;
+	frame.assign(m_data, m_read, size);
+	m_read += size;
+	m_changed.notify_all();
+}
+
+bool PollyJitterBuffer::Pop(std::string& frame)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	auto stopped = [&]() { return m_cancelled || (m_closed && Depth() == 0); };
+	for (;;)
+	{
+		if (!m_playing)
+		{
+			// A full buffer is ready whatever the target
+			m_changed.wait(guard, [&]() {
+				return m_cancelled || m_closed || m_producerWaiting ||
+					Depth() >= std::max(m_frameBytes, static_cast<size_t>(m_targetMs) * m_bytesPerMs);
+			});
+			if (stopped())
+			{
+				return false;
+			}
+			m_playing = true;
+			break;
+		}
+		m_changed.wait(guard, [&]() { return m_cancelled || m_closed || Depth() >= m_frameBytes; });
+		if (stopped())
+		{
+			return false;
+		}
+		if (m_closed || std::chrono::steady_clock::now() <= m_playedUntil)
+		{
+			break;
+		}
+		// The output played everything while this waited
+		m_underruns++;
+		m_playing = false;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (m_started && now > m_playedUntil)
+	{
+		m_starvedMs += static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(now - m_playedUntil).count());
+	}
+	m_started = true;
+	Take(frame, std::min(m_frameBytes, Depth()));
+	m_playedUntil = std::max(m_playedUntil, now) + std::chrono::microseconds(frame.size() * 1000 / m_bytesPerMs);
+	return true;
+}
+
+PollyJitterBuffer::Stats PollyJitterBuffer::GetStats() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	Stats stats;
+	stats.Underruns = m_underruns;
+	stats.Overruns = m_overruns;
+	stats.StarvedMs = m_starvedMs;
+	stats.TargetMs = m_targetMs;
+	stats.JitterMs = static_cast<uint32_t>(m_jitterMs);
+	stats.MaxDepthMs = m_maxDepthMs;
+	stats.MeanDepthMs = static_cast<uint32_t>(m_pops > 0 ? m_depthSumMs / m_pops : 0);
+	return stats;
+}
@@ -0,0 +1,107 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Playout buffer between audio that arrives from the network and SAPI's
+// Write. The network thread pushes whatever it receives; the Speak thread
+// pops fixed frames and writes each one as soon as it has it.
+//
+// Playback starts once the target depth is buffered. The target follows
+// the jitter of the arrivals (smoothed as in RFC 3550), from the low
+// watermark JITTER_MIN_MS up to half the high watermark JITTER_MAX_MS.
+// Above the high watermark the producer waits (an overrun).
+//
+// The buffer never plays silence of its own, since the output may be a
+// file rather than a device. SAPI does not tell an engine how much the
+// device has played, so that is estimated from the clock: the output is
+// taken to play each frame at the audio's own rate from when it was
+// popped, and to have run dry once it has played everything popped. When
+// it runs dry mid-stream (an underrun), the buffer refills to the target
+// before playing on. For an output that is not real time the estimate is
+// wrong, but an underrun there only delays the writes.
+class PollyJitterBuffer
+{
+public:
+	static const uint32_t FrameMs = 20;
+
+	struct Stats
+	{
+		uint64_t Underruns;
+		uint64_t Overruns;
+		uint64_t StarvedMs;
+		uint32_t TargetMs;
+		uint32_t JitterMs;
+		uint32_t MaxDepthMs;
+		uint32_t MeanDepthMs;
+	};
+
+	// JITTER_BUFFER
+	static bool IsEnabled();
+
+	// With the watermarks from the settings
+	explicit PollyJitterBuffer(uint32_t bytesPerMs);
+	PollyJitterBuffer(uint32_t bytesPerMs, uint32_t lowMs, uint32_t highMs);
+
+	// Producer side. Returns false once the consumer has cancelled.
+	bool Push(const char* data, size_t size);
+	// No more audio will be pushed.
+	void Close();
+
+	// Consumer side. Waits for the next FrameMs of audio and sets `frame`
+	// to it; the last frame may be shorter. Returns false when the stream
+	// is closed and played out, or cancelled.
+	bool Pop(std::string& frame);
+	// Stops the stream; a waiting Push returns false.
+	void Cancel();
+
+	Stats GetStats() const;
+
+private:
+	size_t Depth() const { return m_data.size() - m_read; }
+	void Take(std::string& frame, size_t size);
+
+	mutable std::mutex m_lock;
+	std::condition_variable m_changed;
+	std::string m_data;
+	size_t m_read;
+	size_t m_frameBytes;
+	uint32_t m_bytesPerMs;
+	uint32_t m_lowMs;
+	uint32_t m_highMs;
+	bool m_closed;
+	bool m_cancelled;
+	bool m_playing;
+	bool m_started;
+	bool m_producerWaiting;
+	// When the output will have played everything popped so far
+	std::chrono::steady_clock::time_point m_playedUntil;
+
+	std::chrono::steady_clock::time_point m_lastArrival;
+	double m_lastGapMs;
+	double m_jitterMs;
+	uint32_t m_targetMs;
+	uint64_t m_arrivals;
+
+	uint64_t m_underruns;
+	uint64_t m_overruns;
+	uint64_t m_starvedMs;
+	uint64_t m_depthSumMs;
+	uint64_t m_pops;
+	uint32_t m_maxDepthMs;
+};
@@ -0,0 +1,73 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyLog.h"
+#include "PollyConfig.h"
+#include <mutex>
+#include <vector>
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#ifdef _WIN32
+#include "spdlog/sinks/msvc_sink.h"
+#else
+#include "spdlog/sinks/stdout_sinks.h"
+#endif
+
+namespace spd = spdlog;
+
+static const size_t LOG_QUEUE_SIZE = 8192;
+
+std::shared_ptr<spd::logger> PollyLog::Get()
+{
+	static std::shared_ptr<spd::logger> logger;
+	static std::once_flag created;
+	std::call_once(created, []()
+	{
+		std::vector<spd::sink_ptr> sinks;
+#ifdef _WIN32
+		sinks.push_back(std::make_shared<spd::sinks::msvc_sink_mt>());
+#else
+		sinks.push_back(std::make_shared<spd::sinks::stderr_sink_mt>());
+#endif
+		std::string logFile = PollyConfig::GetString("LOG_FILE");
+		if (!logFile.empty())
+		{
+			try
+			{
+				sinks.push_back(std::make_shared<spd::sinks::basic_file_sink_mt>(logFile));
+			}
+			catch (const spd::spdlog_ex&)
+			{
+				// Keep logging to the remaining sinks if the file cannot be opened
+			}
+		}
+
+		spd::init_thread_pool(LOG_QUEUE_SIZE, 1);
+		logger = std::make_shared<spd::async_logger>("polly", sinks.begin(), sinks.end(),
+			spd::thread_pool(), spd::async_overflow_policy::overrun_oldest);
+		logger->set_pattern("[%H:%M:%S %z] [%t] [%l] %v");
+		logger->flush_on(spd::level::err);
+
+#ifdef _DEBUG
+		auto defaultLevel = spd::level::debug;
+#else
+		auto defaultLevel = spd::level::info;
+#endif
+		std::string level = PollyConfig::GetString("LOG_LEVEL");
+		logger->set_level(level.empty() ? defaultLevel : spd::level::from_str(level));
+	});
+	return logger;
+}
+
+void PollyLog::SetLevel(spd::level::level_enum level)
+{
+	Get()->set_level(level);
+}
@@ -0,0 +1,49 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#ifndef SPDLOG_ACTIVE_LEVEL
+#ifdef _DEBUG
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#else
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#endif
+#endif
+#include <memory>
+#include "spdlog/spdlog.h"
+
+// The process-wide engine logger. Messages are queued and written by a
+// single background thread; when the queue is full the oldest message is
+// dropped, so logging never blocks the synthesis path.
+class PollyLog
+{
+public:
+	static std::shared_ptr<spdlog::logger> Get();
+	static void SetLevel(spdlog::level::level_enum level);
+};
+
+// Debug and trace messages are compiled out unless SPDLOG_ACTIVE_LEVEL allows
+// them, and their arguments are only evaluated when the runtime level does.
+#define POLLY_LOG_AT(logger, level, ...) \
+	do { if ((logger)->should_log(level)) (logger)->log(level, __VA_ARGS__); } while (0)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define POLLY_LOG_TRACE(logger, ...) POLLY_LOG_AT(logger, spdlog::level::trace, __VA_ARGS__)
+#else
+#define POLLY_LOG_TRACE(logger, ...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define POLLY_LOG_DEBUG(logger, ...) POLLY_LOG_AT(logger, spdlog::level::debug, __VA_ARGS__)
+#else
+#define POLLY_LOG_DEBUG(logger, ...) (void)0
+#endif
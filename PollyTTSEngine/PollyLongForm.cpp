@@ -0,0 +1,324 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyLongForm.h"
+#include "PollyConfig.h"
+#include "PollyCredentials.h"
+#include "PollyLog.h"
+#include "PollyMetrics.h"
+#include "PollyPhraseStore.h"
+#include "PollyRegions.h"
+#include "PollyResilience.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <unordered_map>
+#include <aws/core/auth/AWSAuthSigner.h>
+#include <aws/polly/model/GetSpeechSynthesisTaskRequest.h>
+#include <aws/polly/model/StartSpeechSynthesisTaskRequest.h>
+#include <aws/s3/S3Client.h>
+#include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/ListObjectsV2Request.h>
+
+#ifdef GetMessage
+// <Windows.h> came in through spdlog after the SDK had declared AWSError::GetMessage
+#undef GetMessage
+#endif
+
+using namespace Aws::Polly::Model;
+
+static const char* ALLOCATION_TAG = "PollyTTSEngine::LongForm";
+
+namespace
+{
+	struct Settings
+	{
+		std::string bucket;
+		std::string prefix;
+		size_t minCharacters;
+		long pollMs;
+		long maxPollMs;
+		long timeoutMs;
+
+		Settings()
+		{
+			bucket = PollyConfig::GetString("LONGFORM_BUCKET");
+			prefix = PollyConfig::GetString("LONGFORM_PREFIX", "polly-tts/");
+			minCharacters = static_cast<size_t>(std::max(1L, PollyConfig::GetLong("LONGFORM_CHARS", 3000)));
+			pollMs = std::max(10L, PollyConfig::GetLong("LONGFORM_POLL_MS", 1000));
+			maxPollMs = std::max(pollMs, PollyConfig::GetLong("LONGFORM_POLL_MAX_MS", 10000));
+			timeoutMs = std::max(pollMs, PollyConfig::GetLong("LONGFORM_TIMEOUT_MS", 900000));
+		}
+	};
+
+	const Settings& GetSettings()
+	{
+		static Settings settings;
+		return settings;
+	}
+
+	// LONGFORM_S3_ENDPOINT points at a local stand-in for S3, addressed path-style
+	std::shared_ptr<Aws::S3::S3Client> S3()
+	{
+		static std::shared_ptr<Aws::S3::S3Client> client;
+		static std::once_flag created;
+		std::call_once(created, []()
+		{
+			Aws::Client::ClientConfiguration config;
+			auto endpoint = PollyConfig::GetString("LONGFORM_S3_ENDPOINT");
+			if (endpoint.find("http://") == 0)
+			{
+				config.scheme = Aws::Http::Scheme::HTTP;
+				endpoint = endpoint.substr(sizeof("http://") - 1);
+			}
+			else if (endpoint.find("https://") == 0)
+			{
+				endpoint = endpoint.substr(sizeof("https://") - 1);
+			}
+			if (!endpoint.empty())
+			{
+				config.endpointOverride = endpoint.c_str();
+			}
+			client = Aws::MakeShared<Aws::S3::S3Client>(ALLOCATION_TAG, PollyCredentialsProvider::Instance(), config,
+				Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, endpoint.empty());
+		});
+		return client;
+	}
+
+	// Passes the object body to the sink in 64 KB pieces, which keeps 16-bit
+	// samples whole and SAPI writes large.
+	class SinkBuffer : public std::streambuf
+	{
+	public:
+		explicit SinkBuffer(const PollyLongForm::Sink& sink) : m_sink(sink), m_stopped(false)
+		{
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+		}
+
+		bool Stopped() const { return m_stopped; }
+
+		bool Finish()
+		{
+			return Drain();
+		}
+
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			if (!Drain())
+			{
+				return traits_type::eof();
+			}
+			if (!traits_type::eq_int_type(ch, traits_type::eof()))
+			{
+				*pptr() = traits_type::to_char_type(ch);
+				pbump(1);
+			}
+			return traits_type::not_eof(ch);
+		}
+
+	private:
+		bool Drain()
+		{
+			size_t size = static_cast<size_t>(pptr() - pbase());
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+			if (m_stopped || (size > 0 && !m_sink(m_buffer, size)))
+			{
+				m_stopped = true;
+			}
+			return !m_stopped;
+		}
+
+		const PollyLongForm::Sink& m_sink;
+		bool m_stopped;
+		char m_buffer[64 * 1024];
+	};
+
+	class SinkStream : public Aws::IOStream
+	{
+	public:
+		explicit SinkStream(SinkBuffer* buffer) : Aws::IOStream(buffer) {}
+	};
+
+	// Task outputs already found, by prefix, so that repeats skip the listing
+	std::mutex g_cacheLock;
+	std::unordered_map<std::string, std::string> g_cache;
+}
+
+bool PollyLongForm::Applies(size_t billedCharacters)
+{
+	auto& settings = GetSettings();
+	return !settings.bucket.empty() && billedCharacters > settings.minCharacters;
+}
+
+bool PollyLongForm::Synthesize(const Request& request, const Sink& sink, std::string& error)
+{
+	auto voiceName = VoiceIdMapper::GetNameForVoiceId(request.Voice);
+	auto key = PollyPhraseStore::Key(voiceName.c_str(),
+		request.SpeechMarks ? "longform-marks" : ("longform-pcm" + request.SampleRate).c_str(), request.Text);
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(PollyPhraseStore::Hash(key)));
+	auto prefix = GetSettings().prefix + hash + "/";
+
+	std::string objectKey;
+	if (FindCached(prefix, objectKey))
+	{
+		POLLY_LOG_DEBUG(PollyLog::Get(), "Streaming the long-form output {} rendered earlier", objectKey);
+		PollyMetrics::Increment(PollyCounter::CacheHits, request.Voice);
+	}
+	else if (!RunTask(request, prefix, objectKey, error))
+	{
+		PollyMetrics::Increment(PollyCounter::Errors, request.Voice);
+		return false;
+	}
+	return Download(objectKey, sink, error);
+}
+
+bool PollyLongForm::FindCached(const std::string& prefix, std::string& objectKey)
+{
+	{
+		std::lock_guard<std::mutex> guard(g_cacheLock);
+		auto found = g_cache.find(prefix);
+		if (found != g_cache.end())
+		{
+			objectKey = found->second;
+			return true;
+		}
+	}
+
+	Aws::S3::Model::ListObjectsV2Request list;
+	list.SetBucket(GetSettings().bucket.c_str());
+	list.SetPrefix(prefix.c_str());
+	list.SetMaxKeys(1);
+	auto outcome = S3()->ListObjectsV2(list);
+	if (!outcome.IsSuccess() || outcome.GetResult().GetContents().empty())
+	{
+		return false;
+	}
+	objectKey = outcome.GetResult().GetContents().front().GetKey().c_str();
+	std::lock_guard<std::mutex> guard(g_cacheLock);
+	g_cache[prefix] = objectKey;
+	return true;
+}
+
+bool PollyLongForm::RunTask(const Request& request, const std::string& prefix, std::string& objectKey,
+	std::string& error)
+{
+	auto& settings = GetSettings();
+	auto& regions = PollyRegions::Instance();
+	auto region = regions.Ranked(request.Voice).front();
+
+	StartSpeechSynthesisTaskRequest start;
+	start.SetOutputS3BucketName(settings.bucket.c_str());
+	start.SetOutputS3KeyPrefix(prefix.c_str());
+	start.SetVoiceId(request.Voice);
+	start.SetText(request.Text.c_str());
+	start.SetTextType(request.Ssml ? TextType::ssml : TextType::text);
+	start.SetSampleRate(request.SampleRate.c_str());
+	if (request.SpeechMarks)
+	{
+		start.SetOutputFormat(OutputFormat::json);
+		start.AddSpeechMarkTypes(SpeechMarkType::word);
+	}
+	else
+	{
+		start.SetOutputFormat(OutputFormat::pcm);
+	}
+	PollyMetrics::Increment(PollyCounter::Requests, request.Voice);
+	auto started = region->Client->StartSpeechSynthesisTask(start);
+	if (!started.IsSuccess())
+	{
+		error = started.GetError().GetMessage().c_str();
+		return false;
+	}
+	auto taskId = started.GetResult().GetSynthesisTask().GetTaskId();
+	PollyMetrics::Increment(PollyCounter::BilledCharacters, request.Voice,
+		started.GetResult().GetSynthesisTask().GetRequestCharacters());
+	POLLY_LOG_DEBUG(PollyLog::Get(), "Started long-form task {} in {}", taskId.c_str(), region->Name);
+
+	GetSpeechSynthesisTaskRequest get;
+	get.SetTaskId(taskId);
+	auto pollStart = std::chrono::steady_clock::now();
+	long delayMs = settings.pollMs;
+	for (;;)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+		auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - pollStart).count();
+		auto polled = region->Client->GetSpeechSynthesisTask(get);
+		if (polled.IsSuccess())
+		{
+			auto& task = polled.GetResult().GetSynthesisTask();
+			if (task.GetTaskStatus() == TaskStatus::completed)
+			{
+				// https://s3.<region>.amazonaws.com/<bucket>/<key>, or the stand-in's equivalent
+				std::string uri = task.GetOutputUri().c_str();
+				auto bucketPath = uri.find("/" + settings.bucket + "/");
+				objectKey = bucketPath == std::string::npos ? prefix + taskId.c_str() :
+					uri.substr(bucketPath + settings.bucket.size() + 2);
+				std::lock_guard<std::mutex> guard(g_cacheLock);
+				g_cache[prefix] = objectKey;
+				return true;
+			}
+			if (task.GetTaskStatus() == TaskStatus::failed)
+			{
+				error = task.GetTaskStatusReason().c_str();
+				return false;
+			}
+		}
+		else if (!PollyResilience::IsRetryable(polled.GetError()))
+		{
+			error = polled.GetError().GetMessage().c_str();
+			return false;
+		}
+		if (elapsedMs + delayMs > settings.timeoutMs)
+		{
+			error = "Long-form task " + std::string(taskId.c_str()) + " did not finish in time";
+			return false;
+		}
+		delayMs = std::min(settings.maxPollMs, delayMs * 2);
+	}
+}
+
+bool PollyLongForm::Download(const std::string& objectKey, const Sink& sink, std::string& error)
+{
+	SinkBuffer buffer(sink);
+	Aws::S3::Model::GetObjectRequest get;
+	get.SetBucket(GetSettings().bucket.c_str());
+	get.SetKey(objectKey.c_str());
+	get.SetResponseStreamFactory([&buffer]() -> Aws::IOStream* {
+		return Aws::New<SinkStream>(ALLOCATION_TAG, &buffer);
+	});
+	get.SetContinueRequestHandler([&buffer](const Aws::Http::HttpRequest*) {
+		return !buffer.Stopped();
+	});
+	auto outcome = S3()->GetObject(get);
+	if (buffer.Stopped())
+	{
+		return true;
+	}
+	if (!outcome.IsSuccess())
+	{
+		// The object may have been removed, e.g. by a bucket lifecycle rule
+		std::lock_guard<std::mutex> guard(g_cacheLock);
+		for (auto entry = g_cache.begin(); entry != g_cache.end();)
+		{
+			entry = entry->second == objectKey ? g_cache.erase(entry) : std::next(entry);
+		}
+		error = outcome.GetError().GetMessage().c_str();
+		return false;
+	}
+	buffer.Finish();
+	return true;
+}
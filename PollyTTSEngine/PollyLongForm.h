@@ -0,0 +1,55 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "aws/polly/model/VoiceId.h"
+
+// Long-form synthesis for texts above LONGFORM_CHARS billed characters,
+// which SynthesizeSpeech would reject. The text is sent as a speech
+// synthesis task that writes its output to LONGFORM_BUCKET; the engine
+// polls the task with backoff and then streams the object from S3.
+//
+// Outputs are content-addressed: each task writes under a prefix named
+// after a hash of the voice, output and text, so a text that was already
+// rendered, by this machine or any other, is streamed again without a
+// new task.
+class PollyLongForm
+{
+public:
+	// Receives output as it downloads. Returning false stops the download.
+	typedef std::function<bool(const char* data, size_t size)> Sink;
+
+	struct Request
+	{
+		Aws::Polly::Model::VoiceId Voice;
+		std::string Text;
+		bool Ssml;
+		bool SpeechMarks;
+		// Of the PCM output, "8000" or "16000"
+		std::string SampleRate;
+	};
+
+	// True if LONGFORM_BUCKET is set and `billedCharacters` is above LONGFORM_CHARS.
+	static bool Applies(size_t billedCharacters);
+
+	// Synthesizes `request` and passes the PCM, or speech marks, to
+	// `sink`. A download that `sink` stopped still counts as a success.
+	static bool Synthesize(const Request& request, const Sink& sink, std::string& error);
+
+private:
+	static bool FindCached(const std::string& prefix, std::string& objectKey);
+	static bool RunTask(const Request& request, const std::string& prefix, std::string& objectKey, std::string& error);
+	static bool Download(const std::string& objectKey, const Sink& sink, std::string& error);
+};
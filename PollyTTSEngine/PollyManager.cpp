@@ -9,7 +9,12 @@ and in the "LICENSE" file accompanying this file.This file is distributed
 on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
 or implied.See the License for the specific language governing
 permissions and limitations under the License. */
-#include "stdafx.h"
+// <Windows.h> comes first, as it did through stdafx.h, so that the SDK's
+// GetMessage is renamed consistently
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
 #include "PollyManager.h"
 #include <aws/polly/PollyClient.h>
 #include <aws/polly/model/OutputFormat.h>
@@ -17,90 +22,649 @@ permissions and limitations under the License. */
 #include <aws/core/utils/Outcome.h>
 #include <aws/core/utils/StringUtils.h>
 #include <aws/polly/model/SynthesizeSpeechRequest.h>
-#include "TtsEngObj.h"
 #include "PollySpeechMarksResponse.h"
 #include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 #include <unordered_map>
-#include "spdlog/fmt/ostr.h"
-#include "spdlog/spdlog.h"
-#include "spdlog/sinks/msvc_sink.h"
+#include "PollyLog.h"
 #include <aws/core/auth/AWSCredentialsProvider.h>
+#include "PollyMetrics.h"
+#include "PollyResponseStream.h"
+#include "PollyTrace.h"
+#include "PollyConfig.h"
+#include "PollyResilience.h"
+#include "PollyPayloadCache.h"
+#include "PollySingleFlight.h"
+#include "PollyPhraseStore.h"
+#include "PollySharedCache.h"
+#include "PollyAdpcm.h"
+#include "PollySilenceTrim.h"
+#include "PollyPromptTemplate.h"
+#include "PollyWarmup.h"
+#include "PollyRegions.h"
+#include "PollyVoiceCatalog.h"
+#include "PollyVoiceNames.h"
+#include "PollyExecutor.h"
+#include <cassert>
+#include <sstream>
 namespace spd = spdlog;
 
-#define NOMINMAX
-#ifdef _WIN32
-#include <Windows.h>
-#endif
-#define MAX_SIZE 6000000
 using namespace Aws::Polly::Model;
 static const char* ALLOCATION_TAG = "PollyTTSEngine::Main";
 
-void PollyManager::SetVoice (LPWSTR voiceName)
+void PollyManager::SetVoice(const std::wstring& voiceName)
 {
-	m_logger->debug("{}: Setting voice to {}", __FUNCTION__, Aws::Utils::StringUtils::FromWString(voiceName));
+	POLLY_LOG_DEBUG(m_logger, "{}: Setting voice to {}", __FUNCTION__, Aws::Utils::StringUtils::FromWString(voiceName.c_str()));
 	m_sVoiceName = voiceName;
-	auto voiceId = vm.find(voiceName);
-	m_vVoiceId = voiceId->second ;
+	auto voiceId = PollyVoiceNames::Find(voiceName);
+	if (voiceId)
+	{
+		m_vVoiceId = *voiceId;
+		return;
+	}
+	// A voice added to Polly after this engine was built
+	PollyVoiceInfo voice;
+	if (PollyVoiceCatalog::Instance().Find(Aws::Utils::StringUtils::FromWString(voiceName.c_str()).c_str(), voice))
+	{
+		m_vVoiceId = VoiceIdMapper::GetVoiceIdForName(voice.Id.c_str());
+		return;
+	}
+	m_logger->error("Unknown Polly voice {}", Aws::Utils::StringUtils::FromWString(voiceName.c_str()));
+	m_vVoiceId = VoiceId::NOT_SET;
 }
 
-PollyManager::PollyManager(LPWSTR voiceName)
+PollyManager::PollyManager(const std::wstring& voiceName, PollyAudioFormat format)
+	: m_format(format), m_trimmedHeadMs(0)
 {
-	m_logger = std::make_shared<spd::logger>("msvc_logger", std::make_shared<spd::sinks::msvc_sink_mt>());
-#ifdef DEBUG
-	m_logger->set_level(spd::level::debug);
-#else
-	m_logger->set_level(spd::level::info);
-#endif
+	m_logger = PollyLog::Get();
 
 	SetVoice(voiceName);
 }
 
-PollySpeechResponse PollyManager::GenerateSpeech(CSentItem& item)
+std::string PollyManager::SpeechText(std::string text)
 {
+	if (Aws::Utils::StringUtils::ToLower(text.c_str()).find("</voice>") != std::string::npos)
+	{
+		text = "<speak>" + text.replace(text.find("</voice>"), sizeof("</voice>") - 1, "");
+	}
+	return text;
+}
+
+bool PollyManager::IsLongForm(const std::string& text)
+{
+	auto canonical = PollyCanonicalText::Canonicalize(SpeechText(text));
+	return PollyLongForm::Applies(PollyCanonicalText::BilledCharacters(canonical.Text, canonical.Ssml));
+}
+
+std::streamsize PollyManager::BilledCharacters(std::string& text, bool isSsml)
+{
+	return static_cast<std::streamsize>(PollyCanonicalText::BilledCharacters(text, isSsml));
+}
+
+PollyCanonicalText PollyManager::Canonicalize(const std::string& text)
+{
+	auto canonical = PollyCanonicalText::Canonicalize(text);
+	if (canonical.SavedBytes > 0)
+	{
+		POLLY_LOG_DEBUG(m_logger, "Canonical text saves {} billed characters and {} bytes",
+			canonical.SavedCharacters, canonical.SavedBytes);
+		PollyMetrics::Increment(PollyCounter::CanonicalSavedCharacters, m_vVoiceId, canonical.SavedCharacters);
+	}
+	return canonical;
+}
+
+namespace
+{
+	// Shared by the attempts of one hedged request. The first attempt that
+	// receives a byte, or finishes, wins and the others are cancelled by
+	// their continue-request handler.
+	struct HedgeRace
+	{
+		std::atomic<int> winner;
+		PollyAsyncEvent claimed;
+
+		HedgeRace() : winner(-1) {}
+
+		bool Decided() const { return winner.load() >= 0; }
+
+		void Claim(int attempt)
+		{
+			int expected = -1;
+			winner.compare_exchange_strong(expected, attempt);
+			claimed.Set();
+		}
+	};
+
+	// One SynthesizeSpeechAsync call. The SDK calls back on its own
+	// executor; coroutines awaiting `done` continue on the PollyExecutor.
+	struct PendingSynthesis
+	{
+		PollyAsyncEvent done;
+		SynthesizeSpeechOutcome outcome;
+	};
+
+	// The SDK has already written the whole body to the stream when it
+	// completes a call, so reading it never blocks
+	std::string ReadBody(Aws::IOStream& stream)
+	{
+		std::string body;
+		char chunk[64 * 1024];
+		while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0)
+		{
+			body.append(chunk, static_cast<size_t>(stream.gcount()));
+		}
+		return body;
+	}
+}
+
+PollyTask<SynthesizeSpeechOutcome> PollyManager::Synthesize(const std::shared_ptr<Aws::Polly::PollyClient>& client,
+	const SynthesizeSpeechRequest& request, PollyHedgePolicy& policy)
+{
+	auto race = std::make_shared<HedgeRace>();
+	auto launch = [&](int attempt)
+	{
+		SynthesizeSpeechRequest copy = request;
+		auto start = std::chrono::steady_clock::now();
+		PollyHedgePolicy* hedgePolicy = &policy;
+		copy.SetResponseStreamFactory([race, attempt, start, hedgePolicy]() -> Aws::IOStream* {
+			return Aws::New<TimedResponseStream>(ALLOCATION_TAG, [race, attempt, start, hedgePolicy]() {
+				auto elapsed = std::chrono::steady_clock::now() - start;
+				// A slow attempt that loses the race is still a sample, or
+				// the window would only hold the fast ones
+				hedgePolicy->RecordFirstByte(elapsed);
+				if (!race->Decided())
+				{
+					PollyMetrics::RecordLatency(PollyStage::FirstByte, elapsed);
+				}
+				race->Claim(attempt);
+			});
+		});
+		copy.SetContinueRequestHandler([race, attempt](const Aws::Http::HttpRequest*) {
+			int winner = race->winner.load();
+			return winner < 0 || winner == attempt;
+		});
+		auto pending = std::make_shared<PendingSynthesis>();
+		// A cancelled attempt still runs on the client's executor; the
+		// handler keeps the client alive until it has unwound
+		auto owner = client;
+		client->SynthesizeSpeechAsync(copy, [pending, race, attempt, owner](const Aws::Polly::PollyClient*,
+			const SynthesizeSpeechRequest&, SynthesizeSpeechOutcome outcome,
+			const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
+			pending->outcome = std::move(outcome);
+			// An attempt can also finish without writing a body, e.g. on a network error
+			race->Claim(attempt);
+			pending->done.Set();
+		});
+		return pending;
+	};
+
+	policy.RecordRequest();
+	auto primary = launch(0);
+	if (policy.IsEnabled())
+	{
+		bool decided = co_await race->claimed.WaitFor(policy.HedgeDelay());
+		if (!decided && policy.TryAcquireHedge())
+		{
+			POLLY_LOG_DEBUG(m_logger, "No first byte after {}ms, sending a hedged request", policy.HedgeDelay().count());
+			PollyMetrics::Increment(PollyCounter::Hedges, m_vVoiceId);
+			auto hedge = launch(1);
+			co_await race->claimed.Wait();
+			if (race->winner.load() == 1)
+			{
+				PollyMetrics::Increment(PollyCounter::HedgeWins, m_vVoiceId);
+				co_await hedge->done.Wait();
+				co_return std::move(hedge->outcome);
+			}
+		}
+	}
+	co_await primary->done.Wait();
+	co_return std::move(primary->outcome);
+}
+
+void PollyManager::TagRequest(SynthesizeSpeechRequest& request)
+{
+	if (PollyTrace::IsEnabled())
+	{
+		request.SetAdditionalCustomHeaderValue(POLLY_TRACE_HEADER,
+			PollyTrace::FormatRequestId(PollyTrace::CurrentRequestId()).c_str());
+	}
+}
+
+PollySpeechResponse PollyManager::GenerateSpeech(const std::string& text, const PollyLongForm::Sink& sink)
+{
+	PollyCallerLoop loop;
+	return loop.Run(Generate(text, sink, &loop));
+}
+
+PollyTask<PollySpeechResponse> PollyManager::GenerateSpeechAsync(std::string text)
+{
+	return Generate(std::move(text), nullptr, nullptr);
+}
+
+PollyTask<PollySpeechResponse> PollyManager::Generate(std::string text, PollyLongForm::Sink sink, PollyCallerLoop* caller)
+{
+	m_trimmedHeadMs = 0;
+	// Silence the text asks for with <break> is left alone
+	if (!PollySilenceTrimmer::IsEnabled() || PollyAudio::SampleBytes(m_format) != 2 ||
+		Aws::Utils::StringUtils::ToLower(text.c_str()).find("<break") != std::string::npos)
+	{
+		co_return co_await GenerateAudio(text, sink, caller);
+	}
+
+	PollySilenceTrimmer trimmer(PollyAudio::BytesPerMs(m_format) * 500);
+	PollyLongForm::Sink trimmed;
+	if (sink)
+	{
+		trimmed = [&](const char* data, size_t size) { return trimmer.Push(data, size, sink); };
+	}
+	auto response = co_await GenerateAudio(text, trimmed, caller);
+	if (!response.IsSuccess)
+	{
+		co_return response;
+	}
+	if (response.Streamed)
+	{
+		trimmer.Finish(sink);
+	}
+	else
+	{
+		response.AudioData = std::make_shared<const std::string>(trimmer.Trim(*response.AudioData));
+	}
+	response.Length -= static_cast<std::streamsize>(trimmer.TrimmedBytes());
+	// GenerateSpeechMarks is called next for the same text
+	m_sTrimmedText = text;
+	m_trimmedHeadMs = trimmer.TrimmedHeadMs();
+	POLLY_LOG_DEBUG(m_logger, "Trimmed {} ms of silence, {} ms of it from the start",
+		trimmer.TrimmedBytes() / PollyAudio::BytesPerMs(m_format), m_trimmedHeadMs);
+	co_return response;
+}
+
+PollyTask<PollySpeechResponse> PollyManager::GenerateAudio(const std::string& text, const PollyLongForm::Sink& sink,
+	PollyCallerLoop* caller)
+{
+	ScopedTraceSpan span("GenerateSpeech");
 	PollySpeechResponse response;
 	
-	Aws::Polly::PollyClient p = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>(
-		ALLOCATION_TAG, "polly-windows");
 	SynthesizeSpeechRequest speech_request;
-	auto speech_text = Aws::Utils::StringUtils::FromWString(item.pItem);
-	if (Aws::Utils::StringUtils::ToLower(speech_text.c_str()).find("</voice>") != std::string::npos)
-	{
-		speech_text = "<speak>" + speech_text.replace(speech_text.find("</voice>"), sizeof("</voice>") - 1, "");
-	}
-	m_logger->debug("{}: Asking Polly for '{}'", __FUNCTION__, speech_text.c_str());
+	ScopedStageTimer ssmlTimer(PollyStage::SsmlPreprocess);
+	auto canonical = Canonicalize(SpeechText(text));
+	auto speech_text = canonical.Text;
+	bool isSsml = canonical.Ssml;
+	POLLY_LOG_DEBUG(m_logger, "{}: Asking Polly for '{}'", __FUNCTION__, speech_text.c_str());
 	speech_request.SetOutputFormat(OutputFormat::pcm);
 	speech_request.SetVoiceId(m_vVoiceId);
-	char polly_text[10000];
 
-	m_logger->debug("Generating speech: {}", speech_text);
+	POLLY_LOG_DEBUG(m_logger, "Generating speech: {}", speech_text);
 	speech_request.SetText(speech_text);
-	if (Aws::Utils::StringUtils::ToLower(speech_text.c_str()).find("<speak") == 0)
+	if (isSsml)
 	{
-		m_logger->debug("Text type = ssml");
+		POLLY_LOG_DEBUG(m_logger, "Text type = ssml");
 		speech_request.SetTextType(TextType::ssml);
 	}
 	else
 	{
-		m_logger->debug("Text type = text");
+		POLLY_LOG_DEBUG(m_logger, "Text type = text");
 		speech_request.SetTextType(TextType::text);
 	}
+	ssmlTimer.Stop();
 
-	speech_request.SetSampleRate("16000");
-	auto speech = p.SynthesizeSpeech(speech_request);
-	response.IsSuccess = speech.IsSuccess();
-	if (!speech.IsSuccess())
+	if (PollyLongForm::Applies(static_cast<size_t>(BilledCharacters(speech_text, isSsml))))
 	{
-		std::stringstream error;
-		error << "Error generating speech: " << speech.GetError().GetMessageW();
-		response.ErrorMessage = error.str();
-		return response;
+		if (!caller)
+		{
+			co_await PollyExecutor::Shared().Detach();
+		}
+		auto fetched = FetchLongForm(speech_text, isSsml, false, sink, response.Length);
+		if (!caller)
+		{
+			co_await PollyExecutor::Shared().Schedule();
+		}
+		response.IsSuccess = fetched.Body != nullptr;
+		if (!response.IsSuccess)
+		{
+			response.ErrorMessage = "Error generating speech: " + fetched.ErrorMessage;
+			co_return response;
+		}
+		response.Streamed = sink != nullptr;
+		response.AudioData = fetched.Body;
+		PollyMetrics::Increment(PollyCounter::AudioBytes, m_vVoiceId, response.Length);
+		co_return response;
 	}
-	auto &r = speech.GetResult();
 
-	auto& stream = r.GetAudioStream();
-	stream.read(reinterpret_cast<char*>(&response.AudioData[0]), MAX_SIZE);
-	response.Length = stream.gcount();
-	return response;
+	// Template fragments are kept as 16 kHz PCM
+	std::vector<PollyPromptPiece> pieces;
+	if (!isSsml && m_format == PollyAudioFormat::Pcm16k && PollyPromptTemplate::IsEnabled() &&
+		PollyPromptTemplate::Split(speech_text, pieces))
+	{
+		response = co_await AssembleSpeech(speech_text, pieces);
+		if (caller)
+		{
+			co_await caller->Schedule();
+		}
+		co_return response;
+	}
+
+	speech_request.SetSampleRate(PollyAudio::SampleRate(m_format));
+	auto key = RequestKey(PollyAudio::CacheKind(m_format), speech_text);
+	auto fetched = co_await FetchShared(speech_request, key, speech_text, isSsml, PollyHedgePolicy::ForAudio(),
+		PollyStage::PollyAudioRtt);
+	if (caller)
+	{
+		// The sink is only called on the thread that asked for the audio
+		co_await caller->Schedule();
+	}
+	response.IsSuccess = fetched.Body != nullptr;
+	if (!response.IsSuccess)
+	{
+		response.ErrorMessage = "Error generating speech: " + fetched.ErrorMessage;
+		co_return response;
+	}
+	if (PollyAdpcm::IsEncoded(*fetched.Body))
+	{
+		// A compressed cache entry starts playing after its first piece is decoded
+		ScopedStageTimer decodeTimer(PollyStage::Decode);
+		response.Length = static_cast<std::streamsize>(PollyAdpcm::DecodedSize(*fetched.Body));
+		response.Streamed = sink != nullptr;
+		if (response.Streamed)
+		{
+			PollyAdpcm::Decode(*fetched.Body, sink);
+			response.AudioData = std::make_shared<const std::string>();
+		}
+		else
+		{
+			response.AudioData = std::make_shared<const std::string>(PollyAdpcm::Decode(*fetched.Body));
+		}
+		PollyMetrics::Increment(PollyCounter::AudioBytes, m_vVoiceId, response.Length);
+		co_return response;
+	}
+	response.AudioData = fetched.Body;
+	response.Length = static_cast<std::streamsize>(fetched.Body->size());
+	PollyMetrics::Increment(PollyCounter::AudioBytes, m_vVoiceId, response.Length);
+	co_return response;
+}
+
+bool PollyManager::CompressCache()
+{
+	static const bool adpcm = PollyConfig::GetString("CACHE_CODEC", "pcm") == "adpcm";
+	return adpcm;
+}
+
+PollyTask<PollyFetchResult> PollyManager::Fetch(SynthesizeSpeechRequest& request, const std::string& key, std::string& text,
+	bool isSsml, PollyHedgePolicy& policy, PollyStage rttStage)
+{
+	PollyFetchResult result;
+	result.Body = PollyPhraseStore::Instance().Find(key);
+	if (result.Body)
+	{
+		POLLY_LOG_DEBUG(m_logger, "Using the pre-synthesized phrase from {}", PollyPhraseStore::Instance().Directory());
+		PollyMetrics::Increment(PollyCounter::CacheHits, m_vVoiceId);
+		co_return result;
+	}
+	result.Body = PollySharedCache::Instance().Find(key);
+	if (result.Body)
+	{
+		POLLY_LOG_DEBUG(m_logger, "Using the audio cached in {}", PollySharedCache::Instance().Path());
+		PollyMetrics::Increment(PollyCounter::CacheHits, m_vVoiceId);
+		co_return result;
+	}
+
+	ScopedStageTimer clientTimer(PollyStage::ClientAcquire);
+	auto& regions = PollyRegions::Instance();
+	auto ranked = regions.Ranked(m_vVoiceId);
+	clientTimer.Stop();
+
+	TagRequest(request);
+	SynthesizeSpeechOutcome outcome;
+	// One retry budget for the whole request, however many regions it tries
+	auto deadline = PollyResilience::Deadline();
+	for (auto region : ranked)
+	{
+		if (region != ranked.front() && std::chrono::steady_clock::now() >= deadline)
+		{
+			POLLY_LOG_DEBUG(m_logger, "Retry deadline reached, not trying Polly region {}", region->Name);
+			break;
+		}
+		auto requestStart = std::chrono::steady_clock::now();
+		bool shortCircuited = false;
+		outcome = co_await PollyResilience::Execute(region->Name, [&]() -> PollyTask<SynthesizeSpeechOutcome> {
+			PollyMetrics::Increment(PollyCounter::Requests, m_vVoiceId);
+			auto attemptStart = std::chrono::steady_clock::now();
+			auto attempt = co_await Synthesize(region->Client, request, policy);
+			regions.Record(*region, std::chrono::steady_clock::now() - attemptStart,
+				!attempt.IsSuccess() && PollyResilience::IsRetryable(attempt.GetError()));
+			co_return std::move(attempt);
+		}, deadline, shortCircuited);
+		if (!shortCircuited)
+		{
+			PollyWarmup::NoteActivity();
+			PollyMetrics::RecordLatency(rttStage, std::chrono::steady_clock::now() - requestStart);
+		}
+		if (outcome.IsSuccess())
+		{
+			// Also when the region was only tried because none listed the voice
+			region->Learn(m_vVoiceId);
+			break;
+		}
+		if (!PollyResilience::IsRetryable(outcome.GetError()))
+		{
+			break;
+		}
+		POLLY_LOG_DEBUG(m_logger, "Polly region {} failed ({}), trying the next one", region->Name,
+			outcome.GetError().GetMessage().c_str());
+	}
+	if (outcome.IsSuccess())
+	{
+		PollyMetrics::Increment(PollyCounter::BilledCharacters, m_vVoiceId, BilledCharacters(text, isSsml));
+		ScopedStageTimer decodeTimer(PollyStage::Decode);
+		auto body = ReadBody(outcome.GetResult().GetAudioStream());
+		// Cached entries are kept encoded, so a hit is played as it is
+		if (request.GetOutputFormat() == OutputFormat::pcm && m_format != PollyAudioFormat::Pcm16k)
+		{
+			body = PollyAudio::Encode(m_format, body);
+		}
+		result.Body = std::make_shared<const std::string>(std::move(body));
+		auto entry = result.Body;
+		if (request.GetOutputFormat() == OutputFormat::pcm && PollyAudio::SampleBytes(m_format) == 2 && CompressCache())
+		{
+			entry = std::make_shared<const std::string>(PollyAdpcm::Encode(*result.Body));
+		}
+		// The shared cache also serves the response when Polly fails, so a
+		// private copy is only kept when it could not be stored there
+		if (!PollySharedCache::Instance().Store(key, *entry))
+		{
+			PollyPayloadCache::LastKnownGood().Store(key, entry);
+		}
+		co_return result;
+	}
+
+	result.Body = PollyPayloadCache::LastKnownGood().Find(key);
+	if (result.Body)
+	{
+		POLLY_LOG_DEBUG(m_logger, "Polly failed ({}), using the last known good response",
+			outcome.GetError().GetMessage().c_str());
+		PollyMetrics::Increment(PollyCounter::CacheHits, m_vVoiceId);
+		co_return result;
+	}
+	PollyMetrics::Increment(PollyCounter::Errors, m_vVoiceId);
+	result.ErrorMessage = outcome.GetError().GetMessage().c_str();
+	co_return result;
+}
+
+PollyTask<PollyFetchResult> PollyManager::FetchShared(SynthesizeSpeechRequest& request, const std::string& key,
+	std::string& text, bool isSsml, PollyHedgePolicy& policy, PollyStage rttStage)
+{
+	bool merged = false;
+	auto fetched = co_await PollySingleFlight::Run(key, [&]() {
+		return Fetch(request, key, text, isSsml, policy, rttStage);
+	}, merged);
+	if (merged)
+	{
+		PollyMetrics::Increment(PollyCounter::Merged, m_vVoiceId);
+	}
+	co_return fetched;
+}
+
+PollyTask<PollySpeechResponse> PollyManager::AssembleSpeech(const std::string& text,
+	const std::vector<PollyPromptPiece>& pieces)
+{
+	PollySpeechResponse response;
+	std::vector<PollyPayloadCache::Payload> audio(pieces.size());
+	std::vector<PollyPayloadCache::Payload> marks(pieces.size());
+	std::vector<std::pair<PollyPayloadCache::Payload*, PollyFuture<PollyFetchResult>>> misses;
+	for (size_t i = 0; i < pieces.size(); i++)
+	{
+		for (const char* output : { PollyPhraseStore::PcmOutput, PollyPhraseStore::MarksOutput })
+		{
+			bool speechMarks = output == PollyPhraseStore::MarksOutput;
+			// A variable token gets one mark, taken from its first unit
+			if (speechMarks && i > 0 && pieces[i].Variable && pieces[i - 1].Variable &&
+				pieces[i - 1].SourceStart == pieces[i].SourceStart)
+			{
+				continue;
+			}
+			auto& body = speechMarks ? marks[i] : audio[i];
+			body = PollyPromptTemplate::Fragments().Find(RequestKey(output, pieces[i].Text));
+			if (body)
+			{
+				PollyMetrics::Increment(PollyCounter::CacheHits, m_vVoiceId);
+				continue;
+			}
+			// Only the fragments that have never been spoken go to Polly, in parallel
+			misses.emplace_back(&body, PollyExecutor::Shared().Spawn(FetchFragment(pieces[i], output)));
+		}
+	}
+	for (auto& miss : misses)
+	{
+		auto fetched = co_await miss.second;
+		*miss.first = fetched.Body;
+		if (!fetched.Body)
+		{
+			response.ErrorMessage = "Error generating speech: " + fetched.ErrorMessage;
+		}
+	}
+	if (!response.ErrorMessage.empty())
+	{
+		co_return response;
+	}
+
+	ScopedStageTimer decodeTimer(PollyStage::Decode);
+	std::vector<size_t> offsets;
+	response.AudioData = std::make_shared<const std::string>(PollyPromptTemplate::Join(audio, offsets));
+	response.Length = static_cast<std::streamsize>(response.AudioData->size());
+	response.IsSuccess = true;
+	// GenerateSpeechMarks is called next for the same text
+	m_sAssembledText = text;
+	m_assembledMarks = std::make_shared<const std::string>(PollyPromptTemplate::MergeMarks(text, pieces, marks, offsets));
+	PollyMetrics::Increment(PollyCounter::AssembledPrompts, m_vVoiceId);
+	PollyMetrics::Increment(PollyCounter::AudioBytes, m_vVoiceId, response.Length);
+	co_return response;
+}
+
+PollyTask<PollyFetchResult> PollyManager::FetchFragment(PollyPromptPiece piece, const char* output)
+{
+	bool speechMarks = output == PollyPhraseStore::MarksOutput;
+	SynthesizeSpeechRequest request;
+	request.SetVoiceId(m_vVoiceId);
+	request.SetText(piece.Text.c_str());
+	request.SetTextType(piece.Ssml ? TextType::ssml : TextType::text);
+	request.SetSampleRate("16000");
+	if (speechMarks)
+	{
+		request.SetOutputFormat(OutputFormat::json);
+		request.AddSpeechMarkTypes(SpeechMarkType::word);
+	}
+	else
+	{
+		request.SetOutputFormat(OutputFormat::pcm);
+	}
+
+	std::string text = piece.Text;
+	auto key = RequestKey(output, text);
+	auto fetched = co_await FetchShared(request, key, text, piece.Ssml,
+		speechMarks ? PollyHedgePolicy::ForMarks() : PollyHedgePolicy::ForAudio(),
+		speechMarks ? PollyStage::PollyMarksRtt : PollyStage::PollyAudioRtt);
+	// Fragments are joined as PCM
+	if (fetched.Body && PollyAdpcm::IsEncoded(*fetched.Body))
+	{
+		fetched.Body = std::make_shared<const std::string>(PollyAdpcm::Decode(*fetched.Body));
+	}
+	PollyPromptTemplate::Fragments().Store(key, fetched.Body);
+	co_return fetched;
+}
+
+PollyFetchResult PollyManager::FetchLongForm(const std::string& text, bool isSsml, bool speechMarks,
+	const PollyLongForm::Sink& sink, std::streamsize& length)
+{
+	PollyFetchResult result;
+	PollyLongForm::Request request;
+	request.Voice = m_vVoiceId;
+	request.Text = text;
+	request.Ssml = isSsml;
+	request.SpeechMarks = speechMarks;
+	request.SampleRate = PollyAudio::SampleRate(m_format);
+	bool encode = !speechMarks && PollyAudio::SampleBytes(m_format) == 1;
+	auto body = std::make_shared<std::string>();
+	length = 0;
+	// A download chunk can end in the middle of a sample
+	std::string pending, encoded;
+	bool succeeded = PollyLongForm::Synthesize(request, [&](const char* data, size_t size) {
+		if (encode)
+		{
+			pending.append(data, size);
+			size_t samples = pending.size() / 2;
+			encoded.resize(samples);
+			if (samples > 0)
+			{
+				(m_format == PollyAudioFormat::MuLaw8k ? PollyAudio::EncodeMuLaw : PollyAudio::EncodeALaw)(
+					pending.data(), samples, &encoded[0]);
+			}
+			pending.erase(0, 2 * samples);
+			data = encoded.data();
+			size = samples;
+		}
+		length += static_cast<std::streamsize>(size);
+		if (sink)
+		{
+			return size == 0 || sink(data, size);
+		}
+		body->append(data, size);
+		return true;
+	}, result.ErrorMessage);
+	if (succeeded)
+	{
+		// Empty when the output went to `sink`
+		result.Body = body;
+	}
+	return result;
+}
+
+std::string PollyManager::ShiftMarks(const std::string& json, uint32_t earlierMs)
+{
+	std::istringstream lines(json);
+	std::string shifted;
+	std::string line;
+	while (getline(lines, line))
+	{
+		rapidjson::Document d;
+		d.Parse(line.c_str());
+		if (!d.HasParseError() && d.IsObject() && d.HasMember("time") && d["time"].IsInt())
+		{
+			d["time"].SetInt(std::max(0, d["time"].GetInt() - static_cast<int>(earlierMs)));
+			rapidjson::StringBuffer buffer;
+			rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+			d.Accept(writer);
+			line.assign(buffer.GetString(), buffer.GetSize());
+		}
+		shifted += line;
+		shifted.push_back('\n');
+	}
+	return shifted;
+}
+
+std::string PollyManager::RequestKey(const char* kind, const std::string& text)
+{
+	return PollyPhraseStore::Key(VoiceIdMapper::GetNameForVoiceId(m_vVoiceId).c_str(), kind, text);
 }
 
 std::string PollyManager::ParseXMLOutput(std::string &xmlBuffer)
@@ -130,43 +694,62 @@ std::string PollyManager::ParseXMLOutput(std::string &xmlBuffer)
 	return plainString;
 }
 
-PollySpeechMarksResponse PollyManager::GenerateSpeechMarks(CSentItem& item, std::streamsize streamSize)
+PollySpeechMarksResponse PollyManager::GenerateSpeechMarks(const std::string& speechText, std::streamsize streamSize)
 {
+	ScopedTraceSpan span("GenerateSpeechMarks");
 	SynthesizeSpeechRequest speechMarksRequest;
 	PollySpeechMarksResponse response;
-	Aws::Polly::PollyClient p = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>(ALLOCATION_TAG, "polly-windows");
-	auto text = Aws::Utils::StringUtils::FromWString(item.pItem);
-	m_logger->debug("{}: Asking Polly for '{}'", __FUNCTION__, text.c_str());
+	auto canonical = Canonicalize(speechText);
+	auto text = canonical.Text;
+	bool isSsml = canonical.Ssml;
+	POLLY_LOG_DEBUG(m_logger, "{}: Asking Polly for '{}'", __FUNCTION__, text.c_str());
 	speechMarksRequest.SetOutputFormat(OutputFormat::json);
 	speechMarksRequest.SetVoiceId(m_vVoiceId);
 	speechMarksRequest.SetText(text);
 	speechMarksRequest.AddSpeechMarkTypes(SpeechMarkType::word);
-	if (Aws::Utils::StringUtils::ToLower(text.c_str()).find("<speak") == 0)
+	if (isSsml)
 	{
-		m_logger->debug("Text type = ssml");
+		POLLY_LOG_DEBUG(m_logger, "Text type = ssml");
 		speechMarksRequest.SetTextType(TextType::ssml);
 	}
 	else
 	{
-		m_logger->debug("Text type = text");
+		POLLY_LOG_DEBUG(m_logger, "Text type = text");
 		speechMarksRequest.SetTextType(TextType::text);
 	}
 	speechMarksRequest.SetSampleRate("16000");
-	auto speech_marks = p.SynthesizeSpeech(speechMarksRequest);
-	if (!speech_marks.IsSuccess())
+	PollyFetchResult fetched;
+	if (m_assembledMarks && text == m_sAssembledText)
 	{
-		std::stringstream error;
-		error << "Unable to generate speech marks: " << speech_marks.GetError().GetMessageW();
-		response.ErrorMessage = error.str();
+		fetched.Body = m_assembledMarks;
+	}
+	else if (PollyLongForm::Applies(static_cast<size_t>(BilledCharacters(text, isSsml))))
+	{
+		std::streamsize length = 0;
+		fetched = FetchLongForm(text, isSsml, true, nullptr, length);
+	}
+	else
+	{
+		auto key = RequestKey(PollyPhraseStore::MarksOutput, text);
+		PollyCallerLoop loop;
+		fetched = loop.Run(FetchShared(speechMarksRequest, key, text, isSsml, PollyHedgePolicy::ForMarks(),
+			PollyStage::PollyMarksRtt));
+	}
+	if (!fetched.Body)
+	{
+		response.ErrorMessage = "Unable to generate speech marks: " + fetched.ErrorMessage;
 		return response;
 	}
-	auto &m = speech_marks.GetResult();
-	auto& m_stream = m.GetAudioStream();
+	if (m_trimmedHeadMs > 0 && speechText == m_sTrimmedText)
+	{
+		fetched.Body = std::make_shared<const std::string>(ShiftMarks(*fetched.Body, m_trimmedHeadMs));
+	}
+	response.Json = fetched.Body;
+	std::istringstream m_stream(*fetched.Body);
 	std::string json_str;
 	std::vector<SpeechMark> speechMarks;
 	auto firstWord = true;
 	long bytesProcessed = 0;
-	m_logger->debug("SpeechMarks response:\n\n{}\n\n", json_str);
 	while (getline(m_stream, json_str)) {
 		SpeechMark sm;
 		rapidjson::Document d;
@@ -182,25 +765,31 @@ PollySpeechMarksResponse PollyManager::GenerateSpeechMarks(CSentItem& item, std:
 		{
 			auto currentSm = speechMarks[speechMarks.size()-1];
 			currentSm.TimeInMs = sm.StartInMs - currentSm.StartInMs;
-			currentSm.LengthInBytes = 32 * currentSm.TimeInMs;
+			currentSm.LengthInBytes = PollyAudio::BytesPerMs(m_format) * currentSm.TimeInMs;
 			displaySpeechMark = currentSm;
 			bytesProcessed += currentSm.LengthInBytes;
 			speechMarks[speechMarks.size() - 1] = currentSm;
 		}
-		m_logger->debug("Word: {}, Start: {}, End: {}, Time: {}\n", sm.Text.c_str(), sm.StartInMs,
+		POLLY_LOG_TRACE(m_logger, "Word: {}, Start: {}, End: {}, Time: {}", sm.Text, sm.StartInMs,
 			sm.EndByte,
 			sm.TimeInMs);
 		speechMarks.push_back(sm);
 		firstWord = false;
 	}
+	if (speechMarks.empty())
+	{
+		// Nothing was spoken, e.g. SSML with only a break
+		response.SpeechMarks = speechMarks;
+		return response;
+	}
 	auto sm = speechMarks[speechMarks.size() - 1];
 	sm.LengthInBytes = streamSize - bytesProcessed;
-	sm.TimeInMs = sm.LengthInBytes / 32;
+	sm.TimeInMs = sm.LengthInBytes / PollyAudio::BytesPerMs(m_format);
 	speechMarks[speechMarks.size() - 1] = sm;
-	m_logger->debug("Word: {}, Start: {}, End: {}, Time: {}\n", sm.Text.c_str(), sm.StartInMs,
+	POLLY_LOG_TRACE(m_logger, "Word: {}, Start: {}, End: {}, Time: {}", sm.Text, sm.StartInMs,
 		sm.EndByte,
 		sm.TimeInMs);
-	m_logger->debug("Total words generated: {}", speechMarks.size());
+	POLLY_LOG_DEBUG(m_logger, "Total words generated: {}", speechMarks.size());
 	speechMarks.push_back(sm);
 	response.SpeechMarks = speechMarks;
 	return response;
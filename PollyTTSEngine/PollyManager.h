@@ -14,80 +14,84 @@ permissions and limitations under the License. */
 #include "PollySpeechResponse.h"
 #include "PollySpeechMarksResponse.h"
 #include "aws/polly/model/VoiceId.h"
-#include <unordered_map>
-#include "spdlog/spdlog.h"
+#include "aws/polly/model/SynthesizeSpeechRequest.h"
+#include "aws/polly/PollyClient.h"
+#include <chrono>
+#include "PollyLog.h"
+#include "PollyHedge.h"
+#include "PollyMetrics.h"
+#include "PollySingleFlight.h"
+#include "PollyPromptTemplate.h"
+#include "PollyLongForm.h"
+#include "PollyCanonicalText.h"
+#include "PollyAudioFormat.h"
+#include "PollyExecutor.h"
 namespace spd = spdlog;
 
-class CSentItem;
 using namespace Aws::Polly::Model;
 
 class PollyManager
 {
 public:
-	PollyManager(LPWSTR voiceName);
-	PollySpeechResponse GenerateSpeech(CSentItem& item);
+	// Audio is returned, and cached, in `format`
+	PollyManager(const std::wstring& voiceName, PollyAudioFormat format = PollyAudioFormat::Pcm16k);
+	// Text or SSML, in UTF-8. Long-form audio, and audio from a compressed
+	// cache entry, is passed to `sink`, if given, as it downloads or
+	// decodes, instead of being returned in AudioData. With TRIM_SILENCE,
+	// leading and trailing silence is trimmed from PCM on the way, and the
+	// speech marks of the same text are moved to match.
+	PollySpeechResponse GenerateSpeech(const std::string& text, const PollyLongForm::Sink& sink = nullptr);
+	// True if `text` is long enough to be synthesized as a long-form task,
+	// whose audio GenerateSpeech passes to its sink as it downloads
+	static bool IsLongForm(const std::string& text);
+	// GenerateSpeech as a task for coroutines on the PollyExecutor. Polly
+	// calls hold no thread while they wait; long-form texts, which do, run
+	// on the executor's blocking pool.
+	PollyTask<PollySpeechResponse> GenerateSpeechAsync(std::string text);
 	std::string ParseXMLOutput(std::string& xmlBuffer);
-	PollySpeechMarksResponse PollyManager::GenerateSpeechMarks(CSentItem& item, std::streamsize streamSize);
-	void SetVoice(LPWSTR voiceName);
+	PollySpeechMarksResponse GenerateSpeechMarks(const std::string& text, std::streamsize streamSize);
+	void SetVoice(const std::wstring& voiceName);
+	VoiceId GetVoiceId() const { return m_vVoiceId; }
 
 private:
+	// `caller` is the loop of the thread that called GenerateSpeech, which
+	// the task returns to after awaiting Polly; null when the task runs on
+	// the PollyExecutor, whose threads must not block
+	PollyTask<PollySpeechResponse> Generate(std::string text, PollyLongForm::Sink sink, PollyCallerLoop* caller);
+	PollyTask<PollySpeechResponse> GenerateAudio(const std::string& text, const PollyLongForm::Sink& sink,
+		PollyCallerLoop* caller);
+	// The text Polly is asked to speak for `text`, before canonicalization
+	static std::string SpeechText(std::string text);
+	// Moves the times of JSON speech marks `earlierMs` earlier
+	static std::string ShiftMarks(const std::string& json, uint32_t earlierMs);
+	std::streamsize BilledCharacters(std::string& text, bool isSsml);
+	// Canonical form of `text`, counting the characters it saves
+	PollyCanonicalText Canonicalize(const std::string& text);
+	static void TagRequest(SynthesizeSpeechRequest& request);
+	// True if CACHE_CODEC asks for PCM cache entries to be stored as IMA-ADPCM
+	static bool CompressCache();
+	std::string RequestKey(const char* kind, const std::string& text);
+	PollyTask<PollySpeechResponse> AssembleSpeech(const std::string& text, const std::vector<PollyPromptPiece>& pieces);
+	// Spawned on the PollyExecutor, so it owns its piece
+	PollyTask<PollyFetchResult> FetchFragment(PollyPromptPiece piece, const char* output);
+	PollyFetchResult FetchLongForm(const std::string& text, bool isSsml, bool speechMarks,
+		const PollyLongForm::Sink& sink, std::streamsize& length);
+	// Fetch, merged with the callers asking for the same key at the same time
+	PollyTask<PollyFetchResult> FetchShared(SynthesizeSpeechRequest& request, const std::string& key,
+		std::string& text, bool isSsml, PollyHedgePolicy& policy, PollyStage rttStage);
+	PollyTask<PollyFetchResult> Fetch(SynthesizeSpeechRequest& request, const std::string& key, std::string& text,
+		bool isSsml, PollyHedgePolicy& policy, PollyStage rttStage);
+	PollyTask<SynthesizeSpeechOutcome> Synthesize(const std::shared_ptr<Aws::Polly::PollyClient>& client,
+		const SynthesizeSpeechRequest& request, PollyHedgePolicy& policy);
+
 	std::wstring m_sVoiceName;
+	PollyAudioFormat m_format;
+	// Speech marks of the last prompt assembled from template fragments
+	std::string m_sAssembledText;
+	PollyPayloadCache::Payload m_assembledMarks;
+	// Text of the last speech trimmed, and the silence cut from its start
+	std::string m_sTrimmedText;
+	uint32_t m_trimmedHeadMs;
 	std::shared_ptr<spd::logger> m_logger;
 	VoiceId m_vVoiceId;
-	std::unordered_map<std::wstring, VoiceId> vm = {
-		{ L"Aditi",		   VoiceId::Aditi },
-		{ L"Amy",		   VoiceId::Amy },
-		{ L"Astrid",       VoiceId::Astrid },
-		{ L"Brian",		   VoiceId::Brian },
-		{ L"Carla",        VoiceId::Carla },
-		{ L"Carmen",	   VoiceId::Carmen },
-		{ L"Celine",       VoiceId::Celine },
-		{ L"Chantal",      VoiceId::Chantal },
-		{ L"Conchita",     VoiceId::Conchita },
-		{ L"Cristiano",    VoiceId::Cristiano },
-		{ L"Dora",         VoiceId::Dora },
-		{ L"Emma",         VoiceId::Emma },
-		{ L"Enrique",      VoiceId::Enrique },
-		{ L"Ewa",          VoiceId::Ewa },
-		{ L"Filiz",        VoiceId::Filiz },
-		{ L"Geraint",      VoiceId::Geraint },
-		{ L"Giorgio",      VoiceId::Giorgio },
-		{ L"Gwyneth",      VoiceId::Gwyneth },
-		{ L"Hans",         VoiceId::Hans },
-		{ L"Ines",         VoiceId::Ines },
-		{ L"Ivy"    ,      VoiceId::Ivy },
-		{ L"Jacek",        VoiceId::Jacek },
-		{ L"Jan",		   VoiceId::Jan },
-		{ L"Joanna",	   VoiceId::Joanna },
-		{ L"Joey",		   VoiceId::Joey },
-		{ L"Justin",	   VoiceId::Justin },
-		{ L"Karl",		   VoiceId::Karl },
-		{ L"Kendra",	   VoiceId::Kendra },
-		{ L"Kimberly",	   VoiceId::Kimberly },
-		{ L"Liv",	       VoiceId::Liv },
-		{ L"Lotte",	       VoiceId::Lotte },
-		{ L"Mads",	       VoiceId::Mads },
-		{ L"Maja",	       VoiceId::Maja },
-		{ L"Marlene",	   VoiceId::Marlene },
-		{ L"Mathieu",	   VoiceId::Mathieu },
-		{ L"Matthew",	   VoiceId::Matthew },
-		{ L"Maxim",	       VoiceId::Maxim },
-		{ L"Miguel",	   VoiceId::Miguel },
-		{ L"Mizuki",	   VoiceId::Mizuki },
-		{ L"Naja",	       VoiceId::Naja },
-		{ L"Nicole",	   VoiceId::Nicole },
-		{ L"Penelope",	   VoiceId::Penelope },
-		{ L"Raveena",	   VoiceId::Raveena },
-		{ L"Ricardo",	   VoiceId::Ricardo },
-		{ L"Ruben",	       VoiceId::Ruben },
-		{ L"Russell",	   VoiceId::Russell },
-		{ L"Salli",	       VoiceId::Salli },
-		{ L"Seoyeon",	   VoiceId::Seoyeon },
-		{ L"Takumi",	   VoiceId::Takumi },
-		{ L"Tatyana",	   VoiceId::Tatyana },
-		{ L"Vicki",	       VoiceId::Vicki },
-		{ L"Vitoria",	   VoiceId::Vitoria },
-		{L"Zhiyu",		   VoiceId::Zhiyu}
-	};
-
 };
\ No newline at end of file
@@ -0,0 +1,358 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyMetrics.h"
+#include "PollyConfig.h"
+#include "PollyRegions.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Aws::Polly::Model;
+
+namespace
+{
+	const int kSubBits = 4;
+	const int kSub = 1 << kSubBits;
+	const int kMaxMsb = 35;
+	const int kBuckets = PollyMetricsSharedSnapshot::Buckets;
+	const int kMaxVoices = PollyMetricsSharedSnapshot::MaxVoices;
+	const int kStages = static_cast<int>(PollyStage::Count);
+	const int kCounters = static_cast<int>(PollyCounter::Count);
+	static_assert(kBuckets == (kMaxMsb - kSubBits + 2) * kSub, "bucket layout mismatch");
+
+	const char* StageNames[kStages] = {
+		"tokenize", "ssml_preprocess", "client_acquire", "polly_audio_rtt", "polly_marks_rtt",
+		"first_byte", "decode", "sapi_write", "sapi_events", "first_speak_cold", "first_speak_warm",
+		"playout_depth"
+	};
+
+	struct CounterInfo
+	{
+		const char* name;
+		const char* help;
+	};
+	const CounterInfo CounterInfos[kCounters] = {
+		{ "polly_tts_requests_total", "Synthesis requests sent to Polly." },
+		{ "polly_tts_audio_bytes_total", "PCM bytes returned by Polly." },
+		{ "polly_tts_billed_characters_total", "Characters billed by Polly." },
+		{ "polly_tts_cache_hits_total", "Requests answered without calling Polly." },
+		{ "polly_tts_errors_total", "Failed synthesis requests." },
+		{ "polly_tts_hedges_total", "Duplicate requests sent because the first one was slow." },
+		{ "polly_tts_hedge_wins_total", "Hedged requests that answered before the original." },
+		{ "polly_tts_merged_requests_total", "Requests answered by an identical request already in flight." },
+		{ "polly_tts_assembled_prompts_total", "Prompts joined from cached template fragments." },
+		{ "polly_tts_canonical_saved_characters_total", "Billed characters saved by canonicalizing the text." },
+		{ "polly_tts_playout_underruns_total", "Times streamed audio ran out during playback." },
+		{ "polly_tts_playout_overruns_total", "Times the playout buffer was full and the stream reader waited." }
+	};
+
+	// One shard per live thread. Only the owning thread writes to it, so
+	// updates are plain relaxed load/store pairs without read-modify-write.
+	struct ThreadShard
+	{
+		std::atomic<bool> inUse;
+		std::atomic<uint64_t> counters[kCounters][kMaxVoices];
+		std::atomic<uint64_t> stageCount[kStages];
+		std::atomic<uint64_t> stageSum[kStages];
+		std::atomic<uint64_t> buckets[kStages][kBuckets];
+
+		ThreadShard() : inUse(true)
+		{
+			for (auto& row : counters) for (auto& c : row) c.store(0, std::memory_order_relaxed);
+			for (auto& c : stageCount) c.store(0, std::memory_order_relaxed);
+			for (auto& c : stageSum) c.store(0, std::memory_order_relaxed);
+			for (auto& row : buckets) for (auto& c : row) c.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	std::mutex g_shardLock;
+	std::vector<ThreadShard*> g_shards; // shards are recycled, never freed
+
+	ThreadShard* AcquireShard()
+	{
+		std::lock_guard<std::mutex> lock(g_shardLock);
+		for (auto shard : g_shards)
+		{
+			bool expected = false;
+			if (shard->inUse.compare_exchange_strong(expected, true))
+			{
+				return shard;
+			}
+		}
+		g_shards.push_back(new ThreadShard());
+		return g_shards.back();
+	}
+
+	struct ShardHandle
+	{
+		ThreadShard* shard;
+		ShardHandle() : shard(AcquireShard()) {}
+		~ShardHandle() { shard->inUse.store(false); }
+	};
+
+	ThreadShard& LocalShard()
+	{
+		thread_local ShardHandle handle;
+		return *handle.shard;
+	}
+
+	inline void Add(std::atomic<uint64_t>& cell, uint64_t value)
+	{
+		cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	int MostSignificantBit(uint64_t value)
+	{
+		int msb = 0;
+		while (value >>= 1) ++msb;
+		return msb;
+	}
+
+	int BucketIndex(uint64_t micros)
+	{
+		if (micros < static_cast<uint64_t>(kSub))
+		{
+			return static_cast<int>(micros);
+		}
+		int msb = MostSignificantBit(micros);
+		if (msb > kMaxMsb)
+		{
+			return kBuckets - 1;
+		}
+		int shift = msb - kSubBits;
+		return (shift + 1) * kSub + static_cast<int>((micros >> shift) - kSub);
+	}
+
+	double BucketMidpointMicros(int index)
+	{
+		if (index < kSub)
+		{
+			return index;
+		}
+		int shift = index / kSub - 1;
+		uint64_t lower = static_cast<uint64_t>(kSub + index % kSub) << shift;
+		return lower + (static_cast<uint64_t>(1) << shift) / 2.0;
+	}
+
+	double Quantile(const uint64_t (&buckets)[kBuckets], uint64_t count, double q)
+	{
+		if (count == 0)
+		{
+			return 0;
+		}
+		uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < kBuckets; i++)
+		{
+			seen += buckets[i];
+			if (seen >= rank)
+			{
+				return BucketMidpointMicros(i);
+			}
+		}
+		return BucketMidpointMicros(kBuckets - 1);
+	}
+
+	int VoiceSlot(VoiceId voice)
+	{
+		int slot = static_cast<int>(voice);
+		return (slot > 0 && slot < kMaxVoices) ? slot : 0;
+	}
+
+	uint32_t CurrentProcessId()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	void WriteFileAtomically(const std::string& path, const std::string& contents)
+	{
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			if (!out)
+			{
+				return;
+			}
+			out << contents;
+		}
+#ifdef _WIN32
+		MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+		std::rename(temp.c_str(), path.c_str());
+#endif
+	}
+
+	void ExportLoop(std::string file, bool publishSharedMemory, long intervalMs)
+	{
+		PollyMetricsSharedSnapshot* shared = nullptr;
+#ifdef _WIN32
+		if (publishSharedMemory)
+		{
+			std::string name = "Local\\PollyTTSMetrics-" + std::to_string(CurrentProcessId());
+			HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+				sizeof(PollyMetricsSharedSnapshot), name.c_str());
+			if (mapping != NULL)
+			{
+				shared = static_cast<PollyMetricsSharedSnapshot*>(
+					MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(PollyMetricsSharedSnapshot)));
+			}
+			if (shared != nullptr)
+			{
+				shared->magic = PollyMetricsSharedSnapshot::Magic;
+				shared->version = PollyMetricsSharedSnapshot::Version;
+				shared->processId = CurrentProcessId();
+			}
+		}
+#else
+		(void)publishSharedMemory;
+#endif
+
+		for (;;)
+		{
+			if (shared != nullptr)
+			{
+				shared->sequence.fetch_add(1, std::memory_order_acq_rel);
+				PollyMetrics::Collect(*shared);
+				shared->timestampMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count());
+				shared->sequence.fetch_add(1, std::memory_order_acq_rel);
+			}
+			if (!file.empty())
+			{
+				WriteFileAtomically(file, PollyMetrics::FormatPrometheus());
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+		}
+	}
+}
+
+void PollyMetrics::RecordLatency(PollyStage stage, std::chrono::steady_clock::duration elapsed)
+{
+	auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+	int s = static_cast<int>(stage);
+	auto& shard = LocalShard();
+	Add(shard.stageCount[s], 1);
+	Add(shard.stageSum[s], value);
+	Add(shard.buckets[s][BucketIndex(value)], 1);
+}
+
+void PollyMetrics::Increment(PollyCounter counter, VoiceId voice, uint64_t value)
+{
+	Add(LocalShard().counters[static_cast<int>(counter)][VoiceSlot(voice)], value);
+}
+
+void PollyMetrics::Collect(PollyMetricsSharedSnapshot& snapshot)
+{
+	memset(snapshot.counters, 0, sizeof(snapshot.counters));
+	memset(snapshot.stageCount, 0, sizeof(snapshot.stageCount));
+	memset(snapshot.stageSumMicros, 0, sizeof(snapshot.stageSumMicros));
+	memset(snapshot.stageBuckets, 0, sizeof(snapshot.stageBuckets));
+
+	std::lock_guard<std::mutex> lock(g_shardLock);
+	for (auto shard : g_shards)
+	{
+		for (int c = 0; c < kCounters; c++)
+			for (int v = 0; v < kMaxVoices; v++)
+				snapshot.counters[c][v] += shard->counters[c][v].load(std::memory_order_relaxed);
+		for (int s = 0; s < kStages; s++)
+		{
+			snapshot.stageCount[s] += shard->stageCount[s].load(std::memory_order_relaxed);
+			snapshot.stageSumMicros[s] += shard->stageSum[s].load(std::memory_order_relaxed);
+			for (int b = 0; b < kBuckets; b++)
+				snapshot.stageBuckets[s][b] += shard->buckets[s][b].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+std::string PollyMetrics::FormatPrometheus()
+{
+	std::unique_ptr<PollyMetricsSharedSnapshot> snapshot(new PollyMetricsSharedSnapshot());
+	Collect(*snapshot);
+
+	std::ostringstream out;
+	out << "# HELP polly_tts_stage_latency_seconds Latency of each synthesis stage.\n";
+	out << "# TYPE polly_tts_stage_latency_seconds summary\n";
+	static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	for (int s = 0; s < kStages; s++)
+	{
+		for (double q : quantiles)
+		{
+			out << "polly_tts_stage_latency_seconds{stage=\"" << StageNames[s] << "\",quantile=\"" << q << "\"} "
+				<< Quantile(snapshot->stageBuckets[s], snapshot->stageCount[s], q) / 1e6 << "\n";
+		}
+		out << "polly_tts_stage_latency_seconds_sum{stage=\"" << StageNames[s] << "\"} "
+			<< snapshot->stageSumMicros[s] / 1e6 << "\n";
+		out << "polly_tts_stage_latency_seconds_count{stage=\"" << StageNames[s] << "\"} "
+			<< snapshot->stageCount[s] << "\n";
+	}
+
+	for (int c = 0; c < kCounters; c++)
+	{
+		out << "# HELP " << CounterInfos[c].name << " " << CounterInfos[c].help << "\n";
+		out << "# TYPE " << CounterInfos[c].name << " counter\n";
+		for (int v = 0; v < kMaxVoices; v++)
+		{
+			if (snapshot->counters[c][v] == 0)
+			{
+				continue;
+			}
+			std::string voice = v == 0 ? "unknown" : VoiceIdMapper::GetNameForVoiceId(static_cast<VoiceId>(v)).c_str();
+			out << CounterInfos[c].name << "{voice=\"" << voice << "\"} " << snapshot->counters[c][v] << "\n";
+		}
+	}
+	out << PollyRegions::FormatPrometheus();
+	return out.str();
+}
+
+void PollyMetrics::StartExporter()
+{
+	static std::once_flag started;
+	std::call_once(started, []()
+	{
+		std::string file = PollyConfig::GetString("METRICS_FILE");
+		bool publishSharedMemory = PollyConfig::GetBool("METRICS_SHM", false);
+		long intervalMs = PollyConfig::GetLong("METRICS_INTERVAL_MS", 10000);
+		if (file.empty() && !publishSharedMemory)
+		{
+			return;
+		}
+		if (intervalMs < 100)
+		{
+			intervalMs = 100;
+		}
+#ifdef _WIN32
+		// The exporter thread runs for the life of the process, so keep the
+		// DLL loaded even after COM releases every engine object.
+		HMODULE self;
+		GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+			reinterpret_cast<LPCSTR>(&PollyMetrics::StartExporter), &self);
+#endif
+		std::thread(ExportLoop, file, publishSharedMemory, intervalMs).detach();
+	});
+}
@@ -0,0 +1,124 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "aws/polly/model/VoiceId.h"
+
+// Stages of the synthesis pipeline that get a latency histogram.
+enum class PollyStage
+{
+	Tokenize,
+	SsmlPreprocess,
+	ClientAcquire,
+	PollyAudioRtt,
+	PollyMarksRtt,
+	FirstByte,
+	Decode,
+	SapiWrite,
+	SapiEvents,
+	// Whole first Speak of an engine object, split by whether the
+	// connection pre-warm had finished when it started
+	FirstSpeakCold,
+	FirstSpeakWarm,
+	// Mean playout buffer depth of each streamed utterance
+	PlayoutDepth,
+	Count
+};
+
+// Counters that are kept per voice.
+enum class PollyCounter
+{
+	Requests,
+	AudioBytes,
+	BilledCharacters,
+	CacheHits,
+	Errors,
+	Hedges,
+	HedgeWins,
+	Merged,
+	AssembledPrompts,
+	CanonicalSavedCharacters,
+	PlayoutUnderruns,
+	PlayoutOverruns,
+	Count
+};
+
+// Layout of the shared-memory snapshot published by the exporter when
+// POLLY_TTS_METRICS_SHM is set. The mapping is named
+// "Local\PollyTTSMetrics-<pid>". Readers must copy the snapshot while
+// `sequence` is even and unchanged across the copy (seqlock).
+struct PollyMetricsSharedSnapshot
+{
+	static const uint32_t Magic = 0x504D5453; // "PMTS"
+	static const uint32_t Version = 4;
+	static const int MaxVoices = 128;
+	static const int SubBuckets = 16;
+	static const int Buckets = 528;
+
+	uint32_t magic;
+	uint32_t version;
+	std::atomic<uint32_t> sequence;
+	uint32_t processId;
+	uint64_t timestampMs;
+	uint64_t counters[static_cast<int>(PollyCounter::Count)][MaxVoices];
+	uint64_t stageCount[static_cast<int>(PollyStage::Count)];
+	uint64_t stageSumMicros[static_cast<int>(PollyStage::Count)];
+	uint64_t stageBuckets[static_cast<int>(PollyStage::Count)][Buckets];
+};
+
+// Process-wide counters and HDR-style latency histograms (log-linear buckets,
+// ~6% precision, 1us to ~19h). Each thread records into its own shard with
+// relaxed atomics, so recording never takes a lock; readers merge the shards.
+class PollyMetrics
+{
+public:
+	static void RecordLatency(PollyStage stage, std::chrono::steady_clock::duration elapsed);
+	static void Increment(PollyCounter counter, Aws::Polly::Model::VoiceId voice, uint64_t value = 1);
+
+	// Merges every thread shard into `snapshot` (the seqlock fields are left alone).
+	static void Collect(PollyMetricsSharedSnapshot& snapshot);
+	static std::string FormatPrometheus();
+
+	// Starts the periodic exporter if POLLY_TTS_METRICS_FILE or
+	// POLLY_TTS_METRICS_SHM is configured. Safe to call more than once.
+	static void StartExporter();
+};
+
+// Records the time between construction and destruction into a stage histogram.
+class ScopedStageTimer
+{
+public:
+	explicit ScopedStageTimer(PollyStage stage)
+		: m_stage(stage), m_start(std::chrono::steady_clock::now()), m_stopped(false) {}
+	~ScopedStageTimer() { Stop(); }
+
+	void Stop()
+	{
+		if (!m_stopped)
+		{
+			m_stopped = true;
+			PollyMetrics::RecordLatency(m_stage, std::chrono::steady_clock::now() - m_start);
+		}
+	}
+
+	ScopedStageTimer(const ScopedStageTimer&) = delete;
+	ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+	PollyStage m_stage;
+	std::chrono::steady_clock::time_point m_start;
+	bool m_stopped;
+};
@@ -0,0 +1,64 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyPayloadCache.h"
+#include "PollyConfig.h"
+#include <algorithm>
+
+PollyPayloadCache& PollyPayloadCache::LastKnownGood()
+{
+	static PollyPayloadCache cache("LKG_MAX_BYTES", 32 * 1024 * 1024);
+	return cache;
+}
+
+PollyPayloadCache::PollyPayloadCache(const char* maxBytesSetting, long defaultMaxBytes)
+	: m_bytes(0)
+{
+	m_maxBytes = static_cast<size_t>(std::max(0L, PollyConfig::GetLong(maxBytesSetting, defaultMaxBytes)));
+}
+
+PollyPayloadCache::Payload PollyPayloadCache::Find(const std::string& key)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_index.find(key);
+	if (found == m_index.end())
+	{
+		return nullptr;
+	}
+	m_entries.splice(m_entries.begin(), m_entries, found->second);
+	return found->second->second;
+}
+
+void PollyPayloadCache::Store(const std::string& key, const Payload& payload)
+{
+	if (!payload || payload->size() > m_maxBytes)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_index.find(key);
+	if (found != m_index.end())
+	{
+		m_bytes -= found->second->second->size();
+		m_entries.erase(found->second);
+		m_index.erase(found);
+	}
+	m_entries.emplace_front(key, payload);
+	m_index[key] = m_entries.begin();
+	m_bytes += payload->size();
+	while (m_bytes > m_maxBytes)
+	{
+		auto& oldest = m_entries.back();
+		m_bytes -= oldest.second->size();
+		m_index.erase(oldest.first);
+		m_entries.pop_back();
+	}
+}
@@ -0,0 +1,45 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// LRU of immutable, refcounted payloads (audio or speech marks), bounded by
+// the total payload size.
+class PollyPayloadCache
+{
+public:
+	typedef std::shared_ptr<const std::string> Payload;
+
+	// Recent successful responses, served when Polly cannot be reached.
+	// Bounded by LKG_MAX_BYTES.
+	static PollyPayloadCache& LastKnownGood();
+
+	// Reads the size limit from the `maxBytesSetting` configuration value.
+	PollyPayloadCache(const char* maxBytesSetting, long defaultMaxBytes);
+
+	Payload Find(const std::string& key);
+	void Store(const std::string& key, const Payload& payload);
+
+private:
+	typedef std::list<std::pair<std::string, Payload>> EntryList;
+
+	std::mutex m_lock;
+	EntryList m_entries; // most recently used first
+	std::unordered_map<std::string, EntryList::iterator> m_index;
+	size_t m_bytes;
+	size_t m_maxBytes;
+};
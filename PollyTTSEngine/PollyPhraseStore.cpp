@@ -0,0 +1,250 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyPhraseStore.h"
+#include "PollyConfig.h"
+#include "PollyHash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const char kMagic[4] = { 'P', 'P', 'S', '1' };
+	const char* kExtension = ".phrase";
+	const auto kIndexCheckInterval = std::chrono::seconds(1);
+
+	std::string DefaultDirectory()
+	{
+		const char* programData = std::getenv("ProgramData");
+		if (programData == nullptr || *programData == '\0')
+		{
+			return "";
+		}
+		return std::string(programData) + "\\Amazon\\PollyTTS\\Phrases";
+	}
+
+	void CreateDirectories(const std::string& path)
+	{
+		for (size_t i = 1; i <= path.size(); i++)
+		{
+			if (i == path.size() || path[i] == '\\' || path[i] == '/')
+			{
+				std::string partial = path.substr(0, i);
+#ifdef _WIN32
+				CreateDirectoryA(partial.c_str(), nullptr);
+#else
+				mkdir(partial.c_str(), 0755);
+#endif
+			}
+		}
+	}
+}
+
+const char* const PollyPhraseStore::PcmOutput = "pcm16000";
+const char* const PollyPhraseStore::MarksOutput = "marks";
+
+PollyPhraseStore& PollyPhraseStore::Instance()
+{
+	static PollyPhraseStore store;
+	return store;
+}
+
+PollyPhraseStore::PollyPhraseStore()
+	: m_indexListed(false), m_indexStamp(0)
+{
+	m_directory = PollyConfig::GetString("PHRASE_STORE", DefaultDirectory());
+}
+
+std::string PollyPhraseStore::Key(const std::string& voiceName, const char* output, const std::string& text)
+{
+	std::string key = voiceName;
+	key.append(1, '\0').append(output).append(1, '\0').append(text);
+	return PollyHash::Digest(key);
+}
+
+uint64_t PollyPhraseStore::Hash(const std::string& key)
+{
+	// FNV-1a; collisions are caught by comparing the stored key
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : key)
+	{
+		hash = (hash ^ c) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string PollyPhraseStore::PathFor(uint64_t hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+	return m_directory + "/" + name + kExtension;
+}
+
+int64_t PollyPhraseStore::DirectoryStamp() const
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(m_directory.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return 0;
+	}
+	return (static_cast<int64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+		attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat status;
+	if (stat(m_directory.c_str(), &status) != 0)
+	{
+		return 0;
+	}
+	return static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+}
+
+void PollyPhraseStore::RefreshIndex()
+{
+	auto now = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_indexListed && now - m_indexChecked < kIndexCheckInterval)
+		{
+			return;
+		}
+		m_indexChecked = now;
+	}
+	// Taken before listing, so an entry added meanwhile changes it again
+	int64_t stamp = DirectoryStamp();
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_indexListed && stamp == m_indexStamp)
+		{
+			return;
+		}
+	}
+
+	std::unordered_set<uint64_t> index;
+	const size_t nameLength = 16 + strlen(kExtension);
+	auto add = [&index, nameLength](const char* name)
+	{
+		if (strlen(name) == nameLength && strcmp(name + 16, kExtension) == 0)
+		{
+			index.insert(strtoull(std::string(name, 16).c_str(), nullptr, 16));
+		}
+	};
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((m_directory + "\\*" + kExtension).c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			add(found.cFileName);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+	}
+#else
+	if (DIR* dir = opendir(m_directory.c_str()))
+	{
+		while (dirent* entry = readdir(dir))
+		{
+			add(entry->d_name);
+		}
+		closedir(dir);
+	}
+#endif
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_index.swap(index);
+	m_indexListed = true;
+	m_indexStamp = stamp;
+}
+
+std::shared_ptr<const std::string> PollyPhraseStore::Find(const std::string& key)
+{
+	if (m_directory.empty())
+	{
+		return nullptr;
+	}
+	RefreshIndex();
+	uint64_t hash = Hash(key);
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_index.find(hash) == m_index.end())
+		{
+			return nullptr;
+		}
+	}
+
+	std::ifstream file(PathFor(hash), std::ios::binary);
+	char magic[sizeof(kMagic)];
+	uint32_t keyLength = 0;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+		!file.read(reinterpret_cast<char*>(&keyLength), sizeof(keyLength)) || keyLength != key.size())
+	{
+		return nullptr;
+	}
+	std::string storedKey(keyLength, '\0');
+	if (!file.read(&storedKey[0], keyLength) || storedKey != key)
+	{
+		return nullptr;
+	}
+	std::ostringstream body;
+	body << file.rdbuf();
+	return std::make_shared<const std::string>(body.str());
+}
+
+bool PollyPhraseStore::Store(const std::string& key, const std::string& body)
+{
+	if (m_directory.empty())
+	{
+		return false;
+	}
+	CreateDirectories(m_directory);
+	uint64_t hash = Hash(key);
+	auto path = PathFor(hash);
+	// Write to a temporary file first so that readers never see a partial entry
+	auto temp = path + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		uint32_t keyLength = static_cast<uint32_t>(key.size());
+		file.write(kMagic, sizeof(kMagic));
+		file.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+		file.write(key.data(), key.size());
+		file.write(body.data(), body.size());
+		if (!file)
+		{
+			return false;
+		}
+	}
+#ifdef _WIN32
+	if (!MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		return false;
+	}
+#else
+	if (std::rename(temp.c_str(), path.c_str()) != 0)
+	{
+		return false;
+	}
+#endif
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_index.insert(hash);
+	return true;
+}
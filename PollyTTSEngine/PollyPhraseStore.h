@@ -0,0 +1,67 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// On-disk store of phrases synthesized ahead of time by `InstallVoices warm`.
+// PollyManager looks here before calling Polly, so warmed phrases play at
+// once and without a network. Each entry is one file under PHRASE_STORE
+// (default %ProgramData%\Amazon\PollyTTS\Phrases), named after a hash of
+// its key; the key is also kept in the file to rule out collisions. The
+// directory is listed again when its last write time changes, so phrases
+// that another process warmed are found without a restart.
+class PollyPhraseStore
+{
+public:
+	static PollyPhraseStore& Instance();
+
+	// Outputs the engine asks Polly for
+	static const char* const PcmOutput;
+	static const char* const MarksOutput;
+
+	// Key for one output of `text` spoken by `voiceName`: a 16-byte
+	// MurmurHash3 digest, so that long texts make short keys. `text` should
+	// be canonical (see PollyCanonicalText).
+	static std::string Key(const std::string& voiceName, const char* output, const std::string& text);
+
+	std::shared_ptr<const std::string> Find(const std::string& key);
+	bool Store(const std::string& key, const std::string& body);
+
+	const std::string& Directory() const { return m_directory; }
+
+	// 64-bit FNV-1a of `key`, the same on every machine and build.
+	static uint64_t Hash(const std::string& key);
+
+private:
+	PollyPhraseStore();
+
+	std::string PathFor(uint64_t hash) const;
+	// Last write time of the directory, 0 if it does not exist
+	int64_t DirectoryStamp() const;
+	// Lists the directory again if it changed since the last listing
+	void RefreshIndex();
+
+	std::string m_directory;
+	std::mutex m_lock;
+	// Hashes of the entries on disk, so that a miss costs at most a check
+	// of the directory's write time a second
+	std::unordered_set<uint64_t> m_index;
+	bool m_indexListed;
+	int64_t m_indexStamp;
+	std::chrono::steady_clock::time_point m_indexChecked;
+};
@@ -0,0 +1,391 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyPromptTemplate.h"
+#include "PollyConfig.h"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const size_t kBytesPerMs = 32; // 16 kHz, 16-bit mono
+	const size_t kMaxNumberDigits = 12;
+	const char* kMonths[] = { "January", "February", "March", "April", "May", "June", "July",
+		"August", "September", "October", "November", "December" };
+
+	bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// Bytes of multi-byte UTF-8 characters count as letters
+	bool IsWordChar(char c)
+	{
+		return isalnum(static_cast<unsigned char>(c)) || c == '\'' || c == '_' ||
+			static_cast<unsigned char>(c) >= 0x80;
+	}
+
+	bool StartsToken(const std::string& text, size_t pos)
+	{
+		return pos == 0 || isspace(static_cast<unsigned char>(text[pos - 1])) || text[pos - 1] == '(' ||
+			text[pos - 1] == '"';
+	}
+
+	bool EndsToken(const std::string& text, size_t end)
+	{
+		if (end == text.size() || isspace(static_cast<unsigned char>(text[end])))
+		{
+			return true;
+		}
+		// Trailing punctuation, as long as it does not continue the token ("1.5", "4th")
+		return strchr(".,;:!?)\"", text[end]) != nullptr &&
+			(end + 1 == text.size() || !IsWordChar(text[end + 1]));
+	}
+
+	size_t ScanDigits(const std::string& text, size_t pos)
+	{
+		while (pos < text.size() && IsDigit(text[pos]))
+		{
+			pos++;
+		}
+		return pos;
+	}
+
+	void AddUnit(std::vector<PollyPromptPiece>& units, const std::string& text, bool ssml = false)
+	{
+		PollyPromptPiece piece;
+		piece.Text = text;
+		piece.Ssml = ssml;
+		piece.Variable = true;
+		piece.SourceStart = piece.SourceEnd = 0;
+		units.push_back(piece);
+	}
+
+	// English cardinal, built from "0".."99", "hundred", "thousand",
+	// "million" and "billion"
+	void AddNumber(std::vector<PollyPromptPiece>& units, uint64_t n)
+	{
+		static const struct { uint64_t scale; const char* name; } scales[] = {
+			{ 1000000000ULL, "billion" }, { 1000000ULL, "million" }, { 1000ULL, "thousand" } };
+		for (auto& scale : scales)
+		{
+			if (n >= scale.scale)
+			{
+				AddNumber(units, n / scale.scale);
+				AddUnit(units, scale.name);
+				n %= scale.scale;
+				if (n == 0)
+				{
+					return;
+				}
+			}
+		}
+		if (n >= 100)
+		{
+			AddUnit(units, std::to_string(n / 100));
+			AddUnit(units, "hundred");
+			n %= 100;
+			if (n == 0)
+			{
+				return;
+			}
+		}
+		AddUnit(units, std::to_string(n));
+	}
+
+	void AddOrdinal(std::vector<PollyPromptPiece>& units, int day)
+	{
+		const char* suffix = "th";
+		if (day % 100 < 11 || day % 100 > 13)
+		{
+			suffix = day % 10 == 1 ? "st" : day % 10 == 2 ? "nd" : day % 10 == 3 ? "rd" : "th";
+		}
+		AddUnit(units, std::to_string(day) + suffix);
+	}
+
+	// Years are read in pairs of digits ("nineteen eighty-seven",
+	// "nineteen oh five"), except 2000-2009 ("two thousand five")
+	void AddYear(std::vector<PollyPromptPiece>& units, int year)
+	{
+		if ((year >= 2000 && year < 2010) || year < 1000)
+		{
+			AddNumber(units, year);
+			return;
+		}
+		AddUnit(units, std::to_string(year / 100));
+		int rest = year % 100;
+		if (rest == 0)
+		{
+			AddUnit(units, "hundred");
+			return;
+		}
+		if (rest < 10)
+		{
+			AddUnit(units, "oh");
+		}
+		AddUnit(units, std::to_string(rest));
+	}
+
+	bool AddDate(std::vector<PollyPromptPiece>& units, int year, int month, int day)
+	{
+		if (month < 1 || month > 12 || day < 1 || day > 31)
+		{
+			return false;
+		}
+		AddUnit(units, kMonths[month - 1]);
+		AddOrdinal(units, day);
+		AddYear(units, year);
+		return true;
+	}
+
+	// YYYY-MM-DD or M/D/YYYY
+	bool MatchDate(const std::string& text, size_t pos, size_t& end, std::vector<PollyPromptPiece>& units)
+	{
+		size_t first = ScanDigits(text, pos);
+		if (first - pos == 4 && first + 6 <= text.size() && text[first] == '-' &&
+			ScanDigits(text, first + 1) == first + 3 && text[first + 3] == '-' &&
+			ScanDigits(text, first + 4) == first + 6)
+		{
+			end = first + 6;
+			return EndsToken(text, end) && AddDate(units, std::stoi(text.substr(pos, 4)),
+				std::stoi(text.substr(first + 1, 2)), std::stoi(text.substr(first + 4, 2)));
+		}
+		if (first - pos >= 1 && first - pos <= 2 && first < text.size() && text[first] == '/')
+		{
+			size_t second = ScanDigits(text, first + 1);
+			if (second - first - 1 >= 1 && second - first - 1 <= 2 && second < text.size() && text[second] == '/' &&
+				ScanDigits(text, second + 1) == second + 5)
+			{
+				end = second + 5;
+				return EndsToken(text, end) && AddDate(units, std::stoi(text.substr(second + 1, 4)),
+					std::stoi(text.substr(pos, first - pos)), std::stoi(text.substr(first + 1, second - first - 1)));
+			}
+		}
+		return false;
+	}
+
+	// 42, 1,250 or 1250000; digit strings with a leading zero ("0042") are
+	// read digit by digit
+	bool MatchNumber(const std::string& text, size_t pos, size_t& end, std::vector<PollyPromptPiece>& units)
+	{
+		end = ScanDigits(text, pos);
+		std::string digits = text.substr(pos, end - pos);
+		if (end - pos <= 3)
+		{
+			while (end + 4 <= text.size() && text[end] == ',' && ScanDigits(text, end + 1) == end + 4)
+			{
+				digits.append(text, end + 1, 3);
+				end += 4;
+			}
+		}
+		if (digits.empty() || digits.size() > kMaxNumberDigits || !EndsToken(text, end))
+		{
+			return false;
+		}
+		if (digits.size() > 1 && digits[0] == '0')
+		{
+			for (char digit : digits)
+			{
+				AddUnit(units, std::string(1, digit));
+			}
+			return true;
+		}
+		AddNumber(units, std::stoull(digits));
+		return true;
+	}
+
+	// A single capital letter other than the words "A" and "I"
+	bool MatchLetter(const std::string& text, size_t pos, size_t& end, std::vector<PollyPromptPiece>& units)
+	{
+		char c = text[pos];
+		end = pos + 1;
+		if (c < 'B' || c > 'Z' || c == 'I' || !EndsToken(text, end))
+		{
+			return false;
+		}
+		AddUnit(units, "<speak><say-as interpret-as=\"characters\">" + std::string(1, c) + "</say-as></speak>", true);
+		return true;
+	}
+
+	void AddConstant(std::vector<PollyPromptPiece>& pieces, const std::string& text, size_t start, size_t end)
+	{
+		while (start < end && isspace(static_cast<unsigned char>(text[start])))
+		{
+			start++;
+		}
+		while (end > start && isspace(static_cast<unsigned char>(text[end - 1])))
+		{
+			end--;
+		}
+		// Punctuation on its own has nothing to say
+		if (std::none_of(text.begin() + start, text.begin() + end, IsWordChar))
+		{
+			return;
+		}
+		PollyPromptPiece piece;
+		piece.Text = text.substr(start, end - start);
+		piece.Ssml = false;
+		piece.Variable = false;
+		piece.SourceStart = start;
+		piece.SourceEnd = end;
+		pieces.push_back(piece);
+	}
+
+	int FirstMarkTime(const PollyPayloadCache::Payload& marks)
+	{
+		std::string line = marks ? marks->substr(0, marks->find('\n')) : "";
+		rapidjson::Document d;
+		d.Parse(line.c_str());
+		return !d.HasParseError() && d.IsObject() && d.HasMember("time") ? d["time"].GetInt() : 0;
+	}
+
+	void AppendMark(std::string& out, int64_t time, size_t start, size_t end, const char* value, size_t length)
+	{
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+		writer.Key("time");
+		writer.Int(static_cast<int>(time));
+		writer.Key("type");
+		writer.String("word");
+		writer.Key("start");
+		writer.Int(static_cast<int>(start));
+		writer.Key("end");
+		writer.Int(static_cast<int>(end));
+		writer.Key("value");
+		writer.String(value, static_cast<rapidjson::SizeType>(length));
+		writer.EndObject();
+		out.append(buffer.GetString(), buffer.GetSize());
+		out.push_back('\n');
+	}
+}
+
+bool PollyPromptTemplate::IsEnabled()
+{
+	static const bool enabled = PollyConfig::GetBool("TEMPLATES", false);
+	return enabled;
+}
+
+PollyPayloadCache& PollyPromptTemplate::Fragments()
+{
+	static PollyPayloadCache cache("TEMPLATE_CACHE_BYTES", 64 * 1024 * 1024);
+	return cache;
+}
+
+bool PollyPromptTemplate::Split(const std::string& text, std::vector<PollyPromptPiece>& pieces)
+{
+	pieces.clear();
+	bool hasVariable = false;
+	size_t segmentStart = 0;
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		std::vector<PollyPromptPiece> units;
+		size_t end = pos;
+		bool matched = StartsToken(text, pos) &&
+			(IsDigit(text[pos]) ? MatchDate(text, pos, end, units) || (units.clear(), MatchNumber(text, pos, end, units))
+				: MatchLetter(text, pos, end, units));
+		if (!matched)
+		{
+			pos++;
+			continue;
+		}
+		AddConstant(pieces, text, segmentStart, pos);
+		for (auto& unit : units)
+		{
+			unit.SourceStart = pos;
+			unit.SourceEnd = end;
+			pieces.push_back(unit);
+		}
+		hasVariable = true;
+		pos = segmentStart = end;
+	}
+	AddConstant(pieces, text, segmentStart, text.size());
+	return hasVariable;
+}
+
+std::string PollyPromptTemplate::Join(const std::vector<PollyPayloadCache::Payload>& audio, std::vector<size_t>& offsets)
+{
+	static const size_t crossfadeBytes =
+		static_cast<size_t>(std::max(0L, PollyConfig::GetLong("TEMPLATE_CROSSFADE_MS", 10))) * kBytesPerMs;
+	size_t total = 0;
+	for (auto& fragment : audio)
+	{
+		total += fragment->size();
+	}
+	std::string joined;
+	joined.reserve(total);
+	offsets.clear();
+	for (auto& fragment : audio)
+	{
+		size_t length = fragment->size() & ~size_t(1);
+		size_t overlap = std::min(crossfadeBytes, std::min(joined.size(), length) / 2) & ~size_t(1);
+		size_t start = joined.size() - overlap;
+		offsets.push_back(start);
+		// Linear crossfade over the overlapping samples
+		int64_t samples = static_cast<int64_t>(overlap / 2);
+		for (int64_t i = 0; i < samples; i++)
+		{
+			int16_t from;
+			int16_t to;
+			memcpy(&from, &joined[start + 2 * i], 2);
+			memcpy(&to, fragment->data() + 2 * i, 2);
+			int16_t mixed = static_cast<int16_t>((from * (samples - i) + to * i) / samples);
+			memcpy(&joined[start + 2 * i], &mixed, 2);
+		}
+		joined.append(fragment->data() + overlap, length - overlap);
+	}
+	return joined;
+}
+
+std::string PollyPromptTemplate::MergeMarks(const std::string& text, const std::vector<PollyPromptPiece>& pieces,
+	const std::vector<PollyPayloadCache::Payload>& marks, const std::vector<size_t>& offsets)
+{
+	std::string merged;
+	size_t lastVariableStart = std::string::npos;
+	for (size_t i = 0; i < pieces.size(); i++)
+	{
+		auto& piece = pieces[i];
+		int64_t shiftMs = static_cast<int64_t>(offsets[i] / kBytesPerMs);
+		if (piece.Variable)
+		{
+			if (piece.SourceStart != lastVariableStart)
+			{
+				lastVariableStart = piece.SourceStart;
+				AppendMark(merged, shiftMs + FirstMarkTime(marks[i]), piece.SourceStart, piece.SourceEnd,
+					text.data() + piece.SourceStart, piece.SourceEnd - piece.SourceStart);
+			}
+			continue;
+		}
+
+		std::istringstream lines(marks[i] ? *marks[i] : std::string());
+		std::string line;
+		while (getline(lines, line))
+		{
+			rapidjson::Document d;
+			d.Parse(line.c_str());
+			if (d.HasParseError() || !d.IsObject() || !d.HasMember("time") || !d.HasMember("start") ||
+				!d.HasMember("end") || !d.HasMember("value"))
+			{
+				continue;
+			}
+			AppendMark(merged, shiftMs + d["time"].GetInt(), piece.SourceStart + d["start"].GetInt(),
+				piece.SourceStart + d["end"].GetInt(), d["value"].GetString(), d["value"].GetStringLength());
+		}
+	}
+	return merged;
+}
@@ -0,0 +1,55 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "PollyPayloadCache.h"
+
+// One piece of a templated prompt: either a constant segment of the text
+// or one unit of a variable token (a number group, month, ordinal day or
+// letter).
+struct PollyPromptPiece
+{
+	std::string Text; // what Polly is asked to speak
+	bool Ssml;
+	bool Variable;
+	size_t SourceStart; // byte range of the prompt that this piece speaks
+	size_t SourceEnd;
+};
+
+// Template mode (TEMPLATES=1) for prompts such as "Your balance is 1,250
+// points" or "Press 4". Constant segments and a closed set of English
+// units for numbers, dates and letters are synthesized once and cached;
+// a prompt is joined locally from those fragments with short crossfades
+// (TEMPLATE_CROSSFADE_MS) and merged speech marks.
+class PollyPromptTemplate
+{
+public:
+	static bool IsEnabled();
+
+	// Fragments by request key, bounded by TEMPLATE_CACHE_BYTES.
+	static PollyPayloadCache& Fragments();
+
+	// Splits plain text into pieces. Returns false if the text has no
+	// variable tokens, in which case it is better synthesized whole.
+	static bool Split(const std::string& text, std::vector<PollyPromptPiece>& pieces);
+
+	// Joins 16 kHz 16-bit mono PCM fragments. `offsets` receives the byte
+	// offset at which each fragment starts in the result.
+	static std::string Join(const std::vector<PollyPayloadCache::Payload>& audio, std::vector<size_t>& offsets);
+
+	// Merges the word speech marks of the fragments into marks for `text`.
+	// A variable token gets a single mark that spans its text.
+	static std::string MergeMarks(const std::string& text, const std::vector<PollyPromptPiece>& pieces,
+		const std::vector<PollyPayloadCache::Payload>& marks, const std::vector<size_t>& offsets);
+};
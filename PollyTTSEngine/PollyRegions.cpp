@@ -0,0 +1,280 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyRegions.h"
+#include "PollyConfig.h"
+#include "PollyCredentials.h"
+#include "PollyLog.h"
+#include <algorithm>
+#include <future>
+#include <sstream>
+#include <aws/core/client/DefaultRetryStrategy.h>
+#include <aws/core/utils/threading/Executor.h>
+#include <aws/polly/model/DescribeVoicesRequest.h>
+
+#ifdef GetMessage
+// <Windows.h> came in through spdlog after the SDK had declared AWSError::GetMessage
+#undef GetMessage
+#endif
+
+using namespace Aws::Polly::Model;
+
+static const char* ALLOCATION_TAG = "PollyTTSEngine::Regions";
+
+namespace
+{
+	const int64_t kPpm = 1000000;
+	// Weight of a new sample in the moving averages
+	const int64_t kEwmaDivisor = 8;
+	// A region that fails every request looks this many times slower, and
+	// a second slower still, so that one that has never answered is not
+	// taken for a fast one
+	const int64_t kErrorPenalty = 10;
+
+	void UpdateAverage(std::atomic<int64_t>& average, int64_t sample, bool replaceZero)
+	{
+		int64_t old = average.load(std::memory_order_relaxed);
+		int64_t next;
+		do
+		{
+			next = replaceZero && old == 0 ? sample : old + (sample - old) / kEwmaDivisor;
+		} while (!average.compare_exchange_weak(old, next, std::memory_order_relaxed));
+	}
+
+	std::shared_ptr<Aws::Polly::PollyClient> CreateClient(const std::string& region, std::string endpoint)
+	{
+		Aws::Client::ClientConfiguration config;
+		if (!region.empty())
+		{
+			config.region = region.c_str();
+		}
+		if (endpoint.find("http://") == 0)
+		{
+			config.scheme = Aws::Http::Scheme::HTTP;
+			endpoint = endpoint.substr(sizeof("http://") - 1);
+		}
+		else if (endpoint.find("https://") == 0)
+		{
+			endpoint = endpoint.substr(sizeof("https://") - 1);
+		}
+		if (!endpoint.empty())
+		{
+			config.endpointOverride = endpoint.c_str();
+		}
+		// Retries are classified and bounded by PollyResilience instead
+		config.retryStrategy = Aws::MakeShared<Aws::Client::DefaultRetryStrategy>(ALLOCATION_TAG, 0);
+		// SynthesizeSpeechAsync runs each call on the client's executor. The
+		// default one starts a thread per call; a pool the size of the
+		// connection limit runs as many calls as can be sent at once.
+		config.executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>(ALLOCATION_TAG,
+			static_cast<size_t>(config.maxConnections));
+		// The client is thread-safe, and its SigV4 signer keeps the derived
+		// signing key for the day and region between requests
+		return Aws::MakeShared<Aws::Polly::PollyClient>(ALLOCATION_TAG, PollyCredentialsProvider::Instance(), config);
+	}
+}
+
+bool PollyRegion::Offers(VoiceId voice) const
+{
+	auto voices = Voices.load();
+	return voices && voices->count(static_cast<int>(voice)) > 0;
+}
+
+void PollyRegion::Learn(VoiceId voice)
+{
+	auto voices = Voices.load();
+	while (!voices || voices->count(static_cast<int>(voice)) == 0)
+	{
+		auto grown = voices ? std::make_shared<std::unordered_set<int>>(*voices) :
+			std::make_shared<std::unordered_set<int>>();
+		grown->insert(static_cast<int>(voice));
+		if (Voices.compare_exchange_weak(voices, grown))
+		{
+			break;
+		}
+	}
+}
+
+std::atomic<PollyRegions*> PollyRegions::s_created(nullptr);
+
+PollyRegions& PollyRegions::Instance()
+{
+	static PollyRegions regions;
+	return regions;
+}
+
+PollyRegions::PollyRegions()
+{
+	std::vector<std::pair<std::string, std::string>> entries;
+	std::istringstream list(PollyConfig::GetString("REGIONS"));
+	std::string entry;
+	while (std::getline(list, entry, ','))
+	{
+		entry.erase(0, entry.find_first_not_of(" \t"));
+		entry.erase(entry.find_last_not_of(" \t") + 1);
+		if (entry.empty())
+		{
+			continue;
+		}
+		auto equals = entry.find('=');
+		if (equals == std::string::npos)
+		{
+			entries.emplace_back(entry, "");
+		}
+		else
+		{
+			entries.emplace_back(entry.substr(0, equals), entry.substr(equals + 1));
+		}
+	}
+
+	for (auto& named : entries)
+	{
+		std::unique_ptr<PollyRegion> region(new PollyRegion());
+		region->Name = named.first;
+		// A mock endpoint signs as the profile's region, a real one as itself
+		region->Client = CreateClient(named.second.empty() ? named.first : "", named.second);
+		m_regions.push_back(std::move(region));
+	}
+	if (m_regions.empty())
+	{
+		std::unique_ptr<PollyRegion> region(new PollyRegion());
+		auto endpoint = PollyConfig::GetString("ENDPOINT");
+		region->Name = endpoint.empty() ? "default" : endpoint;
+		region->Client = CreateClient("", endpoint);
+		m_regions.push_back(std::move(region));
+	}
+
+	for (auto& region : m_regions)
+	{
+		region->Breaker = &PollyCircuitBreaker::ForEndpoint(region->Name);
+		region->RttMicros.store(0);
+		region->ErrorPpm.store(0);
+	}
+	s_created.store(this);
+}
+
+std::vector<PollyRegion*> PollyRegions::Ranked(VoiceId voice) const
+{
+	std::vector<std::pair<int64_t, PollyRegion*>> scored;
+	scored.reserve(m_regions.size());
+	auto score = [&](bool offersOnly) {
+		for (auto& region : m_regions)
+		{
+			if (offersOnly && !region->Offers(voice))
+			{
+				continue;
+			}
+			int64_t rtt = region->RttMicros.load(std::memory_order_relaxed);
+			int64_t errors = region->ErrorPpm.load(std::memory_order_relaxed);
+			int64_t value = rtt + rtt * errors * kErrorPenalty / kPpm + errors;
+			if (region->Breaker->IsOpen())
+			{
+				value = INT64_MAX;
+			}
+			scored.emplace_back(value, region.get());
+		}
+	};
+	score(voice != VoiceId::NOT_SET);
+	if (scored.empty())
+	{
+		// No region is known to offer the voice: none has been probed yet,
+		// or the lists are out of date. Let Polly decide rather than fail.
+		score(false);
+	}
+	// Stable, so that unmeasured regions are tried in the configured order
+	std::stable_sort(scored.begin(), scored.end(),
+		[](const std::pair<int64_t, PollyRegion*>& a, const std::pair<int64_t, PollyRegion*>& b) { return a.first < b.first; });
+
+	std::vector<PollyRegion*> ranked;
+	ranked.reserve(scored.size());
+	for (auto& entry : scored)
+	{
+		ranked.push_back(entry.second);
+	}
+	return ranked;
+}
+
+void PollyRegions::Record(PollyRegion& region, std::chrono::steady_clock::duration elapsed, bool failed)
+{
+	UpdateAverage(region.ErrorPpm, failed ? kPpm : 0, false);
+	if (!failed)
+	{
+		UpdateAverage(region.RttMicros,
+			std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()), true);
+	}
+}
+
+bool PollyRegions::ProbeRegion(PollyRegion& region)
+{
+	auto voices = std::make_shared<std::unordered_set<int>>();
+	DescribeVoicesRequest request;
+	for (;;)
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto outcome = region.Client->DescribeVoices(request);
+		Record(region, std::chrono::steady_clock::now() - start,
+			!outcome.IsSuccess() && PollyResilience::IsRetryable(outcome.GetError()));
+		if (!outcome.IsSuccess())
+		{
+			PollyLog::Get()->info("Polly region {} did not answer: {}", region.Name, outcome.GetError().GetMessage().c_str());
+			return false;
+		}
+		for (auto& voice : outcome.GetResult().GetVoices())
+		{
+			voices->insert(static_cast<int>(voice.GetId()));
+		}
+		if (outcome.GetResult().GetNextToken().empty())
+		{
+			break;
+		}
+		request.SetNextToken(outcome.GetResult().GetNextToken());
+	}
+	region.Voices.store(voices);
+	return true;
+}
+
+bool PollyRegions::Probe()
+{
+	std::vector<std::future<bool>> probes;
+	for (auto& region : m_regions)
+	{
+		PollyRegion* target = region.get();
+		probes.push_back(std::async(std::launch::async, [this, target]() { return ProbeRegion(*target); }));
+	}
+	bool answered = false;
+	for (auto& probe : probes)
+	{
+		answered = probe.get() || answered;
+	}
+	return answered;
+}
+
+std::string PollyRegions::FormatPrometheus()
+{
+	// Never creates the regions, because their clients need the SDK
+	PollyRegions* created = s_created.load();
+	if (created == nullptr)
+	{
+		return "";
+	}
+	std::ostringstream out;
+	out << "# HELP polly_tts_region_rtt_seconds Moving average of the round trip to each Polly region.\n";
+	out << "# TYPE polly_tts_region_rtt_seconds gauge\n";
+	for (auto& region : created->m_regions)
+		out << "polly_tts_region_rtt_seconds{region=\"" << region->Name << "\"} "
+			<< region->RttMicros.load(std::memory_order_relaxed) / 1e6 << "\n";
+	out << "# HELP polly_tts_region_error_ratio Moving average of the share of failed requests to each Polly region.\n";
+	out << "# TYPE polly_tts_region_error_ratio gauge\n";
+	for (auto& region : created->m_regions)
+		out << "polly_tts_region_error_ratio{region=\"" << region->Name << "\"} "
+			<< region->ErrorPpm.load(std::memory_order_relaxed) / 1e6 << "\n";
+	return out.str();
+}
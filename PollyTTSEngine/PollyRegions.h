@@ -0,0 +1,82 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <aws/polly/PollyClient.h>
+#include "PollyResilience.h"
+
+// A Polly region, or any endpoint that answers like one, with its client
+// and the health the engine has observed for it.
+struct PollyRegion
+{
+	std::string Name;
+	std::shared_ptr<Aws::Polly::PollyClient> Client;
+	PollyCircuitBreaker* Breaker;
+	// Moving averages: round trip in microseconds (0 until measured) and
+	// share of failed requests in parts per million
+	std::atomic<int64_t> RttMicros;
+	std::atomic<int64_t> ErrorPpm;
+	// Voices the region is known to offer, by VoiceId: those its last probe
+	// listed and those it has synthesized since. Null until either happens.
+	// A voice not in the set is not offered. Each change replaces the set.
+	std::atomic<std::shared_ptr<const std::unordered_set<int>>> Voices;
+
+	bool Offers(Aws::Polly::Model::VoiceId voice) const;
+	// Adds `voice`, which the region has just synthesized
+	void Learn(Aws::Polly::Model::VoiceId voice);
+};
+
+// The regions listed in REGIONS, for example "us-east-1,eu-west-1". An entry
+// can also be "name=url" to use a local mock as a region. Without REGIONS
+// there is one region, using ENDPOINT or the profile's region.
+//
+// Requests go to the region with the lowest round trip, scaled up by its
+// error rate, among those known to offer the voice, or among all of them
+// when none is; regions whose circuit breaker is open come last. Ranking
+// only reads atomics, so it never waits for a probe.
+class PollyRegions
+{
+public:
+	static PollyRegions& Instance();
+
+	// Regions that offer `voice`, best first. NOT_SET ranks every region.
+	std::vector<PollyRegion*> Ranked(Aws::Polly::Model::VoiceId voice = Aws::Polly::Model::VoiceId::NOT_SET) const;
+
+	// Records one request to `region`. Failures that the region answered
+	// deliberately, such as invalid SSML, count as successes.
+	void Record(PollyRegion& region, std::chrono::steady_clock::duration elapsed, bool failed);
+
+	// Sends DescribeVoices to every region at once, which measures them,
+	// learns their voices and leaves a connection open to each. Returns true
+	// if any region answered.
+	bool Probe();
+
+	size_t Count() const { return m_regions.size(); }
+
+	// Round trip and error rate of each region, once the regions exist.
+	static std::string FormatPrometheus();
+
+private:
+	PollyRegions();
+	bool ProbeRegion(PollyRegion& region);
+
+	static std::atomic<PollyRegions*> s_created;
+
+	std::vector<std::unique_ptr<PollyRegion>> m_regions;
+};
@@ -0,0 +1,155 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyResilience.h"
+#include "PollyConfig.h"
+#include "PollyExecutor.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+using namespace Aws::Polly;
+using namespace Aws::Polly::Model;
+
+namespace
+{
+	// Decorrelated jitter: sleep = min(cap, random(base, 3 * previous sleep)).
+	// Kept out of the coroutine, which can resume on another thread, so the
+	// thread-local generator is always the current thread's.
+	long NextSleepMs(long baseMs, long previousMs, long capMs)
+	{
+		thread_local std::mt19937 random(std::random_device{}());
+		return std::min(capMs, std::uniform_int_distribution<long>(baseMs, previousMs * 3)(random));
+	}
+}
+
+PollyCircuitBreaker& PollyCircuitBreaker::ForEndpoint(const std::string& endpoint)
+{
+	static std::mutex lock;
+	static std::unordered_map<std::string, std::unique_ptr<PollyCircuitBreaker>> breakers;
+	std::lock_guard<std::mutex> guard(lock);
+	auto& breaker = breakers[endpoint];
+	if (!breaker)
+	{
+		breaker.reset(new PollyCircuitBreaker());
+	}
+	return *breaker;
+}
+
+PollyCircuitBreaker::PollyCircuitBreaker()
+	: m_state(Closed), m_consecutiveFailures(0), m_openedAtMs(0)
+{
+	m_failureThreshold = std::max(1L, PollyConfig::GetLong("BREAKER_FAILURES", 5));
+	m_openMs = std::max(100L, PollyConfig::GetLong("BREAKER_OPEN_MS", 10000));
+}
+
+int64_t PollyCircuitBreaker::NowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool PollyCircuitBreaker::AllowRequest()
+{
+	int state = m_state.load();
+	if (state == Closed)
+	{
+		return true;
+	}
+	if (state == Open && NowMs() - m_openedAtMs.load() >= m_openMs)
+	{
+		// Let exactly one caller probe the endpoint
+		return m_state.compare_exchange_strong(state, HalfOpen);
+	}
+	return false;
+}
+
+bool PollyCircuitBreaker::IsOpen() const
+{
+	return m_state.load() != Closed;
+}
+
+void PollyCircuitBreaker::RecordSuccess()
+{
+	m_consecutiveFailures.store(0);
+	m_state.store(Closed);
+}
+
+void PollyCircuitBreaker::RecordFailure()
+{
+	int failures = m_consecutiveFailures.fetch_add(1) + 1;
+	if (m_state.load() == HalfOpen || failures >= m_failureThreshold)
+	{
+		m_openedAtMs.store(NowMs());
+		m_state.store(Open);
+	}
+}
+
+bool PollyResilience::IsRetryable(const Aws::Client::AWSError<PollyErrors>& error)
+{
+	switch (error.GetErrorType())
+	{
+	case PollyErrors::THROTTLING:
+	case PollyErrors::SLOW_DOWN:
+	case PollyErrors::SERVICE_UNAVAILABLE:
+	case PollyErrors::SERVICE_FAILURE:
+	case PollyErrors::INTERNAL_FAILURE:
+	case PollyErrors::NETWORK_CONNECTION:
+	case PollyErrors::REQUEST_TIMEOUT:
+		return true;
+	default:
+		break;
+	}
+	return static_cast<int>(error.GetResponseCode()) >= 500 || error.ShouldRetry();
+}
+
+std::chrono::steady_clock::time_point PollyResilience::Deadline()
+{
+	static const long deadlineMs = std::max(0L, PollyConfig::GetLong("RETRY_DEADLINE_MS", 3000));
+	return std::chrono::steady_clock::now() + std::chrono::milliseconds(deadlineMs);
+}
+
+PollyTask<SynthesizeSpeechOutcome> PollyResilience::Execute(std::string endpoint, Attempt attempt,
+	std::chrono::steady_clock::time_point deadline, bool& shortCircuited)
+{
+	static const long maxAttempts = std::max(1L, PollyConfig::GetLong("RETRY_MAX_ATTEMPTS", 3));
+	static const long baseMs = std::max(1L, PollyConfig::GetLong("RETRY_BASE_MS", 50));
+	static const long capMs = std::max(baseMs, PollyConfig::GetLong("RETRY_CAP_MS", 1000));
+
+	auto& breaker = PollyCircuitBreaker::ForEndpoint(endpoint);
+	shortCircuited = !breaker.AllowRequest();
+	if (shortCircuited)
+	{
+		co_return SynthesizeSpeechOutcome(Aws::Client::AWSError<PollyErrors>(PollyErrors::SERVICE_UNAVAILABLE,
+			"CircuitOpen", "Polly endpoint " + Aws::String(endpoint.c_str()) + " is failing, not calling it", false));
+	}
+
+	long sleepMs = baseMs;
+	SynthesizeSpeechOutcome outcome = co_await attempt();
+	for (long attempts = 1; !outcome.IsSuccess() && IsRetryable(outcome.GetError()); attempts++)
+	{
+		breaker.RecordFailure();
+		sleepMs = NextSleepMs(baseMs, sleepMs, capMs);
+		if (attempts >= maxAttempts ||
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(sleepMs) > deadline ||
+			!breaker.AllowRequest())
+		{
+			co_return std::move(outcome);
+		}
+		co_await PollyExecutor::Shared().Delay(std::chrono::milliseconds(sleepMs));
+		outcome = co_await attempt();
+	}
+	// Success, or an error the endpoint answered deliberately (such as
+	// invalid SSML): either way it is healthy
+	breaker.RecordSuccess();
+	co_return std::move(outcome);
+}
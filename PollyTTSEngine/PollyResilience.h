@@ -0,0 +1,70 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <aws/polly/PollyClient.h>
+#include "PollyTask.h"
+
+// Per-endpoint circuit breaker. After BREAKER_FAILURES consecutive
+// retryable failures the breaker opens and requests fail fast for
+// BREAKER_OPEN_MS; then a single probe request is let through (half-open)
+// and its result closes or re-opens the breaker.
+class PollyCircuitBreaker
+{
+public:
+	static PollyCircuitBreaker& ForEndpoint(const std::string& endpoint);
+
+	bool AllowRequest();
+	bool IsOpen() const;
+	void RecordSuccess();
+	void RecordFailure();
+
+private:
+	enum State { Closed, Open, HalfOpen };
+
+	PollyCircuitBreaker();
+	static int64_t NowMs();
+
+	std::atomic<int> m_state;
+	std::atomic<int> m_consecutiveFailures;
+	std::atomic<int64_t> m_openedAtMs;
+	int m_failureThreshold;
+	int64_t m_openMs;
+};
+
+// Classified retries with decorrelated jitter. Throttling, 5xx and network
+// errors are retried within RETRY_MAX_ATTEMPTS and a RETRY_DEADLINE_MS
+// budget; validation errors are returned at once. The waits between
+// attempts are timers on the PollyExecutor and do not hold a thread.
+class PollyResilience
+{
+public:
+	typedef std::function<PollyTask<Aws::Polly::Model::SynthesizeSpeechOutcome>()> Attempt;
+
+	static bool IsRetryable(const Aws::Client::AWSError<Aws::Polly::PollyErrors>& error);
+
+	// End of the RETRY_DEADLINE_MS budget of a request that starts now. A
+	// request tried against several endpoints shares one deadline.
+	static std::chrono::steady_clock::time_point Deadline();
+
+	// Runs `attempt` behind the endpoint's circuit breaker, starting no
+	// retry that would end after `deadline`. Sets `shortCircuited` when the
+	// breaker is open and no request was made.
+	static PollyTask<Aws::Polly::Model::SynthesizeSpeechOutcome> Execute(std::string endpoint,
+		Attempt attempt, std::chrono::steady_clock::time_point deadline, bool& shortCircuited);
+};
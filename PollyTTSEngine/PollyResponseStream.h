@@ -0,0 +1,61 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <functional>
+#include <sstream>
+#include <aws/core/utils/memory/stl/AWSStreamFwd.h>
+
+// In-memory response body that reports when the HTTP client writes the first
+// byte of the payload. Install it with SetResponseStreamFactory to tell time
+// to first byte apart from the full transfer.
+class TimedResponseBuffer : public std::stringbuf
+{
+public:
+	typedef std::function<void()> FirstByteCallback;
+
+	explicit TimedResponseBuffer(FirstByteCallback onFirstByte)
+		: std::stringbuf(std::ios_base::in | std::ios_base::out), m_onFirstByte(onFirstByte) {}
+
+protected:
+	std::streamsize xsputn(const char* s, std::streamsize count) override
+	{
+		NotifyFirstByte(count);
+		return std::stringbuf::xsputn(s, count);
+	}
+
+	int_type overflow(int_type ch) override
+	{
+		NotifyFirstByte(traits_type::eq_int_type(ch, traits_type::eof()) ? 0 : 1);
+		return std::stringbuf::overflow(ch);
+	}
+
+private:
+	void NotifyFirstByte(std::streamsize count)
+	{
+		if (count > 0 && m_onFirstByte)
+		{
+			auto callback = m_onFirstByte;
+			m_onFirstByte = nullptr;
+			callback();
+		}
+	}
+
+	FirstByteCallback m_onFirstByte;
+};
+
+class TimedResponseStream : private TimedResponseBuffer, public Aws::IOStream
+{
+public:
+	explicit TimedResponseStream(FirstByteCallback onFirstByte)
+		: TimedResponseBuffer(onFirstByte), Aws::IOStream(static_cast<TimedResponseBuffer*>(this)) {}
+};
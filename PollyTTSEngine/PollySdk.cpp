@@ -0,0 +1,34 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollySdk.h"
+#include <aws/core/Aws.h>
+#include <mutex>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+void PollySdk::Initialize()
+{
+	static std::once_flag initialized;
+	std::call_once(initialized, []()
+	{
+#ifdef _WIN32
+		HMODULE self;
+		GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+			reinterpret_cast<LPCSTR>(&PollySdk::Initialize), &self);
+#endif
+		static Aws::SDKOptions options;
+		Aws::InitAPI(options);
+	});
+}
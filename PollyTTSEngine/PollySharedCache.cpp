@@ -0,0 +1,929 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollySharedCache.h"
+#include "PollyConfig.h"
+#include "PollyPhraseStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t kMagic = 0x43535050; // "PPSC"
+	const uint32_t kVersion = 1;
+	const uint32_t kBlockSize = 16 * 1024;
+	const int kMaxReaders = 256;
+	const int kMaxProbes = 64;
+	// No reader copies an entry for this long; a slot held longer belongs to
+	// a process that hung or whose id was reused
+	const int64_t kStaleReaderMs = 30000;
+	const uint64_t kTombstone = ~0ull;
+	// Byte-range locks, taken past the end of any mapping. The first
+	// serializes opening; every process holds the second, shared, while it
+	// has the file mapped.
+	const uint64_t kOpenLock = 1ull << 40;
+	const uint64_t kUsersLock = kOpenLock + 1;
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "the cache needs address-free 64-bit atomics");
+
+	std::string DefaultPath()
+	{
+		const char* programData = std::getenv("ProgramData");
+		if (programData == nullptr || *programData == '\0')
+		{
+			return "";
+		}
+		// The installer lets every user modify this directory; files created
+		// in it inherit that, so each session can write the cache
+		return std::string(programData) + "\\Amazon\\PollyTTS\\SharedCache\\AudioCache.bin";
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t CurrentProcessId()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	bool ProcessAlive(uint32_t processId)
+	{
+#ifdef _WIN32
+		HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+		if (process == NULL)
+		{
+			// A process of another user or session cannot be opened but exists
+			return GetLastError() == ERROR_ACCESS_DENIED;
+		}
+		DWORD exitCode = 0;
+		bool alive = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+		CloseHandle(process);
+		return alive;
+#else
+		return kill(static_cast<pid_t>(processId), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	int64_t NowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+struct PollySharedCache::Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint32_t blockSize;
+	uint32_t blockCount;
+	uint64_t indexCapacity;
+	uint64_t indexOffset;
+	uint64_t blocksOffset;
+	alignas(64) std::atomic<uint64_t> epoch;
+	// (tag << 32) | (block + 1); the tag changes on every update, so a
+	// stale pop fails its compare-and-swap
+	alignas(64) std::atomic<uint64_t> freeHead;
+	// Entries unlinked from the index, waiting for readers to leave; block + 1
+	alignas(64) std::atomic<uint32_t> limboHead;
+	alignas(64) std::atomic<uint64_t> clockHand;
+	// (process id << 32) | (generation << 16) | low 16 bits of the epoch of
+	// a reader inside Find or Store, 0 when free. The epoch cannot move past
+	// a reader, so a reader's epoch is never more than one behind.
+	alignas(64) std::atomic<uint64_t> readers[kMaxReaders];
+};
+
+struct PollySharedCache::Block
+{
+	std::atomic<uint32_t> next; // block + 1, 0 at the end of a chain
+	uint32_t reserved;
+};
+
+// Starts the first block of an entry; the key and the payload follow it
+struct PollySharedCache::Entry
+{
+	uint64_t hash;
+	uint32_t keyLength;
+	uint32_t valueLength;
+	std::atomic<uint32_t> referenced; // CLOCK bit
+	std::atomic<uint32_t> limboNext;
+	uint64_t retireEpoch;
+};
+
+namespace
+{
+	const size_t kBlockData = kBlockSize - sizeof(uint64_t);
+
+	struct Layout
+	{
+		uint64_t indexCapacity;
+		uint64_t indexOffset;
+		uint64_t blocksOffset;
+		uint32_t blockCount;
+	};
+
+	template <typename HeaderType>
+	Layout LayoutFor(uint64_t size)
+	{
+		Layout layout;
+		// Twice as many index slots as blocks keeps the probe sequences short
+		layout.indexCapacity = 64;
+		while (layout.indexCapacity < size / kBlockSize * 2)
+		{
+			layout.indexCapacity <<= 1;
+		}
+		layout.indexOffset = AlignUp(sizeof(HeaderType), 64);
+		layout.blocksOffset = AlignUp(layout.indexOffset + layout.indexCapacity * sizeof(uint64_t), kBlockSize);
+		layout.blockCount = size > layout.blocksOffset ?
+			static_cast<uint32_t>((size - layout.blocksOffset) / kBlockSize) : 0;
+		return layout;
+	}
+}
+
+PollySharedCache& PollySharedCache::Instance()
+{
+	static PollySharedCache cache(PollyConfig::GetString("SHARED_CACHE", DefaultPath()),
+		PollyConfig::GetLong("SHARED_CACHE_MB", 64));
+	return cache;
+}
+
+PollySharedCache::PollySharedCache(const std::string& path, long sizeMb)
+	: m_path(path),
+#ifdef _WIN32
+	m_file(INVALID_HANDLE_VALUE), m_mapping(NULL),
+#else
+	m_file(-1),
+#endif
+	m_base(nullptr), m_size(0), m_header(nullptr), m_processId(CurrentProcessId()), m_generation(0)
+{
+	static_assert(sizeof(Block) == sizeof(uint64_t), "kBlockData assumes an 8-byte block header");
+	if (m_path.empty() || sizeMb <= 0)
+	{
+		m_error = "The shared cache is disabled";
+		return;
+	}
+	m_staleSince.reset(new std::pair<uint64_t, int64_t>[kMaxReaders]());
+	if (!Open(sizeMb))
+	{
+		Close();
+	}
+}
+
+PollySharedCache::~PollySharedCache()
+{
+	Close();
+}
+
+bool PollySharedCache::Open(long sizeMb)
+{
+	for (size_t i = 1; i < m_path.size(); i++)
+	{
+		if (m_path[i] == '\\' || m_path[i] == '/')
+		{
+#ifdef _WIN32
+			CreateDirectoryA(m_path.substr(0, i).c_str(), nullptr);
+#else
+			mkdir(m_path.substr(0, i).c_str(), 0755);
+#endif
+		}
+	}
+#ifdef _WIN32
+	m_file = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_error = "Unable to open " + m_path + ": error " + std::to_string(GetLastError());
+		return false;
+	}
+#else
+	m_file = open(m_path.c_str(), O_RDWR | O_CREAT, 0666);
+	if (m_file < 0)
+	{
+		m_error = "Unable to open " + m_path + ": " + std::strerror(errno);
+		return false;
+	}
+#endif
+
+	if (!Lock(kOpenLock, true, true))
+	{
+		m_error = "Unable to lock " + m_path;
+		return false;
+	}
+	// Nobody else has the file mapped, so whatever it holds can be checked
+	// and repaired without racing anyone
+	bool alone = Lock(kUsersLock, true, false);
+	uint64_t size = FileSize();
+	bool valid = size >= sizeof(Header) && Map(size) && IsValid(size);
+	if (!valid)
+	{
+		Unmap();
+		uint64_t wanted = static_cast<uint64_t>((std::min)(sizeMb, 2047L)) * 1024 * 1024;
+		if (!alone)
+		{
+			m_error = m_path + " is in use with another layout";
+		}
+		else if (!Resize(wanted) || !Map(wanted))
+		{
+			m_error = "Unable to size " + m_path;
+		}
+		else
+		{
+			Initialize(wanted);
+			valid = true;
+		}
+	}
+	else if (alone)
+	{
+		Recover();
+	}
+	if (alone)
+	{
+		Unlock(kUsersLock);
+	}
+	valid = valid && Lock(kUsersLock, false, true);
+	Unlock(kOpenLock);
+	return valid;
+}
+
+void PollySharedCache::Close()
+{
+	Unmap();
+#ifdef _WIN32
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		// Also releases the file locks
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+#endif
+}
+
+bool PollySharedCache::Lock(uint64_t offset, bool exclusive, bool wait)
+{
+#ifdef _WIN32
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD flags = (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+	return LockFileEx(m_file, flags, 0, 1, 0, &overlapped) != 0;
+#else
+	struct flock range = {};
+	range.l_type = exclusive ? F_WRLCK : F_RDLCK;
+	range.l_whence = SEEK_SET;
+	range.l_start = static_cast<off_t>(offset);
+	range.l_len = 1;
+	return fcntl(m_file, wait ? F_SETLKW : F_SETLK, &range) == 0;
+#endif
+}
+
+void PollySharedCache::Unlock(uint64_t offset)
+{
+#ifdef _WIN32
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	UnlockFileEx(m_file, 0, 1, 0, &overlapped);
+#else
+	struct flock range = {};
+	range.l_type = F_UNLCK;
+	range.l_whence = SEEK_SET;
+	range.l_start = static_cast<off_t>(offset);
+	range.l_len = 1;
+	fcntl(m_file, F_SETLK, &range);
+#endif
+}
+
+uint64_t PollySharedCache::FileSize()
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	return GetFileSizeEx(m_file, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+	struct stat status;
+	return fstat(m_file, &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+#endif
+}
+
+bool PollySharedCache::Resize(uint64_t size)
+{
+#ifdef _WIN32
+	LARGE_INTEGER position;
+	position.QuadPart = static_cast<LONGLONG>(size);
+	return SetFilePointerEx(m_file, position, NULL, FILE_BEGIN) && SetEndOfFile(m_file);
+#else
+	return ftruncate(m_file, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool PollySharedCache::Map(uint64_t size)
+{
+#ifdef _WIN32
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, 0, 0, NULL);
+	if (m_mapping == NULL)
+	{
+		return false;
+	}
+	m_base = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size)));
+#else
+	void* base = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+	m_base = base == MAP_FAILED ? nullptr : static_cast<char*>(base);
+#endif
+	if (m_base == nullptr)
+	{
+		return false;
+	}
+	m_size = size;
+	m_header = reinterpret_cast<Header*>(m_base);
+	return true;
+}
+
+void PollySharedCache::Unmap()
+{
+#ifdef _WIN32
+	if (m_base != nullptr)
+	{
+		UnmapViewOfFile(m_base);
+	}
+	if (m_mapping != NULL)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+#else
+	if (m_base != nullptr)
+	{
+		munmap(m_base, static_cast<size_t>(m_size));
+	}
+#endif
+	m_base = nullptr;
+	m_header = nullptr;
+	m_size = 0;
+}
+
+bool PollySharedCache::IsValid(uint64_t size) const
+{
+	auto layout = LayoutFor<Header>(size);
+	return m_header->magic == kMagic && m_header->version == kVersion && m_header->size == size &&
+		m_header->blockSize == kBlockSize && m_header->blockCount == layout.blockCount &&
+		m_header->indexCapacity == layout.indexCapacity && m_header->indexOffset == layout.indexOffset &&
+		m_header->blocksOffset == layout.blocksOffset && layout.blockCount > 0;
+}
+
+void PollySharedCache::Initialize(uint64_t size)
+{
+	auto layout = LayoutFor<Header>(size);
+	std::memset(m_base, 0, static_cast<size_t>(layout.blocksOffset));
+	m_header->version = kVersion;
+	m_header->size = size;
+	m_header->blockSize = kBlockSize;
+	m_header->blockCount = layout.blockCount;
+	m_header->indexCapacity = layout.indexCapacity;
+	m_header->indexOffset = layout.indexOffset;
+	m_header->blocksOffset = layout.blocksOffset;
+	m_header->epoch.store(1);
+	m_header->clockHand.store(0);
+	m_header->limboHead.store(0);
+	for (uint32_t i = 0; i < layout.blockCount; i++)
+	{
+		BlockAt(i).next.store(i + 1 < layout.blockCount ? i + 2 : 0, std::memory_order_relaxed);
+	}
+	m_header->freeHead.store(1);
+	// Last, so that a file whose initialization was cut short is not valid
+	m_header->magic = kMagic;
+}
+
+void PollySharedCache::Recover()
+{
+	uint32_t blockCount = m_header->blockCount;
+	std::vector<bool> used(blockCount, false);
+	std::vector<uint32_t> chain;
+	for (uint64_t position = 0; position < m_header->indexCapacity; position++)
+	{
+		auto& slot = SlotAt(position);
+		uint64_t word = slot.load();
+		if (word == 0 || word == kTombstone)
+		{
+			continue;
+		}
+		// Keep the entry only if its key hashes to its slot tag and its
+		// chain is exactly as long as it should be and shares no block
+		uint32_t first = static_cast<uint32_t>(word) - 1;
+		bool valid = first < blockCount;
+		chain.clear();
+		if (valid)
+		{
+			auto& entry = EntryAt(first);
+			uint64_t total = sizeof(Entry) + static_cast<uint64_t>(entry.keyLength) + entry.valueLength;
+			valid = total <= static_cast<uint64_t>(blockCount) * kBlockData;
+			std::string key(valid ? entry.keyLength : 0, '\0');
+			size_t copied = 0;
+			valid = valid && Visit(first, sizeof(Entry), key.size(), [&](char* data, size_t length) {
+				std::memcpy(&key[copied], data, length);
+				copied += length;
+				return true;
+			});
+			valid = valid && PollyPhraseStore::Hash(key) == entry.hash && (entry.hash >> 32) == (word >> 32);
+			uint32_t needed = valid ? BlocksFor(static_cast<size_t>(total)) : 0;
+			for (uint32_t block = first; valid; )
+			{
+				valid = block < blockCount && !used[block] && chain.size() < needed;
+				if (valid)
+				{
+					used[block] = true;
+					chain.push_back(block);
+					uint32_t next = BlockAt(block).next.load();
+					if (next == 0)
+					{
+						valid = chain.size() == needed;
+						break;
+					}
+					block = next - 1;
+				}
+			}
+			entry.referenced.store(0);
+		}
+		if (!valid)
+		{
+			for (auto block : chain)
+			{
+				used[block] = false;
+			}
+			slot.store(kTombstone);
+		}
+	}
+
+	// Everything else is free, including blocks that a process died
+	// holding and entries that were waiting in limbo
+	uint32_t head = 0;
+	for (uint32_t block = blockCount; block-- > 0; )
+	{
+		if (!used[block])
+		{
+			BlockAt(block).next.store(head);
+			head = block + 1;
+		}
+	}
+	m_header->freeHead.store(head);
+	m_header->limboHead.store(0);
+	for (auto& reader : m_header->readers)
+	{
+		reader.store(0);
+	}
+}
+
+PollySharedCache::Block& PollySharedCache::BlockAt(uint32_t index) const
+{
+	return *reinterpret_cast<Block*>(m_base + m_header->blocksOffset + static_cast<uint64_t>(index) * kBlockSize);
+}
+
+PollySharedCache::Entry& PollySharedCache::EntryAt(uint32_t index) const
+{
+	return *reinterpret_cast<Entry*>(reinterpret_cast<char*>(&BlockAt(index)) + sizeof(Block));
+}
+
+std::atomic<uint64_t>& PollySharedCache::SlotAt(uint64_t position) const
+{
+	auto slots = reinterpret_cast<std::atomic<uint64_t>*>(m_base + m_header->indexOffset);
+	return slots[position & (m_header->indexCapacity - 1)];
+}
+
+uint32_t PollySharedCache::BlocksFor(size_t bytes) const
+{
+	return static_cast<uint32_t>((bytes + kBlockData - 1) / kBlockData);
+}
+
+int PollySharedCache::Enter(uint64_t& ticket)
+{
+	thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+	uint64_t generation = m_generation.fetch_add(1, std::memory_order_relaxed) & 0xFFFF;
+	ticket = (static_cast<uint64_t>(m_processId) << 32) | (generation << 16) |
+		(m_header->epoch.load() & 0xFFFF);
+	for (int i = 0; i < kMaxReaders; i++)
+	{
+		int slot = static_cast<int>((hint + i) % kMaxReaders);
+		uint64_t expected = 0;
+		if (m_header->readers[slot].compare_exchange_strong(expected, ticket))
+		{
+			hint = slot;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+void PollySharedCache::Leave(int slot, uint64_t ticket)
+{
+	// Fails if another process cleared the slot as stale meanwhile
+	m_header->readers[slot].compare_exchange_strong(ticket, 0);
+}
+
+bool PollySharedCache::TryAdvance()
+{
+	uint64_t epoch = m_header->epoch.load();
+	for (int i = 0; i < kMaxReaders; i++)
+	{
+		uint64_t value = m_header->readers[i].load();
+		if (value != 0 && (value & 0xFFFF) != (epoch & 0xFFFF) && !RecoverReader(i, value))
+		{
+			return false;
+		}
+	}
+	m_header->epoch.compare_exchange_strong(epoch, epoch + 1);
+	return true;
+}
+
+bool PollySharedCache::RecoverReader(int slot, uint64_t value)
+{
+	uint32_t processId = static_cast<uint32_t>(value >> 32);
+	bool dead = processId != m_processId && !ProcessAlive(processId);
+	if (!dead)
+	{
+		std::lock_guard<std::mutex> guard(m_staleLock);
+		auto& since = m_staleSince[slot];
+		if (since.first != value)
+		{
+			since = std::make_pair(value, NowMs());
+			return false;
+		}
+		dead = NowMs() - since.second > kStaleReaderMs;
+	}
+	// If the slot changed meanwhile its reader left, which is as good
+	return dead && (m_header->readers[slot].compare_exchange_strong(value, 0) || true);
+}
+
+bool PollySharedCache::Allocate(uint32_t count, uint32_t& first)
+{
+	for (int attempt = 0; attempt < 4; attempt++)
+	{
+		uint32_t taken = 0;
+		uint32_t last = 0;
+		while (taken < count)
+		{
+			uint64_t head = m_header->freeHead.load();
+			uint32_t block = 0;
+			while (static_cast<uint32_t>(head) != 0)
+			{
+				uint32_t top = static_cast<uint32_t>(head) - 1;
+				// May read a block that another process just took; the tag then
+				// makes the exchange fail
+				uint64_t next = BlockAt(top).next.load(std::memory_order_relaxed);
+				if (m_header->freeHead.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | next))
+				{
+					block = top + 1;
+					break;
+				}
+			}
+			if (block == 0)
+			{
+				break;
+			}
+			BlockAt(block - 1).next.store(0, std::memory_order_relaxed);
+			if (taken == 0)
+			{
+				first = block - 1;
+			}
+			else
+			{
+				BlockAt(last).next.store(block, std::memory_order_relaxed);
+			}
+			last = block - 1;
+			taken++;
+		}
+		if (taken == count)
+		{
+			return true;
+		}
+		if (taken > 0)
+		{
+			Free(first);
+		}
+		Evict(count);
+		Reclaim();
+		if (attempt > 0)
+		{
+			// Readers in other processes are holding the epoch back
+			std::this_thread::yield();
+		}
+	}
+	return false;
+}
+
+void PollySharedCache::Free(uint32_t first)
+{
+	uint32_t last = first;
+	for (uint32_t hops = 0; hops < m_header->blockCount; hops++)
+	{
+		uint32_t next = BlockAt(last).next.load(std::memory_order_relaxed);
+		if (next == 0)
+		{
+			break;
+		}
+		last = next - 1;
+	}
+	uint64_t head = m_header->freeHead.load();
+	do
+	{
+		BlockAt(last).next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+	} while (!m_header->freeHead.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (first + 1)));
+}
+
+void PollySharedCache::Retire(uint32_t first)
+{
+	auto& entry = EntryAt(first);
+	entry.retireEpoch = m_header->epoch.load();
+	uint32_t head = m_header->limboHead.load();
+	do
+	{
+		entry.limboNext.store(head);
+	} while (!m_header->limboHead.compare_exchange_weak(head, first + 1));
+}
+
+void PollySharedCache::Evict(uint32_t blocks)
+{
+	uint64_t ticket;
+	int reader = Enter(ticket);
+	if (reader < 0)
+	{
+		return;
+	}
+	uint32_t freed = 0;
+	for (uint64_t step = 0; step < 2 * m_header->indexCapacity && freed < blocks; step++)
+	{
+		auto& slot = SlotAt(m_header->clockHand.fetch_add(1));
+		uint64_t word = slot.load();
+		uint32_t first = static_cast<uint32_t>(word) - 1;
+		if (word == 0 || word == kTombstone || first >= m_header->blockCount)
+		{
+			continue;
+		}
+		// Recently read entries get another turn of the clock
+		auto& entry = EntryAt(first);
+		if (entry.referenced.exchange(0) != 0)
+		{
+			continue;
+		}
+		if (slot.compare_exchange_strong(word, kTombstone))
+		{
+			freed += BlocksFor(sizeof(Entry) + static_cast<size_t>(entry.keyLength) + entry.valueLength);
+			Retire(first);
+		}
+	}
+	Leave(reader, ticket);
+}
+
+void PollySharedCache::Reclaim()
+{
+	// Entries retired in epoch e are unreachable to every reader once the
+	// epoch reaches e + 2
+	TryAdvance();
+	TryAdvance();
+	uint64_t epoch = m_header->epoch.load();
+	uint32_t list = m_header->limboHead.exchange(0);
+	for (uint32_t hops = 0; list != 0 && hops < m_header->blockCount; hops++)
+	{
+		uint32_t first = list - 1;
+		auto& entry = EntryAt(first);
+		list = entry.limboNext.load();
+		if (epoch >= entry.retireEpoch + 2)
+		{
+			Free(first);
+			continue;
+		}
+		uint32_t head = m_header->limboHead.load();
+		do
+		{
+			entry.limboNext.store(head);
+		} while (!m_header->limboHead.compare_exchange_weak(head, first + 1));
+	}
+}
+
+bool PollySharedCache::Visit(uint32_t first, size_t offset, size_t length,
+	const std::function<bool(char*, size_t)>& visit) const
+{
+	uint32_t block = first;
+	offset += sizeof(Block);
+	for (;;)
+	{
+		if (offset < kBlockSize)
+		{
+			size_t run = (std::min)(length, kBlockSize - offset);
+			if (run > 0 && !visit(reinterpret_cast<char*>(&BlockAt(block)) + offset, run))
+			{
+				return false;
+			}
+			length -= run;
+			offset = kBlockSize;
+		}
+		if (length == 0)
+		{
+			return true;
+		}
+		uint32_t next = BlockAt(block).next.load(std::memory_order_relaxed);
+		if (next == 0 || next > m_header->blockCount)
+		{
+			return false;
+		}
+		block = next - 1;
+		offset -= kBlockData;
+	}
+}
+
+bool PollySharedCache::Matches(uint32_t first, uint64_t hash, const std::string& key) const
+{
+	auto& entry = EntryAt(first);
+	if (entry.hash != hash || entry.keyLength != key.size())
+	{
+		return false;
+	}
+	size_t compared = 0;
+	return Visit(first, sizeof(Entry), key.size(), [&](char* data, size_t length) {
+		bool same = std::memcmp(data, key.data() + compared, length) == 0;
+		compared += length;
+		return same;
+	});
+}
+
+PollySharedCache::Payload PollySharedCache::Find(const std::string& key)
+{
+	if (!IsOpen())
+	{
+		return nullptr;
+	}
+	uint64_t hash = PollyPhraseStore::Hash(key);
+	uint64_t ticket;
+	int reader = Enter(ticket);
+	if (reader < 0)
+	{
+		return nullptr;
+	}
+	Payload found;
+	for (int probe = 0; probe < kMaxProbes; probe++)
+	{
+		uint64_t word = SlotAt(hash + probe).load(std::memory_order_acquire);
+		if (word == 0)
+		{
+			break;
+		}
+		uint32_t first = static_cast<uint32_t>(word) - 1;
+		if (word == kTombstone || (word >> 32) != (hash >> 32) || first >= m_header->blockCount ||
+			!Matches(first, hash, key))
+		{
+			continue;
+		}
+		// Copied while this reader holds the epoch, so the blocks cannot be reused meanwhile
+		auto& entry = EntryAt(first);
+		auto payload = std::make_shared<std::string>(entry.valueLength, '\0');
+		size_t copied = 0;
+		if (Visit(first, sizeof(Entry) + entry.keyLength, payload->size(), [&](char* data, size_t length) {
+			std::memcpy(&(*payload)[copied], data, length);
+			copied += length;
+			return true;
+		}))
+		{
+			if (entry.referenced.load(std::memory_order_relaxed) == 0)
+			{
+				entry.referenced.store(1, std::memory_order_relaxed);
+			}
+			found = payload;
+		}
+		break;
+	}
+	Leave(reader, ticket);
+	return found;
+}
+
+bool PollySharedCache::Store(const std::string& key, const std::string& payload)
+{
+	if (!IsOpen() || key.size() > UINT32_MAX || payload.size() > UINT32_MAX)
+	{
+		return false;
+	}
+	// One entry may take at most an eighth of the cache
+	uint32_t count = BlocksFor(sizeof(Entry) + key.size() + payload.size());
+	if (count > m_header->blockCount / 8)
+	{
+		return false;
+	}
+	uint64_t hash = PollyPhraseStore::Hash(key);
+	uint32_t first = 0;
+	if (!Allocate(count, first))
+	{
+		return false;
+	}
+	auto& entry = EntryAt(first);
+	entry.hash = hash;
+	entry.keyLength = static_cast<uint32_t>(key.size());
+	entry.valueLength = static_cast<uint32_t>(payload.size());
+	entry.referenced.store(0, std::memory_order_relaxed);
+	entry.limboNext.store(0, std::memory_order_relaxed);
+	entry.retireEpoch = 0;
+	size_t written = 0;
+	const std::string* source = &key;
+	Visit(first, sizeof(Entry), key.size() + payload.size(), [&](char* data, size_t length) {
+		for (size_t done = 0; done < length; )
+		{
+			if (written == source->size())
+			{
+				source = &payload;
+				written = 0;
+			}
+			size_t run = (std::min)(length - done, source->size() - written);
+			std::memcpy(data + done, source->data() + written, run);
+			written += run;
+			done += run;
+		}
+		return true;
+	});
+
+	uint64_t word = ((hash >> 32) << 32) | (first + 1);
+	bool published = false;
+	bool duplicate = false;
+	uint64_t ticket;
+	int reader = Enter(ticket);
+	for (int attempt = 0; reader >= 0 && attempt < 4 && !published && !duplicate; attempt++)
+	{
+		// An empty slot ends the probe sequence; a tombstone can be reused
+		// but the key may still follow it
+		std::atomic<uint64_t>* free = nullptr;
+		uint64_t expected = 0;
+		for (int probe = 0; probe < kMaxProbes; probe++)
+		{
+			auto& slot = SlotAt(hash + probe);
+			uint64_t current = slot.load(std::memory_order_acquire);
+			if (current == 0 || current == kTombstone)
+			{
+				if (free == nullptr)
+				{
+					free = &slot;
+					expected = current;
+				}
+				if (current == 0)
+				{
+					break;
+				}
+				continue;
+			}
+			uint32_t other = static_cast<uint32_t>(current) - 1;
+			if ((current >> 32) == (hash >> 32) && other < m_header->blockCount && Matches(other, hash, key))
+			{
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate && free != nullptr)
+		{
+			published = free->compare_exchange_strong(expected, word, std::memory_order_release);
+		}
+		else if (!duplicate)
+		{
+			break;
+		}
+	}
+	if (reader >= 0)
+	{
+		Leave(reader, ticket);
+	}
+	if (!published)
+	{
+		// Never visible to anyone, so it can be freed at once
+		Free(first);
+	}
+	return published || duplicate;
+}
@@ -0,0 +1,129 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Audio cache shared by every process on the host that loads the engine.
+// It lives in a memory-mapped file, SHARED_CACHE (AudioCache.bin in a
+// directory next to the phrase store by default), of SHARED_CACHE_MB
+// megabytes, so a prompt that one process synthesized is served to all the
+// others from the same physical pages.
+//
+// The file holds an open-addressed index of 64-bit words updated with
+// compare-and-swap, and a slab of fixed-size blocks. An entry is a chain of
+// blocks addressed by block number, never by pointer, since every process
+// maps the file at its own address. Free blocks form a tagged lock-free
+// stack. Entries are evicted by a CLOCK sweep and freed through epoch-based
+// reclamation: a reader publishes the epoch it entered in a slot of the
+// header, and an unlinked entry is only reused two epochs later, once no
+// reader can still be copying it. Reader slots of processes that died are
+// cleared when they hold the epoch back. Each entry into a slot writes a
+// new generation to it, so a reader whose slot was cleared while it was
+// stalled leaves without freeing the slot's next owner.
+//
+// Each process holds a shared lock on the file while it is mapped. The
+// first process to open it when nobody holds that lock checks the whole
+// file, drops entries it cannot trust and rebuilds the free list, which
+// also recovers blocks that a crashed process left half-written.
+class PollySharedCache
+{
+public:
+	typedef std::shared_ptr<const std::string> Payload;
+
+	// Shared cache configured by SHARED_CACHE and SHARED_CACHE_MB
+	static PollySharedCache& Instance();
+
+	// Maps `path`, creating it with `sizeMb` megabytes if it does not exist
+	// or is not a valid cache. An existing cache keeps its size.
+	PollySharedCache(const std::string& path, long sizeMb);
+	~PollySharedCache();
+
+	PollySharedCache(const PollySharedCache&) = delete;
+	PollySharedCache& operator=(const PollySharedCache&) = delete;
+
+	bool IsOpen() const { return m_base != nullptr; }
+	// Why the cache could not be opened
+	const std::string& Error() const { return m_error; }
+	const std::string& Path() const { return m_path; }
+
+	// Returns a private copy of the payload, or nullptr
+	Payload Find(const std::string& key);
+	// Returns false if the payload is too large or no room could be made.
+	// A key that is already cached is left alone.
+	bool Store(const std::string& key, const std::string& payload);
+
+private:
+	struct Header;
+	struct Block;
+	struct Entry;
+
+	bool Open(long sizeMb);
+	void Close();
+	bool Lock(uint64_t offset, bool exclusive, bool wait);
+	void Unlock(uint64_t offset);
+	bool Resize(uint64_t size);
+	uint64_t FileSize();
+	bool Map(uint64_t size);
+	void Unmap();
+	void Initialize(uint64_t size);
+	bool IsValid(uint64_t size) const;
+	void Recover();
+
+	Block& BlockAt(uint32_t index) const;
+	Entry& EntryAt(uint32_t index) const;
+	std::atomic<uint64_t>& SlotAt(uint64_t position) const;
+	uint32_t BlocksFor(size_t bytes) const;
+
+	// Reader slots. Enter sets `ticket` to the value it wrote to the slot,
+	// which Leave only clears if it is still there.
+	int Enter(uint64_t& ticket);
+	void Leave(int slot, uint64_t ticket);
+	bool TryAdvance();
+	bool RecoverReader(int slot, uint64_t value);
+
+	bool Allocate(uint32_t count, uint32_t& first);
+	void Free(uint32_t first);
+	void Retire(uint32_t first);
+	void Evict(uint32_t blocks);
+	void Reclaim();
+
+	// Calls `visit` for each run of `length` bytes of the entry starting at
+	// byte `offset` (counted from the Entry header). Stops when `visit`
+	// returns false or the chain is too short, and then returns false.
+	bool Visit(uint32_t first, size_t offset, size_t length,
+		const std::function<bool(char*, size_t)>& visit) const;
+	bool Matches(uint32_t first, uint64_t hash, const std::string& key) const;
+
+	std::string m_path;
+	std::string m_error;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+	char* m_base;
+	uint64_t m_size;
+	Header* m_header;
+	uint32_t m_processId;
+	std::atomic<uint32_t> m_generation;
+
+	// When each reader slot that is holding the epoch back was first seen
+	std::mutex m_staleLock;
+	std::unique_ptr<std::pair<uint64_t, int64_t>[]> m_staleSince;
+};
@@ -0,0 +1,173 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollySilenceTrim.h"
+#include "PollyConfig.h"
+#include <algorithm>
+#include <cmath>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POLLY_TRIM_SSE2
+#endif
+
+namespace
+{
+	const uint32_t FrameMs = 10;
+	// Quiet audio after speech is released once it is this long: a pause
+	// that long is part of the speech, and holding it would stall playback
+	const uint32_t MaxHeldMs = 1000;
+	// Samples are scaled down by 16 before squaring, so that 16-bit SSE2
+	// multiplies cannot overflow
+	const int EnergyShift = 4;
+}
+
+bool PollySilenceTrimmer::IsEnabled()
+{
+	static const bool enabled = PollyConfig::GetBool("TRIM_SILENCE", false);
+	return enabled;
+}
+
+PollySilenceTrimmer::PollySilenceTrimmer(uint32_t sampleRate)
+	: PollySilenceTrimmer(sampleRate, static_cast<double>(PollyConfig::GetLong("TRIM_THRESHOLD_DB", -50)),
+		static_cast<uint32_t>(std::max(0L, PollyConfig::GetLong("TRIM_PAD_MS", 50))))
+{
+}
+
+PollySilenceTrimmer::PollySilenceTrimmer(uint32_t sampleRate, double thresholdDb, uint32_t padMs)
+	: m_speaking(false), m_headBytes(0), m_trimmedBytes(0)
+{
+	m_bytesPerMs = 2 * sampleRate / 1000;
+	m_frameBytes = FrameMs * m_bytesPerMs;
+	m_padBytes = padMs * m_bytesPerMs;
+	m_maxHeldBytes = std::max(m_padBytes, MaxHeldMs * m_bytesPerMs);
+	double amplitude = 32768.0 * std::pow(10.0, std::min(0.0, thresholdDb) / 20) / (1 << EnergyShift);
+	m_threshold = static_cast<uint64_t>(amplitude * amplitude * (m_frameBytes / 2));
+}
+
+uint64_t PollySilenceTrimmer::Energy(const char* pcm, size_t count, bool simd)
+{
+	auto in = reinterpret_cast<const uint8_t*>(pcm);
+	uint64_t energy = 0;
+	size_t i = 0;
+#ifdef POLLY_TRIM_SSE2
+	if (simd)
+	{
+		// Each 32-bit lane gains at most 2 * 2048^2 per step, so it is
+		// added to the total every 128 steps
+		while (i + 8 <= count)
+		{
+			__m128i sums = _mm_setzero_si128();
+			for (size_t steps = 0; steps < 128 && i + 8 <= count; steps++, i += 8)
+			{
+				__m128i samples = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i)), EnergyShift);
+				sums = _mm_add_epi32(sums, _mm_madd_epi16(samples, samples));
+			}
+			uint32_t lanes[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+			energy += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		int sample = static_cast<int16_t>(in[2 * i] | in[2 * i + 1] << 8) >> EnergyShift;
+		energy += static_cast<uint64_t>(sample * sample);
+	}
+	return energy;
+}
+
+bool PollySilenceTrimmer::Emit(const Sink& sink, const std::string& data, size_t size)
+{
+	return size == 0 || sink(data.data(), size);
+}
+
+void PollySilenceTrimmer::Frame(const char* frame, const Sink& sink, bool& ok)
+{
+	bool loud = Energy(frame, m_frameBytes / 2) > m_threshold;
+	if (loud)
+	{
+		m_speaking = true;
+		ok = Emit(sink, m_quiet, m_quiet.size()) && sink(frame, m_frameBytes);
+		m_quiet.clear();
+		return;
+	}
+	m_quiet.append(frame, m_frameBytes);
+	if (!m_speaking && m_quiet.size() > m_padBytes)
+	{
+		size_t dropped = m_quiet.size() - m_padBytes;
+		m_quiet.erase(0, dropped);
+		m_headBytes += dropped;
+		m_trimmedBytes += dropped;
+	}
+	else if (m_speaking && m_quiet.size() > m_maxHeldBytes)
+	{
+		ok = Emit(sink, m_quiet, m_quiet.size());
+		m_quiet.clear();
+	}
+}
+
+bool PollySilenceTrimmer::Push(const char* data, size_t size, const Sink& sink)
+{
+	bool ok = true;
+	if (!m_partial.empty())
+	{
+		size_t taken = std::min(size, m_frameBytes - m_partial.size());
+		m_partial.append(data, taken);
+		data += taken;
+		size -= taken;
+		if (m_partial.size() < m_frameBytes)
+		{
+			return true;
+		}
+		Frame(m_partial.data(), sink, ok);
+		m_partial.clear();
+	}
+	for (; ok && size >= m_frameBytes; data += m_frameBytes, size -= m_frameBytes)
+	{
+		Frame(data, sink, ok);
+	}
+	if (ok)
+	{
+		m_partial.assign(data, size);
+	}
+	return ok;
+}
+
+bool PollySilenceTrimmer::Finish(const Sink& sink)
+{
+	// The last, short frame is counted as quiet; an odd byte is dropped
+	m_quiet.append(m_partial, 0, m_partial.size() & ~static_cast<size_t>(1));
+	m_trimmedBytes += m_partial.size() & 1;
+	m_partial.clear();
+	size_t kept = m_speaking ? std::min(m_padBytes, m_quiet.size()) : m_quiet.size();
+	m_trimmedBytes += m_quiet.size() - kept;
+	bool ok = Emit(sink, m_quiet, kept);
+	m_quiet.clear();
+	return ok;
+}
+
+uint32_t PollySilenceTrimmer::TrimmedHeadMs() const
+{
+	return static_cast<uint32_t>(m_headBytes / m_bytesPerMs);
+}
+
+std::string PollySilenceTrimmer::Trim(const std::string& pcm)
+{
+	std::string trimmed;
+	trimmed.reserve(pcm.size());
+	auto append = [&](const char* data, size_t size) {
+		trimmed.append(data, size);
+		return true;
+	};
+	Push(pcm.data(), pcm.size(), append);
+	Finish(append);
+	return trimmed;
+}
@@ -0,0 +1,72 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Cuts the near-silence that Polly leaves before and after speech, which
+// delays the start of playback and leaves gaps where responses are joined.
+// 16-bit PCM is looked at in 10 ms frames; speech starts at the first frame
+// whose energy is above TRIM_THRESHOLD_DB (dBFS) and ends after the last
+// one. TRIM_PAD_MS of the silence is kept on each side.
+//
+// The trimmer works on a stream: the head is cut as it goes by, and only
+// quiet audio after the latest speech is held back, since it may turn out
+// to be the tail.
+class PollySilenceTrimmer
+{
+public:
+	// Receives trimmed PCM. Returning false stops the stream.
+	typedef std::function<bool(const char* data, size_t size)> Sink;
+
+	// TRIM_SILENCE
+	static bool IsEnabled();
+
+	// With the threshold and pad from the settings
+	explicit PollySilenceTrimmer(uint32_t sampleRate);
+	PollySilenceTrimmer(uint32_t sampleRate, double thresholdDb, uint32_t padMs);
+
+	bool Push(const char* data, size_t size, const Sink& sink);
+	// Passes what is left, less the trailing silence beyond the pad.
+	bool Finish(const Sink& sink);
+
+	// Milliseconds cut from the head, by which speech marks move earlier
+	uint32_t TrimmedHeadMs() const;
+	uint64_t TrimmedBytes() const { return m_trimmedBytes; }
+
+	// Trims a whole response
+	std::string Trim(const std::string& pcm);
+
+	// Sum of the squares of `count` samples scaled down by 16, as the
+	// threshold is compared with. Uses SSE2 unless `simd` is false.
+	static uint64_t Energy(const char* pcm, size_t count, bool simd = true);
+
+private:
+	void Frame(const char* frame, const Sink& sink, bool& ok);
+	static bool Emit(const Sink& sink, const std::string& data, size_t size);
+
+	size_t m_frameBytes;
+	size_t m_padBytes;
+	size_t m_maxHeldBytes;
+	size_t m_bytesPerMs;
+	uint64_t m_threshold;
+	bool m_speaking;
+	// Before speech, the last pad of silence; after it, the quiet audio since
+	// the last loud frame
+	std::string m_quiet;
+	std::string m_partial;
+	uint64_t m_headBytes;
+	uint64_t m_trimmedBytes;
+};
@@ -0,0 +1,68 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollySingleFlight.h"
+
+std::mutex PollySingleFlight::s_lock;
+std::unordered_map<std::string, std::shared_ptr<PollySingleFlight::Flight>> PollySingleFlight::s_inFlight;
+
+PollyTask<PollyFetchResult> PollySingleFlight::Run(std::string key, Fetch fetch, bool& merged)
+{
+	std::shared_ptr<Flight> flight;
+	{
+		std::lock_guard<std::mutex> guard(s_lock);
+		auto found = s_inFlight.find(key);
+		merged = found != s_inFlight.end();
+		if (merged)
+		{
+			flight = found->second;
+		}
+		else
+		{
+			flight = std::make_shared<Flight>();
+			s_inFlight.emplace(key, flight);
+		}
+	}
+	if (merged)
+	{
+		co_await flight->Done.Wait();
+		if (flight->Error)
+		{
+			std::rethrow_exception(flight->Error);
+		}
+		co_return flight->Result;
+	}
+
+	PollyFetchResult result;
+	std::exception_ptr error;
+	try
+	{
+		result = co_await fetch();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	// Callers arriving from now on start a new request rather than reuse
+	// this one
+	{
+		std::lock_guard<std::mutex> guard(s_lock);
+		s_inFlight.erase(key);
+	}
+	flight->Result = result;
+	flight->Error = error;
+	flight->Done.Set();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	co_return result;
+}
@@ -0,0 +1,51 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "PollyExecutor.h"
+
+// Outcome of one Polly call (audio or speech marks). `Body` is immutable
+// and refcounted, so every caller merged into the call shares one buffer.
+struct PollyFetchResult
+{
+	std::shared_ptr<const std::string> Body;
+	std::string ErrorMessage;
+};
+
+// Process-wide table of Polly calls in flight. Concurrent callers with the
+// same key (voice, output and text) are merged: the first one fetches and
+// the others await its result.
+class PollySingleFlight
+{
+public:
+	typedef std::function<PollyTask<PollyFetchResult>()> Fetch;
+
+	// Sets `merged` when the result came from another caller's request.
+	static PollyTask<PollyFetchResult> Run(std::string key, Fetch fetch, bool& merged);
+
+private:
+	struct Flight
+	{
+		PollyAsyncEvent Done;
+		PollyFetchResult Result;
+		std::exception_ptr Error;
+	};
+
+	static std::mutex s_lock;
+	static std::unordered_map<std::string, std::shared_ptr<Flight>> s_inFlight;
+};
@@ -11,6 +11,7 @@ or implied.See the License for the specific language governing
 permissions and limitations under the License. */
 
 #pragma once
+#include <memory>
 #include <vector>
 #include "SpeechMark.h"
 
@@ -18,5 +19,7 @@ class PollySpeechMarksResponse
 {
 public:
 	std::vector<SpeechMark> SpeechMarks = std::vector<SpeechMark>(10000);
+	// The marks as Polly returned them, one JSON object per line
+	std::shared_ptr<const std::string> Json;
 	std::string ErrorMessage;
 };
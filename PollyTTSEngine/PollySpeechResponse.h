@@ -11,13 +11,17 @@ or implied.See the License for the specific language governing
 permissions and limitations under the License. */
 
 #pragma once
-#include <vector>
+#include <memory>
+#include <string>
 
 class PollySpeechResponse
 {
 public:
-	std::streamsize Length;
-	std::vector<unsigned char> AudioData = std::vector<unsigned char>(5000000);
+	std::streamsize Length = 0;
+	// 16-bit PCM; shared with merged requests and the last known good store
+	std::shared_ptr<const std::string> AudioData;
 	std::string ErrorMessage ;
-	bool IsSuccess;
+	bool IsSuccess = false;
+	// The audio went to the caller's sink as it arrived; AudioData is empty
+	bool Streamed = false;
 };
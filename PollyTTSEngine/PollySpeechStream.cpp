@@ -0,0 +1,187 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollySpeechStream.h"
+#include "PollyConfig.h"
+#include "PollyExecutor.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+namespace
+{
+	bool IsSpace(wchar_t c)
+	{
+		return c == L' ' || c == L'\t' || c == L'\r' || c == L'\n' || c == 0x00A0 || c == 0x3000;
+	}
+
+	bool IsSentenceEnd(wchar_t c)
+	{
+		return c == L'.' || c == L'!' || c == L'?' || c == L';' || c == L'\n' ||
+			c == 0x3002 || c == 0xFF01 || c == 0xFF1F;
+	}
+
+	bool IsHighSurrogate(wchar_t c)
+	{
+		return sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF;
+	}
+
+	void AppendUtf8(std::string& out, uint32_t code)
+	{
+		if (code < 0x80)
+		{
+			out += static_cast<char>(code);
+		}
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+
+	// Owns everything it uses, so it can finish after the stream is gone
+	PollyTask<PollySpeechResponse> SynthesizeChunk(PollySpeechStream::Synthesize synthesize, std::string text)
+	{
+		co_return co_await synthesize(std::move(text));
+	}
+}
+
+PollySpeechStream::PollySpeechStream(const Synthesize& synthesize)
+	: PollySpeechStream(synthesize,
+		static_cast<size_t>(std::max(100L, PollyConfig::GetLong("STREAM_CHUNK_CHARS", 1500))),
+		static_cast<size_t>(std::max(1L, PollyConfig::GetLong("STREAM_WINDOW", 3))))
+{
+}
+
+PollySpeechStream::PollySpeechStream(const Synthesize& synthesize, size_t chunkChars, size_t window)
+	: m_synthesize(synthesize), m_chunkChars(std::max<size_t>(chunkChars, 2)), m_window(std::max<size_t>(window, 1))
+{
+}
+
+bool PollySpeechStream::NextChunk(const wchar_t*& next, const wchar_t* end, size_t chunkChars,
+	const wchar_t*& chunk, size_t& length)
+{
+	while (next < end && IsSpace(*next))
+	{
+		++next;
+	}
+	if (next >= end)
+	{
+		return false;
+	}
+
+	chunk = next;
+	if (static_cast<size_t>(end - next) <= chunkChars)
+	{
+		length = end - next;
+		next = end;
+		return true;
+	}
+
+	// Break after the last sentence end in the second half of the window,
+	// else at the last whitespace, and only cut a word as a last resort
+	const wchar_t* limit = next + chunkChars;
+	const wchar_t* cut = nullptr;
+	for (const wchar_t* p = limit - 1; p > next + chunkChars / 2 && cut == nullptr; --p)
+	{
+		if (IsSentenceEnd(*p) && IsSpace(p[1]))
+		{
+			cut = p + 1;
+		}
+	}
+	for (const wchar_t* p = limit; p > next && cut == nullptr; --p)
+	{
+		if (IsSpace(*p))
+		{
+			cut = p;
+		}
+	}
+	if (cut == nullptr)
+	{
+		cut = IsHighSurrogate(limit[-1]) ? limit - 1 : limit;
+	}
+	length = cut - chunk;
+	next = cut;
+	return true;
+}
+
+std::string PollySpeechStream::ToUtf8(const wchar_t* text, size_t length)
+{
+	std::string out;
+	out.reserve(length + length / 2);
+	for (size_t i = 0; i < length; i++)
+	{
+		uint32_t code = static_cast<uint32_t>(text[i]);
+		if (IsHighSurrogate(text[i]) && i + 1 < length && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+		{
+			code = 0x10000 + ((code - 0xD800) << 10) + (static_cast<uint32_t>(text[++i]) - 0xDC00);
+		}
+		AppendUtf8(out, code);
+	}
+	return out;
+}
+
+PollyTask<bool> PollySpeechStream::Run(const wchar_t* text, size_t length, Output output, std::string& error)
+{
+	struct Pending
+	{
+		const wchar_t* Chunk;
+		size_t Length;
+		PollyFuture<PollySpeechResponse> Audio;
+	};
+	// A chunk left pending when speaking stops still finishes on the
+	// executor, and its audio is dropped with the last reference to it
+	std::deque<Pending> pending;
+	const wchar_t* next = text;
+	const wchar_t* end = text + length;
+
+	auto fill = [&]() {
+		const wchar_t* chunk;
+		size_t chunkLength;
+		while (pending.size() < m_window && NextChunk(next, end, m_chunkChars, chunk, chunkLength))
+		{
+			pending.push_back(Pending{ chunk, chunkLength,
+				PollyExecutor::Shared().Spawn(SynthesizeChunk(m_synthesize, ToUtf8(chunk, chunkLength))) });
+		}
+	};
+
+	fill();
+	while (!pending.empty())
+	{
+		auto& head = pending.front();
+		PollySpeechResponse audio = co_await head.Audio;
+		if (!audio.IsSuccess)
+		{
+			error = audio.ErrorMessage;
+			co_return false;
+		}
+		if (!co_await output(audio, head.Chunk, head.Length))
+		{
+			co_return true;
+		}
+		pending.pop_front();
+		fill();
+	}
+	co_return true;
+}
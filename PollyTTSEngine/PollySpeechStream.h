@@ -0,0 +1,52 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "PollySpeechResponse.h"
+#include "PollyTask.h"
+
+// Speaks a document of any length in bounded memory. The text is cut into
+// chunks of at most STREAM_CHUNK_CHARS characters as it is read, preferring
+// sentence ends and then whitespace. At most STREAM_WINDOW chunks are
+// converted and being synthesized at a time, as tasks on the PollyExecutor;
+// each chunk's audio is handed to the output callback in document order and
+// released right after.
+class PollySpeechStream
+{
+public:
+	// Synthesizes one chunk of UTF-8 text. Started on the PollyExecutor.
+	typedef std::function<PollyTask<PollySpeechResponse>(std::string text)> Synthesize;
+	// Receives the audio of the chunk [chunk, chunk + length) of the input.
+	// Starts on the PollyExecutor; returns false to stop speaking.
+	typedef std::function<PollyTask<bool>(const PollySpeechResponse& audio, const wchar_t* chunk, size_t length)> Output;
+
+	explicit PollySpeechStream(const Synthesize& synthesize);
+	PollySpeechStream(const Synthesize& synthesize, size_t chunkChars, size_t window);
+
+	// Returns false with `error` set if a chunk failed to synthesize. Stopping
+	// from `output` is not an error. `text` must outlive the task.
+	PollyTask<bool> Run(const wchar_t* text, size_t length, Output output, std::string& error);
+
+	// Finds the next chunk in [next, end) and advances `next` past it.
+	// Returns false when only whitespace is left.
+	static bool NextChunk(const wchar_t*& next, const wchar_t* end, size_t chunkChars,
+		const wchar_t*& chunk, size_t& length);
+	static std::string ToUtf8(const wchar_t* text, size_t length);
+
+private:
+	Synthesize m_synthesize;
+	size_t m_chunkChars;
+	size_t m_window;
+};
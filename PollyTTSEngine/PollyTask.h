@@ -0,0 +1,103 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// Coroutine that produces a T. It does nothing until it is awaited, and
+// when it finishes it resumes its awaiter on the thread it finished on.
+// Ordinary code runs one with PollyCallerLoop::Run or PollyExecutor::Spawn.
+// Arguments passed by reference must outlive the task, as they would a call.
+template <typename T>
+class PollyTask
+{
+public:
+	struct promise_type
+	{
+		std::optional<T> Value;
+		std::exception_ptr Error;
+		std::coroutine_handle<> Continuation;
+
+		PollyTask get_return_object()
+		{
+			return PollyTask(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		struct ResumeAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			// Transferring to the awaiter, rather than calling it, keeps long
+			// chains of tasks that finish at once from growing the stack
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+			{
+				auto continuation = self.promise().Continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		ResumeAwaiter final_suspend() noexcept { return {}; }
+
+		template <typename U>
+		void return_value(U&& value) { Value.emplace(std::forward<U>(value)); }
+		void unhandled_exception() { Error = std::current_exception(); }
+	};
+
+	PollyTask(PollyTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+	PollyTask& operator=(PollyTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_handle)
+			{
+				m_handle.destroy();
+			}
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+	~PollyTask()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	PollyTask(const PollyTask&) = delete;
+	PollyTask& operator=(const PollyTask&) = delete;
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+	{
+		m_handle.promise().Continuation = awaiter;
+		return m_handle;
+	}
+	T await_resume()
+	{
+		auto& promise = m_handle.promise();
+		if (promise.Error)
+		{
+			std::rethrow_exception(promise.Error);
+		}
+		return std::move(*promise.Value);
+	}
+
+private:
+	explicit PollyTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
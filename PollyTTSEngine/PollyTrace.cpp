@@ -0,0 +1,241 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyTrace.h"
+#include "PollyConfig.h"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+std::atomic<bool> PollyTrace::s_enabled(false);
+
+namespace
+{
+	const uint64_t kRingSize = 4096;
+
+	// Each field is an atomic so that a flush can read a slot while its
+	// thread overwrites it; `sequence` tells the flush whether it did.
+	struct TraceEvent
+	{
+		// 2 * index + 2 once event `index` is written, odd while it is written
+		std::atomic<uint64_t> sequence;
+		std::atomic<const char*> name;
+		std::atomic<uint32_t> threadId;
+		std::atomic<uint64_t> requestId;
+		std::atomic<int64_t> startMicros;
+		std::atomic<int64_t> durationMicros;
+	};
+
+	// One ring per live thread. Only the owning thread writes to it; a
+	// thread that exits hands its ring, and the spans in it, to the next
+	// thread that records one.
+	struct TraceRing
+	{
+		std::atomic<bool> inUse;
+		std::atomic<uint64_t> written;
+		TraceEvent events[kRingSize];
+
+		TraceRing() : inUse(true), written(0)
+		{
+			for (auto& e : events) e.sequence.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	std::mutex g_ringLock;
+	std::vector<TraceRing*> g_rings; // rings are recycled, never freed
+	std::string g_traceFile;
+	std::chrono::steady_clock::time_point g_origin = std::chrono::steady_clock::now();
+	std::atomic<int64_t> g_lastFlushMicros(0);
+	std::atomic<uint64_t> g_nextRequestId(1);
+	thread_local uint64_t t_requestId = 0;
+
+	uint32_t CurrentThreadId()
+	{
+#ifdef _WIN32
+		return GetCurrentThreadId();
+#else
+		return static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+	}
+
+	uint32_t CurrentProcessId()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	TraceRing* AcquireRing()
+	{
+		std::lock_guard<std::mutex> lock(g_ringLock);
+		for (auto ring : g_rings)
+		{
+			bool expected = false;
+			if (ring->inUse.compare_exchange_strong(expected, true))
+			{
+				return ring;
+			}
+		}
+		g_rings.push_back(new TraceRing());
+		return g_rings.back();
+	}
+
+	struct RingHandle
+	{
+		TraceRing* ring;
+		uint32_t threadId;
+		RingHandle() : ring(AcquireRing()), threadId(CurrentThreadId()) {}
+		~RingHandle() { ring->inUse.store(false); }
+	};
+
+	RingHandle& LocalRing()
+	{
+		thread_local RingHandle handle;
+		return handle;
+	}
+
+	int64_t MicrosSinceOrigin(std::chrono::steady_clock::time_point t)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(t - g_origin).count();
+	}
+}
+
+void PollyTrace::Initialize()
+{
+	static std::once_flag initialized;
+	std::call_once(initialized, []()
+	{
+		g_traceFile = PollyConfig::GetString("TRACE_FILE");
+		s_enabled.store(!g_traceFile.empty());
+	});
+}
+
+uint64_t PollyTrace::BeginRequest()
+{
+	// Process ID in the high bits keeps IDs unique across engine processes
+	t_requestId = (static_cast<uint64_t>(CurrentProcessId()) << 32) | g_nextRequestId.fetch_add(1);
+	return t_requestId;
+}
+
+uint64_t PollyTrace::CurrentRequestId()
+{
+	return t_requestId;
+}
+
+void PollyTrace::SetCurrentRequestId(uint64_t requestId)
+{
+	t_requestId = requestId;
+}
+
+std::string PollyTrace::FormatRequestId(uint64_t requestId)
+{
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(requestId));
+	return buffer;
+}
+
+void PollyTrace::Record(const char* name, std::chrono::steady_clock::time_point start,
+	std::chrono::steady_clock::time_point end)
+{
+	auto& local = LocalRing();
+	auto& ring = *local.ring;
+	uint64_t index = ring.written.load(std::memory_order_relaxed);
+	TraceEvent& e = ring.events[index % kRingSize];
+	e.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.name.store(name, std::memory_order_relaxed);
+	e.threadId.store(local.threadId, std::memory_order_relaxed);
+	e.requestId.store(t_requestId, std::memory_order_relaxed);
+	e.startMicros.store(MicrosSinceOrigin(start), std::memory_order_relaxed);
+	e.durationMicros.store(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+		std::memory_order_relaxed);
+	e.sequence.store(2 * index + 2, std::memory_order_release);
+	ring.written.store(index + 1, std::memory_order_release);
+}
+
+void PollyTrace::Flush(bool force)
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+	int64_t now = MicrosSinceOrigin(std::chrono::steady_clock::now());
+	int64_t last = g_lastFlushMicros.load();
+	if (!force && now - last < 1000000)
+	{
+		return;
+	}
+	if (!g_lastFlushMicros.compare_exchange_strong(last, now) && !force)
+	{
+		return;
+	}
+
+	std::ostringstream out;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	uint32_t pid = CurrentProcessId();
+	{
+		std::lock_guard<std::mutex> lock(g_ringLock);
+		for (auto ring : g_rings)
+		{
+			uint64_t written = ring->written.load(std::memory_order_acquire);
+			uint64_t begin = written > kRingSize ? written - kRingSize : 0;
+			for (uint64_t i = begin; i < written; i++)
+			{
+				const TraceEvent& e = ring->events[i % kRingSize];
+				uint64_t sequence = e.sequence.load(std::memory_order_acquire);
+				const char* name = e.name.load(std::memory_order_relaxed);
+				uint32_t threadId = e.threadId.load(std::memory_order_relaxed);
+				uint64_t requestId = e.requestId.load(std::memory_order_relaxed);
+				int64_t startMicros = e.startMicros.load(std::memory_order_relaxed);
+				int64_t durationMicros = e.durationMicros.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				// Skip a slot that its thread has moved on to since `written` was read
+				if (sequence != 2 * i + 2 || e.sequence.load(std::memory_order_relaxed) != sequence)
+				{
+					continue;
+				}
+				out << (first ? "" : ",") << "\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << startMicros
+					<< ",\"dur\":" << durationMicros << ",\"pid\":" << pid << ",\"tid\":" << threadId
+					<< ",\"args\":{\"request_id\":\"" << FormatRequestId(requestId) << "\"}}";
+				first = false;
+			}
+		}
+	}
+	out << "\n]}\n";
+
+	std::string temp = g_traceFile + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return;
+		}
+		file << out.str();
+	}
+#ifdef _WIN32
+	MoveFileExA(temp.c_str(), g_traceFile.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	std::rename(temp.c_str(), g_traceFile.c_str());
+#endif
+}
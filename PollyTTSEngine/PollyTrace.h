@@ -0,0 +1,76 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Opt-in span tracing. When POLLY_TTS_TRACE_FILE is set, spans are kept in a
+// per-thread ring buffer and written as Chrome trace-event JSON (open it in
+// Perfetto or chrome://tracing). When it is not set, a span costs one branch.
+class PollyTrace
+{
+public:
+	static void Initialize();
+	static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+	// Starts a new request on the calling thread; spans recorded afterwards
+	// carry its ID. Returns the ID.
+	static uint64_t BeginRequest();
+	static uint64_t CurrentRequestId();
+	static void SetCurrentRequestId(uint64_t requestId);
+	static std::string FormatRequestId(uint64_t requestId);
+
+	static void Record(const char* name, std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end);
+
+	// Rewrites the trace file with the spans currently held in the ring
+	// buffers. Calls made less than a second after the last flush are ignored
+	// unless `force` is set.
+	static void Flush(bool force = false);
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+class ScopedTraceSpan
+{
+public:
+	explicit ScopedTraceSpan(const char* name)
+		: m_name(PollyTrace::IsEnabled() ? name : nullptr)
+	{
+		if (m_name != nullptr)
+		{
+			m_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~ScopedTraceSpan()
+	{
+		if (m_name != nullptr)
+		{
+			PollyTrace::Record(m_name, m_start, std::chrono::steady_clock::now());
+		}
+	}
+
+	ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+	ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+private:
+	const char* m_name;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+// Header that carries the request ID to Polly.
+#define POLLY_TRACE_HEADER "x-polly-tts-request-id"
@@ -0,0 +1,408 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyVoiceCatalog.h"
+#include "PollyConfig.h"
+#include <aws/polly/model/DescribeVoicesRequest.h>
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
+#ifdef GetMessage
+#undef GetMessage
+#endif
+
+using namespace Aws::Polly::Model;
+
+namespace
+{
+	std::string DefaultPath()
+	{
+		const char* programData = std::getenv("ProgramData");
+		if (programData == nullptr || *programData == '\0')
+		{
+			return "";
+		}
+		return std::string(programData) + "\\Amazon\\PollyTTS\\voices.json";
+	}
+
+	std::string ToLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(),
+			[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	}
+
+	int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	// Polly only returns PCM at these rates
+	const int kPcmSampleRates[] = { 8000, 16000 };
+}
+
+PollyVoiceCatalog& PollyVoiceCatalog::Instance()
+{
+	static PollyVoiceCatalog catalog;
+	return catalog;
+}
+
+PollyVoiceCatalog::PollyVoiceCatalog()
+	: m_loadedFileTime(0)
+{
+	m_path = PollyConfig::GetString("VOICE_CATALOG", DefaultPath());
+	m_ttlSeconds = (std::max)(1L, PollyConfig::GetLong("VOICE_CATALOG_TTL_HOURS", 24)) * 3600;
+	Load();
+}
+
+uint16_t PollyVoiceCatalog::Lcid(const std::string& languageCode)
+{
+	// Polly codes that are not Windows locale names, and the ids the
+	// installer has always registered
+	static const std::unordered_map<std::string, uint16_t> known = {
+		{ "arb", 0x0401 },
+		{ "cmn-cn", 0x0804 },
+		{ "cy-gb", 0x0452 },
+		{ "da-dk", 0x0406 },
+		{ "de-de", 0x0C07 },
+		{ "en-au", 0x0C09 },
+		{ "en-gb", 0x0809 },
+		{ "en-gb-wls", 0x0809 },
+		{ "en-in", 0x4009 },
+		{ "en-us", 0x0409 },
+		{ "es-es", 0x2C0A },
+		{ "es-us", 0x540A },
+		{ "fr-ca", 0x0C0C },
+		{ "fr-fr", 0x040C },
+		{ "is-is", 0x040F },
+		{ "it-it", 0x0410 },
+		{ "ja-jp", 0x0411 },
+		{ "nb-no", 0x0414 },
+		{ "nl-nl", 0x0813 },
+		{ "pl-pl", 0x0415 },
+		{ "pt-br", 0x0416 },
+		{ "pt-pt", 0x0816 },
+		{ "ro-ro", 0x0418 },
+		{ "ru-ru", 0x0419 },
+		{ "sv-se", 0x081D },
+		{ "tr-tr", 0x041F },
+	};
+	auto found = known.find(ToLower(languageCode));
+	if (found != known.end())
+	{
+		return found->second;
+	}
+#ifdef _WIN32
+	// Languages added to Polly later, such as "ko-KR"
+	std::wstring name(languageCode.begin(), languageCode.end());
+	LCID lcid = LocaleNameToLCID(name.c_str(), 0);
+	if (lcid != 0)
+	{
+		return static_cast<uint16_t>(LANGIDFROMLCID(lcid));
+	}
+#endif
+	return 0x0409;
+}
+
+bool PollyVoiceCatalog::Find(const std::string& id, PollyVoiceInfo& voice)
+{
+	std::shared_ptr<const Snapshot> snapshot;
+	int64_t loadedFileTime;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		snapshot = m_snapshot;
+		loadedFileTime = m_loadedFileTime;
+	}
+	auto key = ToLower(id);
+	if (!snapshot || snapshot->ByLowerId.find(key) == snapshot->ByLowerId.end())
+	{
+		int64_t fileTime = FileTime();
+		if (fileTime == 0 || fileTime == loadedFileTime || !Load())
+		{
+			return false;
+		}
+		std::lock_guard<std::mutex> guard(m_lock);
+		snapshot = m_snapshot;
+	}
+	auto found = snapshot->ByLowerId.find(key);
+	if (found == snapshot->ByLowerId.end())
+	{
+		return false;
+	}
+	voice = snapshot->Voices[found->second];
+	return true;
+}
+
+std::vector<PollyVoiceInfo> PollyVoiceCatalog::Voices() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_snapshot ? m_snapshot->Voices : std::vector<PollyVoiceInfo>();
+}
+
+bool PollyVoiceCatalog::IsLoaded() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_snapshot != nullptr;
+}
+
+bool PollyVoiceCatalog::IsStale() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return !m_snapshot || Now() - m_snapshot->FetchedAt >= m_ttlSeconds;
+}
+
+void PollyVoiceCatalog::Index(Snapshot& snapshot)
+{
+	snapshot.ByLowerId.clear();
+	for (size_t i = 0; i < snapshot.Voices.size(); i++)
+	{
+		snapshot.ByLowerId[ToLower(snapshot.Voices[i].Id)] = i;
+	}
+}
+
+int64_t PollyVoiceCatalog::FileTime() const
+{
+	struct stat info;
+	if (m_path.empty() || stat(m_path.c_str(), &info) != 0)
+	{
+		return 0;
+	}
+	return static_cast<int64_t>(info.st_mtime);
+}
+
+bool PollyVoiceCatalog::Load()
+{
+	int64_t fileTime = FileTime();
+	std::ifstream file(m_path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string json = contents.str();
+
+	rapidjson::Document document;
+	document.Parse(json.c_str(), json.size());
+	if (document.HasParseError() || !document.IsObject() ||
+		!document.HasMember("version") || !document["version"].IsInt() ||
+		document["version"].GetInt() != FormatVersion ||
+		!document.HasMember("voices") || !document["voices"].IsArray())
+	{
+		return false;
+	}
+
+	auto snapshot = std::make_shared<Snapshot>();
+	if (document.HasMember("fetched") && document["fetched"].IsUint64())
+	{
+		snapshot->FetchedAt = static_cast<int64_t>(document["fetched"].GetUint64());
+	}
+	auto stringMember = [](const rapidjson::Value& value, const char* name) {
+		return value.HasMember(name) && value[name].IsString() ?
+			std::string(value[name].GetString(), value[name].GetStringLength()) : std::string();
+	};
+	const rapidjson::Value& voices = document["voices"];
+	for (auto entryIt = voices.Begin(); entryIt != voices.End(); ++entryIt)
+	{
+		const rapidjson::Value& entry = *entryIt;
+		if (!entry.IsObject())
+		{
+			continue;
+		}
+		PollyVoiceInfo voice;
+		voice.Id = stringMember(entry, "id");
+		if (voice.Id.empty())
+		{
+			continue;
+		}
+		voice.LanguageCode = stringMember(entry, "languageCode");
+		voice.LanguageName = stringMember(entry, "languageName");
+		voice.Gender = stringMember(entry, "gender");
+		voice.Lcid = entry.HasMember("lcid") && entry["lcid"].IsInt() ?
+			static_cast<uint16_t>(entry["lcid"].GetInt()) : Lcid(voice.LanguageCode);
+		if (entry.HasMember("engines") && entry["engines"].IsArray())
+		{
+			const rapidjson::Value& engines = entry["engines"];
+			for (auto engine = engines.Begin(); engine != engines.End(); ++engine)
+			{
+				if (engine->IsString())
+				{
+					voice.Engines.push_back(engine->GetString());
+				}
+			}
+		}
+		if (entry.HasMember("sampleRates") && entry["sampleRates"].IsArray())
+		{
+			const rapidjson::Value& rates = entry["sampleRates"];
+			for (auto rate = rates.Begin(); rate != rates.End(); ++rate)
+			{
+				if (rate->IsInt())
+				{
+					voice.SampleRates.push_back(rate->GetInt());
+				}
+			}
+		}
+		snapshot->Voices.push_back(std::move(voice));
+	}
+	Index(*snapshot);
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_snapshot = snapshot;
+	m_loadedFileTime = fileTime;
+	return true;
+}
+
+bool PollyVoiceCatalog::Refresh(Aws::Polly::PollyClient& client, std::string& error)
+{
+	auto snapshot = std::make_shared<Snapshot>();
+	DescribeVoicesRequest request;
+	for (;;)
+	{
+		auto outcome = client.DescribeVoices(request);
+		if (!outcome.IsSuccess())
+		{
+			error = outcome.GetError().GetMessage().c_str();
+			return false;
+		}
+		for (auto& voice : outcome.GetResult().GetVoices())
+		{
+			PollyVoiceInfo info;
+			info.Id = VoiceIdMapper::GetNameForVoiceId(voice.GetId()).c_str();
+			info.LanguageCode = LanguageCodeMapper::GetNameForLanguageCode(voice.GetLanguageCode()).c_str();
+			info.LanguageName = voice.GetLanguageName().c_str();
+			info.Lcid = Lcid(info.LanguageCode);
+			info.Gender = GenderMapper::GetNameForGender(voice.GetGender()).c_str();
+			for (auto engine : voice.GetSupportedEngines())
+			{
+				info.Engines.push_back(EngineMapper::GetNameForEngine(engine).c_str());
+			}
+			info.SampleRates.assign(std::begin(kPcmSampleRates), std::end(kPcmSampleRates));
+			snapshot->Voices.push_back(std::move(info));
+		}
+		if (outcome.GetResult().GetNextToken().empty())
+		{
+			break;
+		}
+		request.SetNextToken(outcome.GetResult().GetNextToken());
+	}
+	std::sort(snapshot->Voices.begin(), snapshot->Voices.end(),
+		[](const PollyVoiceInfo& a, const PollyVoiceInfo& b) { return a.Id < b.Id; });
+	snapshot->FetchedAt = Now();
+	Index(*snapshot);
+
+	// A catalog that cannot be written, for example because the user may
+	// not write to %ProgramData%, is still used until the process ends
+	bool saved = Save(*snapshot, error);
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_snapshot = snapshot;
+	m_loadedFileTime = saved ? FileTime() : m_loadedFileTime;
+	return saved;
+}
+
+bool PollyVoiceCatalog::Save(const Snapshot& snapshot, std::string& error) const
+{
+	if (m_path.empty())
+	{
+		error = "No voice catalog path is configured";
+		return false;
+	}
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("version");
+	writer.Int(FormatVersion);
+	writer.Key("fetched");
+	writer.Uint64(static_cast<uint64_t>(snapshot.FetchedAt));
+	writer.Key("voices");
+	writer.StartArray();
+	for (auto& voice : snapshot.Voices)
+	{
+		writer.StartObject();
+		writer.Key("id");
+		writer.String(voice.Id.c_str());
+		writer.Key("languageCode");
+		writer.String(voice.LanguageCode.c_str());
+		writer.Key("languageName");
+		writer.String(voice.LanguageName.c_str());
+		writer.Key("lcid");
+		writer.Int(voice.Lcid);
+		writer.Key("gender");
+		writer.String(voice.Gender.c_str());
+		writer.Key("engines");
+		writer.StartArray();
+		for (auto& engine : voice.Engines)
+		{
+			writer.String(engine.c_str());
+		}
+		writer.EndArray();
+		writer.Key("sampleRates");
+		writer.StartArray();
+		for (int rate : voice.SampleRates)
+		{
+			writer.Int(rate);
+		}
+		writer.EndArray();
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	for (size_t i = 1; i < m_path.size(); i++)
+	{
+		if (m_path[i] == '\\' || m_path[i] == '/')
+		{
+#ifdef _WIN32
+			CreateDirectoryA(m_path.substr(0, i).c_str(), nullptr);
+#else
+			mkdir(m_path.substr(0, i).c_str(), 0755);
+#endif
+		}
+	}
+
+	// Written next to the catalog and renamed over it, so that a reader
+	// never sees half a file
+	std::string temporary = m_path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file.write(buffer.GetString(), buffer.GetSize()) || !file.flush())
+		{
+			error = "Unable to write " + temporary;
+			return false;
+		}
+	}
+#ifdef _WIN32
+	bool renamed = MoveFileExA(temporary.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = std::rename(temporary.c_str(), m_path.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		std::remove(temporary.c_str());
+		error = "Unable to replace " + m_path;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,74 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <aws/polly/PollyClient.h>
+#include "PollyVoiceInfo.h"
+
+// Snapshot of Polly's DescribeVoices answer, kept in VOICE_CATALOG
+// (voices.json next to the phrase store by default). The installer and the
+// engine both read it, so looking a voice up never calls Polly, and voices
+// that Polly adds later can be used without rebuilding the engine. The
+// snapshot is refreshed when it is older than VOICE_CATALOG_TTL_HOURS.
+class PollyVoiceCatalog
+{
+public:
+	// Version of the file layout; files of other versions are ignored
+	static const int FormatVersion = 1;
+
+	static PollyVoiceCatalog& Instance();
+
+	// Looks a voice up by id, ignoring case. If it is not found and the file
+	// changed since it was read, for example because the installer refreshed
+	// it, the file is read again.
+	bool Find(const std::string& id, PollyVoiceInfo& voice);
+	std::vector<PollyVoiceInfo> Voices() const;
+
+	bool IsLoaded() const;
+	// True when there is no snapshot or it is older than the TTL
+	bool IsStale() const;
+
+	// Calls DescribeVoices (every page), replaces the catalog and writes the
+	// file. The old catalog is kept if Polly cannot be reached.
+	bool Refresh(Aws::Polly::PollyClient& client, std::string& error);
+
+	const std::string& Path() const { return m_path; }
+
+	// Windows language id for a Polly language code, such as 0x0409 for "en-US"
+	static uint16_t Lcid(const std::string& languageCode);
+
+private:
+	struct Snapshot
+	{
+		int64_t FetchedAt = 0;  // Seconds since 1970
+		std::vector<PollyVoiceInfo> Voices;
+		std::unordered_map<std::string, size_t> ByLowerId;
+	};
+
+	PollyVoiceCatalog();
+	bool Load();
+	bool Save(const Snapshot& snapshot, std::string& error) const;
+	static void Index(Snapshot& snapshot);
+	int64_t FileTime() const;
+
+	mutable std::mutex m_lock;
+	std::shared_ptr<const Snapshot> m_snapshot;
+	std::string m_path;
+	int64_t m_ttlSeconds;
+	int64_t m_loadedFileTime;
+};
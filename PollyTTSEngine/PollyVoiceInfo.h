@@ -0,0 +1,28 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the voice catalog knows about one Polly voice.
+struct PollyVoiceInfo
+{
+	std::string Id;                    // "Joanna"
+	std::string LanguageCode;          // "en-US"
+	std::string LanguageName;          // "US English"
+	uint16_t Lcid = 0;                 // 0x0409
+	std::string Gender;                // "Female"
+	std::vector<std::string> Engines;  // "standard", "neural"
+	std::vector<int> SampleRates;      // PCM sample rates, in Hz
+};
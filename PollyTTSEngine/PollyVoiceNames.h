@@ -0,0 +1,234 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include "aws/polly/model/VoiceId.h"
+
+// Voices this engine was built with, looked up by name without regard to
+// case. The lookup table is a perfect hash that the compiler builds from
+// kVoices ("hash and displace": each bucket of names gets the hash seed
+// that sends its names to free slots), so it is read-only data and finding
+// a voice costs two hashes and one string compare. Voices that Polly added
+// later are found through PollyVoiceCatalog instead.
+namespace PollyVoiceNames
+{
+	using Aws::Polly::Model::VoiceId;
+
+	struct Entry
+	{
+		std::wstring_view Name;
+		VoiceId Id;
+	};
+
+	constexpr Entry kVoices[] = {
+		{ L"Aditi",        VoiceId::Aditi },
+		{ L"Amy",          VoiceId::Amy },
+		{ L"Astrid",       VoiceId::Astrid },
+		{ L"Brian",        VoiceId::Brian },
+		{ L"Carla",        VoiceId::Carla },
+		{ L"Carmen",       VoiceId::Carmen },
+		{ L"Celine",       VoiceId::Celine },
+		{ L"Chantal",      VoiceId::Chantal },
+		{ L"Conchita",     VoiceId::Conchita },
+		{ L"Cristiano",    VoiceId::Cristiano },
+		{ L"Dora",         VoiceId::Dora },
+		{ L"Emma",         VoiceId::Emma },
+		{ L"Enrique",      VoiceId::Enrique },
+		{ L"Ewa",          VoiceId::Ewa },
+		{ L"Filiz",        VoiceId::Filiz },
+		{ L"Geraint",      VoiceId::Geraint },
+		{ L"Giorgio",      VoiceId::Giorgio },
+		{ L"Gwyneth",      VoiceId::Gwyneth },
+		{ L"Hans",         VoiceId::Hans },
+		{ L"Ines",         VoiceId::Ines },
+		{ L"Ivy",          VoiceId::Ivy },
+		{ L"Jacek",        VoiceId::Jacek },
+		{ L"Jan",          VoiceId::Jan },
+		{ L"Joanna",       VoiceId::Joanna },
+		{ L"Joey",         VoiceId::Joey },
+		{ L"Justin",       VoiceId::Justin },
+		{ L"Karl",         VoiceId::Karl },
+		{ L"Kendra",       VoiceId::Kendra },
+		{ L"Kimberly",     VoiceId::Kimberly },
+		{ L"Liv",          VoiceId::Liv },
+		{ L"Lotte",        VoiceId::Lotte },
+		{ L"Mads",         VoiceId::Mads },
+		{ L"Maja",         VoiceId::Maja },
+		{ L"Marlene",      VoiceId::Marlene },
+		{ L"Mathieu",      VoiceId::Mathieu },
+		{ L"Matthew",      VoiceId::Matthew },
+		{ L"Maxim",        VoiceId::Maxim },
+		{ L"Miguel",       VoiceId::Miguel },
+		{ L"Mizuki",       VoiceId::Mizuki },
+		{ L"Naja",         VoiceId::Naja },
+		{ L"Nicole",       VoiceId::Nicole },
+		{ L"Penelope",     VoiceId::Penelope },
+		{ L"Raveena",      VoiceId::Raveena },
+		{ L"Ricardo",      VoiceId::Ricardo },
+		{ L"Ruben",        VoiceId::Ruben },
+		{ L"Russell",      VoiceId::Russell },
+		{ L"Salli",        VoiceId::Salli },
+		{ L"Seoyeon",      VoiceId::Seoyeon },
+		{ L"Takumi",       VoiceId::Takumi },
+		{ L"Tatyana",      VoiceId::Tatyana },
+		{ L"Vicki",        VoiceId::Vicki },
+		{ L"Vitoria",      VoiceId::Vitoria },
+		{ L"Zhiyu",        VoiceId::Zhiyu },
+	};
+
+	constexpr size_t kCount = std::size(kVoices);
+	constexpr size_t kSlots = 64;
+	constexpr size_t kBuckets = 32;
+	static_assert(kCount < kSlots, "Grow kSlots with the voice list");
+
+	constexpr wchar_t Lower(wchar_t c)
+	{
+		return c >= L'A' && c <= L'Z' ? static_cast<wchar_t>(c - L'A' + L'a') : c;
+	}
+
+	// FNV-1a over the lower-case name, finished with MurmurHash3's mixer so
+	// that every seed gives an unrelated hash
+	constexpr uint32_t Hash(std::wstring_view name, uint32_t seed)
+	{
+		uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+		for (wchar_t c : name)
+		{
+			hash = (hash ^ static_cast<uint32_t>(Lower(c))) * 16777619u;
+		}
+		hash ^= hash >> 16;
+		hash *= 0x85EBCA6Bu;
+		hash ^= hash >> 13;
+		hash *= 0xC2B2AE35u;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	constexpr bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (Lower(a[i]) != Lower(b[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct Table
+	{
+		uint32_t Seed[kBuckets];  // 0 for an empty bucket
+		int8_t Voice[kSlots];     // Index into kVoices, or -1
+	};
+
+	constexpr Table Build()
+	{
+		Table table{};
+		size_t bucketOf[kCount]{};
+		size_t bucketSize[kBuckets]{};
+		for (size_t slot = 0; slot < kSlots; slot++)
+		{
+			table.Voice[slot] = -1;
+		}
+		for (size_t i = 0; i < kCount; i++)
+		{
+			bucketOf[i] = Hash(kVoices[i].Name, 0) % kBuckets;
+			bucketSize[bucketOf[i]]++;
+		}
+		// Place the fullest buckets first, while most slots are free
+		for (size_t size = kCount; size > 0; size--)
+		{
+			for (size_t bucket = 0; bucket < kBuckets; bucket++)
+			{
+				if (bucketSize[bucket] != size)
+				{
+					continue;
+				}
+				for (uint32_t seed = 1;; seed++)
+				{
+					size_t slots[kCount]{};
+					size_t placed = 0;
+					bool fits = true;
+					for (size_t i = 0; i < kCount && fits; i++)
+					{
+						if (bucketOf[i] != bucket)
+						{
+							continue;
+						}
+						size_t slot = Hash(kVoices[i].Name, seed) % kSlots;
+						fits = table.Voice[slot] < 0;
+						for (size_t j = 0; j < placed && fits; j++)
+						{
+							fits = slots[j] != slot;
+						}
+						slots[placed++] = slot;
+					}
+					if (fits)
+					{
+						placed = 0;
+						for (size_t i = 0; i < kCount; i++)
+						{
+							if (bucketOf[i] == bucket)
+							{
+								table.Voice[slots[placed++]] = static_cast<int8_t>(i);
+							}
+						}
+						table.Seed[bucket] = seed;
+						break;
+					}
+				}
+			}
+		}
+		return table;
+	}
+
+	constexpr Table kTable = Build();
+
+	constexpr int IndexOf(std::wstring_view name)
+	{
+		uint32_t seed = kTable.Seed[Hash(name, 0) % kBuckets];
+		int index = seed == 0 ? -1 : kTable.Voice[Hash(name, seed) % kSlots];
+		return index >= 0 && EqualsIgnoreCase(kVoices[index].Name, name) ? index : -1;
+	}
+
+	constexpr bool FindsEveryVoice()
+	{
+		for (size_t i = 0; i < kCount; i++)
+		{
+			if (IndexOf(kVoices[i].Name) != static_cast<int>(i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	static_assert(FindsEveryVoice(), "Voice names must be unique without regard to case");
+
+	inline std::optional<VoiceId> Find(std::wstring_view name)
+	{
+		int index = IndexOf(name);
+		if (index < 0)
+		{
+			return std::nullopt;
+		}
+		return kVoices[index].Id;
+	}
+}
@@ -0,0 +1,125 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "PollyWarmup.h"
+#include "PollyConfig.h"
+#include "PollyCredentials.h"
+#include "PollyLog.h"
+#include "PollyRegions.h"
+#include "PollySdk.h"
+#include "PollyVoiceCatalog.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+std::atomic<bool> PollyWarmup::s_started(false);
+std::atomic<bool> PollyWarmup::s_warm(false);
+std::atomic<int64_t> PollyWarmup::s_lastActivityMs(0);
+
+void PollyWarmup::Start()
+{
+	if (s_started.exchange(true))
+	{
+		return;
+	}
+	if (!PollyConfig::GetBool("PREWARM", true))
+	{
+		s_warm.store(true);
+		return;
+	}
+	// Detached: the SDK is never shut down and the DLL stays pinned, so the
+	// thread can safely outlive every engine object
+	std::thread(&PollyWarmup::Run).detach();
+}
+
+bool PollyWarmup::IsWarm()
+{
+	return s_warm.load();
+}
+
+void PollyWarmup::NoteActivity()
+{
+	s_lastActivityMs.store(NowMs(), std::memory_order_relaxed);
+}
+
+int64_t PollyWarmup::NowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PollyWarmup::RefreshVoiceCatalog(PollyRegions& regions)
+{
+	auto& catalog = PollyVoiceCatalog::Instance();
+	if (!catalog.IsStale())
+	{
+		return;
+	}
+	std::string error = "no region is configured";
+	for (auto* region : regions.Ranked())
+	{
+		if (catalog.Refresh(*region->Client, error))
+		{
+			PollyLog::Get()->info("Refreshed the voice catalog {} from {}", catalog.Path(), region->Name);
+			return;
+		}
+	}
+	PollyLog::Get()->info("Voice catalog not refreshed: {}", error);
+}
+
+void PollyWarmup::Run()
+{
+	auto logger = PollyLog::Get();
+	auto start = std::chrono::steady_clock::now();
+	PollySdk::Initialize();
+	PollyCredentialsProvider::Instance()->GetAWSCredentials();
+	auto& regions = PollyRegions::Instance();
+	bool connected = regions.Probe();
+	NoteActivity();
+	s_warm.store(true);
+	logger->info("Pre-warm {} after {}ms", connected ? "connected" : "failed",
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	RefreshVoiceCatalog(regions);
+
+	// Keep-alive probes, and periodic probes that let a region that was
+	// failing earn its traffic back
+	const int64_t keepAliveMs = PollyConfig::GetLong("KEEPALIVE_MS", 0);
+	const int64_t probeMs = regions.Count() > 1 ? (std::max)(1000L, PollyConfig::GetLong("REGION_PROBE_MS", 30000)) : 0;
+	if (keepAliveMs <= 0 && probeMs <= 0)
+	{
+		return;
+	}
+	int64_t lastProbeMs = NowMs();
+	for (;;)
+	{
+		int64_t now = NowMs();
+		int64_t idleMs = now - s_lastActivityMs.load(std::memory_order_relaxed);
+		if ((keepAliveMs > 0 && idleMs >= keepAliveMs) || (probeMs > 0 && now - lastProbeMs >= probeMs))
+		{
+			POLLY_LOG_TRACE(logger, "Probing Polly regions, idle for {}ms", idleMs);
+			regions.Probe();
+			RefreshVoiceCatalog(regions);
+			NoteActivity();
+			lastProbeMs = now = NowMs();
+			idleMs = 0;
+		}
+		int64_t waitMs = INT64_MAX;
+		if (keepAliveMs > 0)
+		{
+			waitMs = keepAliveMs - idleMs;
+		}
+		if (probeMs > 0)
+		{
+			waitMs = (std::min)(waitMs, probeMs - (now - lastProbeMs));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds((std::max)(waitMs, int64_t(100))));
+	}
+}
@@ -0,0 +1,51 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+class PollyRegions;
+
+// Background pre-warming of the Polly connection. The first engine object
+// to get its token starts a thread that initializes the SDK, loads the
+// credentials and probes every Polly region, which leaves a resolved,
+// connected TLS session in each region client's pool.
+// Speak then finds each step done, or waits for the step in progress
+// instead of starting it again.
+//
+// With KEEPALIVE_MS set, the same thread probes again whenever the
+// connections have been idle that long, so hosts that speak rarely do not
+// pay for a new connection each time. With several regions it also probes
+// every REGION_PROBE_MS. After each probe the voice catalog is refreshed
+// if it is older than VOICE_CATALOG_TTL_HOURS.
+class PollyWarmup
+{
+public:
+	// Starts pre-warming. Only the first call in the process does anything.
+	static void Start();
+
+	// True once the pre-warm has finished, whether or not it succeeded.
+	static bool IsWarm();
+
+	// Records that the shared client was just used for a request.
+	static void NoteActivity();
+
+private:
+	static void Run();
+	static void RefreshVoiceCatalog(PollyRegions& regions);
+	static int64_t NowMs();
+
+	static std::atomic<bool> s_started;
+	static std::atomic<bool> s_warm;
+	static std::atomic<int64_t> s_lastActivityMs;
+};
@@ -10,7 +10,6 @@ on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
 or implied.See the License for the specific language governing
 permissions and limitations under the License. */
 
-#include "stdafx.h"
 #include "SpeechMark.h"
 
 
@@ -18,12 +18,20 @@ permissions and limitations under the License. */
 #include <aws/core/Aws.h>
 #include <aws/polly/PollyClient.h>
 #include <aws/polly/model/DescribeVoicesRequest.h>
+#include "PollyJitterBuffer.h"
 #include "PollyManager.h"
+#include "PollyMetrics.h"
+#include "PollyTrace.h"
+#include "PollySdk.h"
+#include "PollySpeechStream.h"
+#include "PollyWarmup.h"
 #include "spdlog/spdlog.h"
 #include "tinyxml2.h"
 #include <aws/core/platform/Environment.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>tiny
 #include <boost/algorithm/string.hpp>
+#include <future>
+#include <string_view>
 
 //--- Local
 using namespace Aws::Polly;
@@ -31,6 +39,45 @@ using namespace Model;
 using namespace Aws::Utils;
 using namespace tinyxml2;
 
+namespace
+{
+	// Output formats the engine renders itself, so SAPI converts nothing.
+	// The first is the default.
+	struct EngineFormat
+	{
+		SPSTREAMFORMAT StreamFormat;
+		PollyAudioFormat AudioFormat;
+		WORD FormatTag;
+		DWORD SamplesPerSec;
+		WORD BitsPerSample;
+	};
+
+	const EngineFormat g_engineFormats[] = {
+		{ SPSF_16kHz16BitMono, PollyAudioFormat::Pcm16k, WAVE_FORMAT_PCM, 16000, 16 },
+		{ SPSF_8kHz16BitMono, PollyAudioFormat::Pcm8k, WAVE_FORMAT_PCM, 8000, 16 },
+		{ SPSF_CCITT_uLaw_8kHzMono, PollyAudioFormat::MuLaw8k, WAVE_FORMAT_MULAW, 8000, 8 },
+		{ SPSF_CCITT_ALaw_8kHzMono, PollyAudioFormat::ALaw8k, WAVE_FORMAT_ALAW, 8000, 8 },
+	};
+
+	const EngineFormat& FindEngineFormat(const GUID* pFormatId, const WAVEFORMATEX* pWaveFormatEx)
+	{
+		if (pFormatId != NULL && *pFormatId == SPDFID_WaveFormatEx && pWaveFormatEx != NULL &&
+			pWaveFormatEx->nChannels == 1)
+		{
+			for (auto& format : g_engineFormats)
+			{
+				if (pWaveFormatEx->wFormatTag == format.FormatTag &&
+					pWaveFormatEx->nSamplesPerSec == format.SamplesPerSec &&
+					pWaveFormatEx->wBitsPerSample == format.BitsPerSample)
+				{
+					return format;
+				}
+			}
+		}
+		return g_engineFormats[0];
+	}
+}
+
 TCHAR* CTTSEngObj::GetPath()
 {
 	TCHAR buf[MAX_PATH];
@@ -47,18 +94,14 @@ TCHAR* CTTSEngObj::GetPath()
 *****************************************************************************/
 HRESULT CTTSEngObj::FinalConstruct()
 {
-	auto temp_folder = GetPath();
-	char logPath[MAX_PATH];
-	sprintf_s(logPath, MAX_PATH, "%lspolly-tts.log", temp_folder);
-	m_logger = std::make_shared<spdlog::logger>("msvc_logger", std::make_shared<spdlog::sinks::msvc_sink_mt>());
-	m_logger->set_level(spdlog::level::debug);
-
-	spdlog::set_pattern("[%H:%M:%S %z] %v");
-#ifdef DEBUG
-	spdlog::set_level(spdlog::level::debug); //Set global log level to info
-#endif
+	m_logger = PollyLog::Get();
 	HRESULT hr = S_OK;
 	wcscpy(m_voiceOveride, L"");
+	m_pPollyVoice = NULL;
+	m_bSpoken = false;
+	m_audioFormat = PollyAudioFormat::Pcm16k;
+	PollyMetrics::StartExporter();
+	PollyTrace::Initialize();
 
     return hr;
 } /* CTTSEngObj::FinalConstruct */
@@ -71,6 +114,10 @@ HRESULT CTTSEngObj::FinalConstruct()
 *****************************************************************************/
 void CTTSEngObj::FinalRelease()
 {
+	if (m_pPollyVoice != m_voiceOveride)
+	{
+		::CoTaskMemFree(m_pPollyVoice);
+	}
 } /* CTTSEngObj::FinalRelease */
 
 //
@@ -82,16 +129,25 @@ void CTTSEngObj::FinalRelease()
 *----------------------------*
 *   Description:
 *       This function performs the majority of the initialization of the voice.
-*   Once the object token has been provided, the filenames are read from the
-*   token key and the files are mapped.
+*   Once the object token has been provided, the Polly voice is read from the
+*   token attributes and the Polly connection is pre-warmed in the background.
 *****************************************************************************/
 STDMETHODIMP CTTSEngObj::SetObjectToken(ISpObjectToken * pToken)
 {
-	m_logger->info("SetObjectToken");
 	HRESULT hr;
-	m_logger->info("Setting object token");
+	POLLY_LOG_DEBUG(m_logger, "Setting object token");
 	hr = SpGenericSetObjectToken(pToken, m_cpToken);
-	m_logger->info("SpGenericSetObjectToken Response: {0}" , hr);
+	POLLY_LOG_DEBUG(m_logger, "SpGenericSetObjectToken Response: {0}" , hr);
+	if (SUCCEEDED(hr))
+	{
+		// Read here, on the caller's thread, because the token belongs to its apartment
+		CComPtr<ISpDataKey> attributesKey;
+		if (SUCCEEDED(m_cpToken->OpenKey(L"Attributes", &attributesKey)))
+		{
+			attributesKey->GetStringValue(L"VoiceId", &m_pPollyVoice);
+		}
+		PollyWarmup::Start();
+	}
 	return hr;
 } /* CTTSEngObj::SetObjectToken */
 
@@ -140,19 +196,48 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
                                 const SPVTEXTFRAG* pTextFragList,
                                 ISpTTSEngineSite* pOutputSite )
 {
-	Aws::SDKOptions options;
-	m_logger->debug("Starting Speak\n");
+	if (PollyTrace::IsEnabled())
+	{
+		PollyTrace::BeginRequest();
+	}
+	bool firstSpeak = !m_bSpoken;
+	m_bSpoken = true;
+	PollyStage firstSpeakStage = PollyWarmup::IsWarm() ? PollyStage::FirstSpeakWarm : PollyStage::FirstSpeakCold;
+	auto speakStart = std::chrono::steady_clock::now();
+	HRESULT hr = SpeakTraced(dwSpeakFlags, rguidFormatId, pWaveFormatEx, pTextFragList, pOutputSite);
+	if (firstSpeak)
+	{
+		PollyMetrics::RecordLatency(firstSpeakStage, std::chrono::steady_clock::now() - speakStart);
+	}
+	PollyTrace::Flush();
+	return hr;
+} /* CTTSEngObj::Speak */
 
-	if (wcslen(m_voiceOveride) == 0)
+/*****************************************************************************
+* CTTSEngObj::SpeakTraced *
+*-------------------------*
+*   Description:
+*       Body of Speak, wrapped in a trace span for the request.
+*****************************************************************************/
+HRESULT CTTSEngObj::SpeakTraced( DWORD dwSpeakFlags,
+                                 REFGUID rguidFormatId,
+                                 const WAVEFORMATEX * pWaveFormatEx,
+                                 const SPVTEXTFRAG* pTextFragList,
+                                 ISpTTSEngineSite* pOutputSite )
+{
+	ScopedTraceSpan span("Speak");
+	POLLY_LOG_DEBUG(m_logger, "Starting Speak\n");
+
+	if (wcslen(m_voiceOveride) == 0 && m_pPollyVoice == NULL)
 	{
 		CComPtr<ISpDataKey> attributesKey;
-		m_logger->debug("Reading attributes key to get the voice\n");
+		POLLY_LOG_DEBUG(m_logger, "Reading attributes key to get the voice\n");
 		m_cpToken->OpenKey(L"Attributes", &attributesKey);
 		attributesKey->GetStringValue(L"VoiceId", &m_pPollyVoice);
 	}
-	m_logger->debug("Initializing AWS\n");
-	InitAPI(options);
+	PollySdk::Initialize();
 	HRESULT hr = S_OK;
+	m_audioFormat = FindEngineFormat(&rguidFormatId, pWaveFormatEx).AudioFormat;
 
 	//--- Check args
     if( SP_IS_BAD_INTERFACE_PTR( pOutputSite ) ||
@@ -170,13 +255,13 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
 
         CItemList ItemList;
 
-		m_logger->debug("Starting work processing\n");
+		POLLY_LOG_DEBUG(m_logger, "Starting work processing\n");
 		while( SUCCEEDED( hr ) && !(pOutputSite->GetActions() & SPVES_ABORT) )
         {
             //--- Do skip?
             if( pOutputSite->GetActions() & SPVES_SKIP )
             {
-				m_logger->debug("ACTION: SKIP\n");
+				POLLY_LOG_DEBUG(m_logger, "ACTION: SKIP\n");
 				long lSkipCnt;
                 SPVSKIPTYPE eType;
                 hr = pOutputSite->GetSkipInfo( &eType, &lSkipCnt );
@@ -189,11 +274,13 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
             }
 			
             //--- Build the text item list
+            ScopedStageTimer tokenizeTimer(PollyStage::Tokenize);
             if( SUCCEEDED( hr ) && (hr = GetNextSentence( ItemList )) != S_OK )
             {
-				m_logger->debug("ERROR Getting the next sentence from ItemList\n");
+				POLLY_LOG_DEBUG(m_logger, "ERROR Getting the next sentence from ItemList\n");
 				break;
             }
+            tokenizeTimer.Stop();
 			
             //--- We aren't going to do any part of speech determination,
             //    prosody, or pronunciation determination. If you were, one thing
@@ -215,7 +302,9 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
                 Event.wParam               = (WPARAM)LastItem.ulItemSrcOffset +
                                                      LastItem.ulItemSrcLen -
                                                      FirstItem.ulItemSrcOffset;
+				ScopedStageTimer eventsTimer(PollyStage::SapiEvents);
 				hr = pOutputSite->AddEvents( &Event, 1 );
+				eventsTimer.Stop();
 
                 //--- Output
                 if( SUCCEEDED( hr ) )
@@ -233,7 +322,7 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
         }
     }
     return hr;
-} /* CTTSEngObj::Speak */
+} /* CTTSEngObj::SpeakTraced */
 
 /*****************************************************************************
 * CTTSEngObj::OutputSentence *
@@ -242,14 +331,22 @@ STDMETHODIMP CTTSEngObj::Speak( DWORD dwSpeakFlags,
 ****************************************************************************/
 HRESULT CTTSEngObj::OutputSentence( CItemList& ItemList, ISpTTSEngineSite* pOutputSite )
 {
-    HRESULT hr = S_OK;
+	ScopedTraceSpan span("OutputSentence");
 //    ULONG WordIndex;
-	m_logger->debug(__FUNCTION__);
+	POLLY_LOG_DEBUG(m_logger, "{}", __FUNCTION__);
 
     //--- Lookup words in our voice
     SPLISTPOS ListPos = ItemList.GetHeadPosition();
 	CSentItem& Item = ItemList.GetNext(ListPos);
+
+	// Plain text is spoken a chunk at a time so memory use does not grow
+	// with the document; markup still goes to Polly in one request
+	if (wcschr(Item.pItem, L'<') == NULL)
+	{
+		return OutputStream(Item, pOutputSite);
+	}
 	DescribeVoicesRequest request;
+	ScopedStageTimer ssmlTimer(PollyStage::SsmlPreprocess);
 	auto speech = StringUtils::FromWString(Item.pItem);
 
 	boost::trim(speech);
@@ -269,124 +366,235 @@ HRESULT CTTSEngObj::OutputSentence( CItemList& ItemList, ISpTTSEngineSite* pOutp
 	{
 		return S_OK;
 	}
-
-	ListPos = ItemList.GetHeadPosition();
-	PollyManager pm = PollyManager(m_pPollyVoice);
-	auto resp = pm.GenerateSpeech(Item);
+	ssmlTimer.Stop();
+
+	PollyManager pm = PollyManager(m_pPollyVoice, m_audioFormat);
+	auto text = StringUtils::FromWString(Item.pItem);
+	// Long-form audio is written as it downloads, so playback starts at once
+	bool buffered = PollyJitterBuffer::IsEnabled() && PollyManager::IsLongForm(text);
+	auto resp = buffered ? GenerateBuffered(pm, text, pOutputSite) :
+		pm.GenerateSpeech(text, [&](const char* data, size_t size) {
+			if (pOutputSite->GetActions() & SPVES_ABORT)
+			{
+				return false;
+			}
+			ScopedStageTimer writeTimer(PollyStage::SapiWrite);
+			return SUCCEEDED(pOutputSite->Write(data, static_cast<ULONG>(size), NULL));
+		});
 	if (!resp.IsSuccess)
 	{
-		std::stringstream message;
-		message << "Error generating speech:\n\n" << resp.ErrorMessage;
-		MessageBoxA(NULL, message.str().c_str(), "Error", MB_OK);
-		return FAILED(ERROR_SUCCESS);
+		// Never block the host application with UI from inside Speak
+		m_logger->error("Error generating speech: {}", resp.ErrorMessage);
+		return E_FAIL;
 	}
-	PollySpeechMarksResponse generateSpeechMarksResp = pm.GenerateSpeechMarks(Item, resp.Length);
-	
-	hr = pOutputSite->Write(reinterpret_cast<char*>(&resp.AudioData[0]), resp.Length, NULL);
+	if (resp.Streamed)
+	{
+		return S_OK;
+	}
+	// The speech marks cost a second request unless they are cached, so
+	// they are only fetched for an application that wants word boundaries
+	ULONGLONG interest = 0;
+	if (SUCCEEDED(pOutputSite->GetEventInterest(&interest)) && (interest & SPFEI(SPEI_WORD_BOUNDARY)))
+	{
+		auto marks = pm.GenerateSpeechMarks(text, resp.Length);
+		if (marks.ErrorMessage.empty())
+		{
+			AddWordBoundaries(Item, marks.SpeechMarks, pOutputSite);
+		}
+		else
+		{
+			m_logger->warn("Speaking without word boundaries: {}", marks.ErrorMessage);
+		}
+	}
+	ScopedStageTimer writeTimer(PollyStage::SapiWrite);
+	HRESULT hr = pOutputSite->Write(resp.AudioData->data(), static_cast<ULONG>(resp.Length), NULL);
+	m_ullAudioOff += resp.Length;
 	return hr;
-	auto i = generateSpeechMarksResp.SpeechMarks.begin();
-	auto wordOffset = 0;
-    while(ListPos && i != generateSpeechMarksResp.SpeechMarks.end() && !(pOutputSite->GetActions() & SPVES_ABORT) )
-    {
-		SpeechMark sm = *i;
-        CSentItem& Item = ItemList.GetNext( ListPos );
-		m_logger->debug("ListPos={}, current word={}", ListPos, sm.Text);
-
+} /* CTTSEngObj::OutputSentence */
 
-        //--- Process sentence items
-		switch( Item.pXmlState->eAction )
-        {
-          //--- Speak some text ---------------------------------------
-          case SPVA_Speak:
-          {
-            if( iswalpha( Item.pItem[0] ) || iswdigit( Item.pItem[0] ) )
-            {
-				//--- Queue the event
-                CSpEvent Event;
-                Event.eEventId             = SPEI_WORD_BOUNDARY;
-                Event.elParamType          = SPET_LPARAM_IS_UNDEFINED;
-                Event.ullAudioStreamOffset = wordOffset;
-				Event.lParam               = Item.ulItemSrcOffset,
-                Event.wParam               = sm.Text.length();
-				m_logger->debug("Writing word boundary for '{}', offset={}, length={}", sm.Text, Item.ulItemSrcOffset, sm.Text.length());
-                pOutputSite->AddEvents( &Event, 1 );
-
-				std::vector<unsigned char> word = std::vector<unsigned char>(&resp.AudioData[wordOffset], &resp.AudioData[wordOffset + sm.LengthInBytes]);
-				hr = pOutputSite->Write(reinterpret_cast<char*>(&word[0]), sm.LengthInBytes, NULL);
-				++i;
-				m_ullAudioOff += sm.LengthInBytes;
-				wordOffset += sm.LengthInBytes;
-			}
-          }
-          break;
-
-          //--- Output some silence for a pause -----------------------
-          case SPVA_Silence:
-          {
-            BYTE Buff[1000];
-            memset( Buff, 0, 1000 );
-            ULONG NumSilenceBytes = Item.pXmlState->SilenceMSecs * 22;
-
-            //--- Queue the audio data in chunks so that we can get
-            //    interrupted if necessary.
-            while( !(pOutputSite->GetActions() & SPVES_ABORT) )
-            {
-                if( NumSilenceBytes > 1000 )
-                {
-                    hr = pOutputSite->Write( Buff, 1000, NULL );
-                    NumSilenceBytes -= 1000;
-                }
-                else
-                {
-                    hr = pOutputSite->Write( Buff, NumSilenceBytes, NULL );
-                    break;
-                }
-            }
+/*****************************************************************************
+* CTTSEngObj::AddWordBoundaries *
+*-------------------------------*
+*   Queues a word boundary event for each speech mark whose word is found
+*   in the text of Item, outside its tags, at the audio offset where Polly
+*   says the word starts. SAPI fires the events as that audio plays.
+****************************************************************************/
+void CTTSEngObj::AddWordBoundaries( const CSentItem& Item, const std::vector<SpeechMark>& marks, ISpTTSEngineSite* pOutputSite )
+{
+	const size_t npos = std::wstring_view::npos;
+	std::wstring_view source(Item.pItem);
+	// A match inside a tag is markup, not the spoken word
+	auto insideTag = [&](size_t pos) {
+		size_t open = source.rfind(L'<', pos);
+		size_t close = source.rfind(L'>', pos);
+		return open != npos && (close == npos || close < open);
+	};
+	size_t searchFrom = 0;
+	for (const auto& mark : marks)
+	{
+		auto word = StringUtils::ToWString(mark.Text.c_str());
+		size_t pos = source.find(word.c_str(), searchFrom, word.length());
+		while (pos != npos && insideTag(pos))
+		{
+			pos = source.find(word.c_str(), source.find(L'>', pos), word.length());
+		}
+		if (word.empty() || pos == npos)
+		{
+			POLLY_LOG_TRACE(m_logger, "No word boundary for '{}'", mark.Text);
+			continue;
+		}
+		searchFrom = pos + word.length();
+
+		CSpEvent Event;
+		Event.eEventId             = SPEI_WORD_BOUNDARY;
+		Event.elParamType          = SPET_LPARAM_IS_UNDEFINED;
+		Event.ullAudioStreamOffset = m_ullAudioOff +
+			static_cast<ULONGLONG>((std::max)(0, mark.StartInMs)) * PollyAudio::BytesPerMs(m_audioFormat);
+		Event.lParam               = (LPARAM)(Item.ulItemSrcOffset + pos);
+		Event.wParam               = (WPARAM)word.length();
+		POLLY_LOG_TRACE(m_logger, "Word boundary for '{}', offset={}, length={}", mark.Text, Item.ulItemSrcOffset + pos,
+			word.length());
+		ScopedStageTimer eventsTimer(PollyStage::SapiEvents);
+		pOutputSite->AddEvents( &Event, 1 );
+	}
+} /* CTTSEngObj::AddWordBoundaries */
 
-            //--- Update the audio offset
-            m_ullAudioOff += NumSilenceBytes;
-          }
-          break;
-
-          //--- Fire a bookmark event ---------------------------------
-          case SPVA_Bookmark:
-          {
-            //--- The bookmark is NOT a null terminated string in the Item, but we need
-            //--- to convert it to one.  Allocate enough space for the string.
-            WCHAR * pszBookmark = (WCHAR *)_malloca((Item.ulItemLen + 1) * sizeof(WCHAR));
-            memcpy(pszBookmark, Item.pItem, Item.ulItemLen * sizeof(WCHAR));
-            pszBookmark[Item.ulItemLen] = 0;
-            //--- Queue the event
-            SPEVENT Event;
-            Event.eEventId             = SPEI_TTS_BOOKMARK;
-            Event.elParamType          = SPET_LPARAM_IS_STRING;
-            Event.ullAudioStreamOffset = m_ullAudioOff;
-            Event.lParam               = (LPARAM)pszBookmark;
-            Event.wParam               = _wtol(pszBookmark);
-            hr = pOutputSite->AddEvents( &Event, 1 );
-            //--- Free the space for the string.
-            _freea(pszBookmark);
-          }
-          break;
-
-          case SPVA_Pronounce:
-            //--- Our sample engine doesn't handle this. If it
-            //    did, you would use the associated pronunciation in
-            //    the XmlState structure instead of the lexicon.
-            break;
+/*****************************************************************************
+* CTTSEngObj::GenerateBuffered *
+*------------------------------*
+*   Downloads long-form speech on a worker thread while this thread
+*   writes it through a playout buffer, so a chunk that arrives late from
+*   the network does not stall SAPI in the middle of a word.
+****************************************************************************/
+PollySpeechResponse CTTSEngObj::GenerateBuffered( PollyManager& pm, const std::string& text, ISpTTSEngineSite* pOutputSite )
+{
+	PollyJitterBuffer buffer(PollyAudio::BytesPerMs(m_audioFormat));
+	auto requestId = PollyTrace::CurrentRequestId();
+	auto generating = std::async(std::launch::async, [&pm, &text, &buffer, requestId]() {
+		PollyTrace::SetCurrentRequestId(requestId);
+		PollySpeechResponse resp;
+		// The buffer is closed on every path, or Pop below waits for it forever
+		try
+		{
+			resp = pm.GenerateSpeech(text, [&buffer](const char* data, size_t size) {
+				return buffer.Push(data, size);
+			});
+		}
+		catch (const std::exception& e)
+		{
+			resp = PollySpeechResponse();
+			resp.ErrorMessage = std::string("Error generating speech: ") + e.what();
+		}
+		catch (...)
+		{
+			resp = PollySpeechResponse();
+			resp.ErrorMessage = "Error generating speech: unknown exception";
+		}
+		buffer.Close();
+		return resp;
+	});
+
+	std::string frame;
+	while (buffer.Pop(frame))
+	{
+		if (pOutputSite->GetActions() & SPVES_ABORT)
+		{
+			buffer.Cancel();
+			break;
+		}
+		ScopedStageTimer writeTimer(PollyStage::SapiWrite);
+		if (FAILED(pOutputSite->Write(frame.data(), static_cast<ULONG>(frame.size()), NULL)))
+		{
+			buffer.Cancel();
+			break;
+		}
+	}
+	auto resp = generating.get();
+	if (resp.Streamed)
+	{
+		auto stats = buffer.GetStats();
+		PollyMetrics::Increment(PollyCounter::PlayoutUnderruns, pm.GetVoiceId(), stats.Underruns);
+		PollyMetrics::Increment(PollyCounter::PlayoutOverruns, pm.GetVoiceId(), stats.Overruns);
+		PollyMetrics::RecordLatency(PollyStage::PlayoutDepth, std::chrono::milliseconds(stats.MeanDepthMs));
+		POLLY_LOG_DEBUG(m_logger, "Playout: {} underruns, {} ms starved, {} overruns, target {} ms, mean depth {} ms",
+			stats.Underruns, stats.StarvedMs, stats.Overruns, stats.TargetMs, stats.MeanDepthMs);
+	}
+	return resp;
+} /* CTTSEngObj::GenerateBuffered */
 
-          case SPVA_ParseUnknownTag:
-            //--- This will reference an XML tag that is unknown to SAPI
-            //    if your engine has private tags to control state, you
-            //    would examine these tags and see if you recognize it. This
-            //    would also be the point that you would make the rendering
-            //    state change.
-            break;
-        }
-    }
+/*****************************************************************************
+* CTTSEngObj::OutputStream *
+*--------------------------*
+*   Speaks plain text from Item to the end of the input in chunks. Only
+*   STREAM_WINDOW chunks are pending at a time, and each chunk's audio is
+*   released once SAPI has taken it, so memory use is independent of the
+*   document length.
+****************************************************************************/
+HRESULT CTTSEngObj::OutputStream( const CSentItem& Item, ISpTTSEngineSite* pOutputSite )
+{
+	static const size_t WriteBytes = 64 * 1024;
+	ScopedTraceSpan span("OutputStream");
+	POLLY_LOG_DEBUG(m_logger, "{}", __FUNCTION__);
+
+	std::wstring voice = m_pPollyVoice;
+	PollyAudioFormat format = m_audioFormat;
+	PollySpeechStream stream([voice, format](std::string text) -> PollyTask<PollySpeechResponse> {
+		PollyManager pm = PollyManager(voice, format);
+		co_return co_await pm.GenerateSpeechAsync(std::move(text));
+	});
+
+	// SAPI is only called from this thread, which runs the output steps
+	// while the chunks are synthesized on the executor
+	PollyCallerLoop speakThread;
+	HRESULT hr = S_OK;
+	std::string error;
+	bool succeeded = speakThread.Run(stream.Run(Item.pItem, wcslen(Item.pItem),
+		[&](const PollySpeechResponse& audio, const wchar_t* pChunk, size_t chunkLength) -> PollyTask<bool> {
+		co_await speakThread.Schedule();
+		if (pOutputSite->GetActions() & SPVES_ABORT)
+		{
+			co_return false;
+		}
+		// SpeakTraced already announced the sentence the first chunk starts with
+		if (pChunk != Item.pItem)
+		{
+			CSpEvent Event;
+			Event.eEventId             = SPEI_SENTENCE_BOUNDARY;
+			Event.elParamType          = SPET_LPARAM_IS_UNDEFINED;
+			Event.ullAudioStreamOffset = m_ullAudioOff;
+			Event.lParam               = (LPARAM)(Item.ulItemSrcOffset + (pChunk - Item.pItem));
+			Event.wParam               = (WPARAM)chunkLength;
+			ScopedStageTimer eventsTimer(PollyStage::SapiEvents);
+			pOutputSite->AddEvents( &Event, 1 );
+		}
+
+		// Write in pieces so an abort is noticed within one piece of audio
+		ScopedStageTimer writeTimer(PollyStage::SapiWrite);
+		const char* data = audio.AudioData ? audio.AudioData->data() : NULL;
+		size_t length = data ? static_cast<size_t>(audio.Length) : 0;
+		for (size_t offset = 0; offset < length; offset += WriteBytes)
+		{
+			if (offset > 0 && (pOutputSite->GetActions() & SPVES_ABORT))
+			{
+				co_return false;
+			}
+			hr = pOutputSite->Write(data + offset, static_cast<ULONG>((std::min)(WriteBytes, length - offset)), NULL);
+			if (FAILED(hr))
+			{
+				co_return false;
+			}
+		}
+		m_ullAudioOff += length;
+		co_return true;
+	}, error));
 
-    return hr;
-} /* CTTSEngObj::OutputSentence */
+	if (!succeeded)
+	{
+		m_logger->error("Error generating speech: {}", error);
+		return E_FAIL;
+	}
+	return hr;
+} /* CTTSEngObj::OutputStream */
 
 /*****************************************************************************
 * CTTSEngObj::GetVoiceFormat *
@@ -394,7 +602,9 @@ HRESULT CTTSEngObj::OutputSentence( CItemList& ItemList, ISpTTSEngineSite* pOutp
 *   Description:
 *       This method returns the output data format associated with the
 *   specified format Index. Formats are in order of quality with the best
-*   starting at 0.
+*   starting at 0. A target the engine renders itself, such as 8 kHz
+*   G.711 for telephony, is returned as it is; anything else gets 16 kHz
+*   PCM for SAPI to convert.
 *****************************************************************************/
 STDMETHODIMP CTTSEngObj::GetOutputFormat( const GUID * pTargetFormatId, const WAVEFORMATEX * pTargetWaveFormatEx,
                                           GUID * pDesiredFormatId, WAVEFORMATEX ** ppCoMemDesiredWaveFormatEx )
@@ -402,9 +612,9 @@ STDMETHODIMP CTTSEngObj::GetOutputFormat( const GUID * pTargetFormatId, const WA
 
     HRESULT hr = S_OK;
 
-    hr = SpConvertStreamFormatEnum(SPSF_16kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
+    hr = SpConvertStreamFormatEnum(FindEngineFormat(pTargetFormatId, pTargetWaveFormatEx).StreamFormat,
+        pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
 
-	m_logger->debug("End Speak");
 	return hr;
 } /* CTTSEngObj::GetVoiceFormat */
 
@@ -419,15 +629,16 @@ STDMETHODIMP CTTSEngObj::GetOutputFormat( const GUID * pTargetFormatId, const WA
 HRESULT CTTSEngObj::GetNextSentence( CItemList& ItemList )
 {
     HRESULT hr = S_OK;
-	m_logger->debug(__FUNCTION__);
-	m_logger->debug("Clearing the item list\n");
+	ScopedTraceSpan span("GetNextSentence");
+	POLLY_LOG_DEBUG(m_logger, "{}", __FUNCTION__);
+	POLLY_LOG_DEBUG(m_logger, "Clearing the item list\n");
 	//--- Clear all items in the list
     ItemList.RemoveAll();
 
     //--- Is there any work to do
     if( m_pCurrFrag == NULL )
     {
-		m_logger->debug("CurrFrag is null, nothing to do");
+		POLLY_LOG_DEBUG(m_logger, "CurrFrag is null, nothing to do");
 		hr = S_FALSE;
     }
     else
@@ -565,7 +776,6 @@ BOOL CTTSEngObj::AddNextSentenceItem( CItemList& ItemList )
     ULONG ulIndex;
     CSentItem Item;
     Item.pItem = FindNextToken( m_pNextChar, m_pEndChar, m_pNextChar );
-	m_logger->debug("Next token: {}", (char *)Item.pItem);
 
     //--- This case can occur when we hit the end of a text fragment.
     //    Returning at this point will cause advancement to the next fragment.
@@ -576,6 +786,7 @@ BOOL CTTSEngObj::AddNextSentenceItem( CItemList& ItemList )
 
     const WCHAR* pTrailChar = m_pNextChar-1;
     ULONG TokenLen = (ULONG)(m_pNextChar - Item.pItem);
+	POLLY_LOG_TRACE(m_logger, "Next token: {}", StringUtils::FromWString(std::wstring(Item.pItem, TokenLen).c_str()));
 
     //--- Split off leading punction if any
     static const WCHAR LeadItems[] = { L'(', L'\"', L'{', L'\'', L'[' };
@@ -612,7 +823,6 @@ BOOL CTTSEngObj::AddNextSentenceItem( CItemList& ItemList )
         BOOL fAddTrailItem = false;
         if( SearchSet( *pTrailChar, EOSItems, sp_countof(EOSItems), &ulIndex ) )
         {
-		m_logger->debug("Next token: {}", (char *)Item.pItem);
             fIsEOS = true;
             fAddTrailItem = true;
         }
@@ -627,7 +837,7 @@ BOOL CTTSEngObj::AddNextSentenceItem( CItemList& ItemList )
 			newstr[0] = *pTrailChar;
 			newstr[1] = 0;
 
-			m_logger->debug("Found trailing token: {}", (char)newstr);
+			POLLY_LOG_TRACE(m_logger, "Found trailing token: {}", StringUtils::FromWString(newstr));
 			CSentItem TItem;
 			TItem.pItem			  = newstr;
             TItem.ulItemLen       = 1;
@@ -36,8 +36,13 @@ permissions and limitations under the License. */
 
 #include "resource.h"
 #include <string>
-#include "spdlog/spdlog.h"
-#include "spdlog/sinks/msvc_sink.h"
+#include <vector>
+#include "PollyLog.h"
+#include "PollyAudioFormat.h"
+
+class PollyManager;
+class PollySpeechResponse;
+class SpeechMark;
 namespace spd = spdlog;
 
 //=== Constants ====================================================
@@ -112,9 +117,15 @@ class ATL_NO_VTABLE CTTSEngObj :
   private:
     /*--- Non interface methods ---*/
     HRESULT MapFile(const WCHAR * pszTokenValName, HANDLE * phMapping, void ** ppvData );
+    HRESULT SpeakTraced( DWORD dwSpeakFlags,
+                         REFGUID rguidFormatId, const WAVEFORMATEX * pWaveFormatEx,
+                         const SPVTEXTFRAG* pTextFragList, ISpTTSEngineSite* pOutputSite );
     HRESULT GetNextSentence( CItemList& ItemList );
     BOOL    AddNextSentenceItem( CItemList& ItemList );
     HRESULT OutputSentence( CItemList& ItemList, ISpTTSEngineSite* pOutputSite );
+    HRESULT OutputStream( const CSentItem& Item, ISpTTSEngineSite* pOutputSite );
+    PollySpeechResponse GenerateBuffered( PollyManager& pm, const std::string& text, ISpTTSEngineSite* pOutputSite );
+    void AddWordBoundaries( const CSentItem& Item, const std::vector<SpeechMark>& marks, ISpTTSEngineSite* pOutputSite );
 
   /*=== Member Data ===*/
   private:
@@ -123,6 +134,9 @@ class ATL_NO_VTABLE CTTSEngObj :
     void*                   m_pVoiceData;
 	LPWSTR      			m_pPollyVoice;
 	wchar_t                 m_voiceOveride[100];
+	bool                    m_bSpoken;
+	// Format SAPI asked Speak to render in
+	PollyAudioFormat        m_audioFormat;
 	std::shared_ptr<spdlog::logger> m_logger;
 
 
@@ -0,0 +1,155 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* AdpcmBench.cpp:
+**   Compares cache entries stored as 16 kHz PCM and as IMA-ADPCM: entries
+**   per MB, signal-to-noise ratio, decode throughput with and without SSE2,
+**   and how soon a streamed decode hands SAPI its first piece.
+******************************************************************************/
+#include "PollyAdpcm.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// 16 kHz, 16-bit little-endian PCM that sounds roughly like speech: a few
+// drifting harmonics under a syllable-rate envelope, with some noise
+static std::string SyntheticSpeech(double seconds, unsigned seed)
+{
+	const int rate = 16000;
+	size_t samples = static_cast<size_t>(seconds * rate);
+	std::mt19937 random(seed);
+	std::normal_distribution<double> noise(0, 300);
+	std::string pcm(2 * samples, '\0');
+	const double pi = 3.14159265358979;
+	double basePitch = 100 + random() % 120;
+	for (size_t i = 0; i < samples; i++)
+	{
+		double t = static_cast<double>(i) / rate;
+		double pitch = basePitch + 30 * std::sin(2 * pi * 0.7 * t);
+		double envelope = 0.5 + 0.5 * std::sin(2 * pi * 4 * t);
+		double value = 0;
+		for (int harmonic = 1; harmonic <= 6; harmonic++)
+		{
+			value += std::sin(2 * pi * pitch * harmonic * t) * 6000 / harmonic;
+		}
+		value = value * envelope + noise(random);
+		int sample = static_cast<int>(std::max(-32768.0, std::min(32767.0, value)));
+		pcm[2 * i] = static_cast<char>(sample & 0xFF);
+		pcm[2 * i + 1] = static_cast<char>((sample >> 8) & 0xFF);
+	}
+	return pcm;
+}
+
+static int Sample(const std::string& pcm, size_t i)
+{
+	return static_cast<int16_t>(static_cast<uint8_t>(pcm[2 * i]) | static_cast<uint8_t>(pcm[2 * i + 1]) << 8);
+}
+
+// Runs `run` for about a second; returns runs per second
+static double Rate(const std::function<void()>& run)
+{
+	run();
+	int rounds = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		run();
+		rounds++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < 1.0);
+	return rounds / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t prompts = 200;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--prompts") == 0 && i + 1 < argc)
+		{
+			prompts = static_cast<size_t>(atol(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollyadpcmbench [--prompts N]\n");
+			return 2;
+		}
+	}
+
+	// IVR-length prompts of 1 to 4 seconds
+	std::mt19937 random(3);
+	size_t rawBytes = 0, encodedBytes = 0;
+	double signal = 0, noise = 0, seconds = 0;
+	bool exact = true;
+	for (size_t p = 0; p < prompts; p++)
+	{
+		double length = 1 + (random() % 3000) / 1000.0;
+		auto pcm = SyntheticSpeech(length, static_cast<unsigned>(p));
+		auto entry = PollyAdpcm::Encode(pcm);
+		auto decoded = PollyAdpcm::Decode(entry);
+		exact = exact && PollyAdpcm::IsEncoded(entry) && decoded.size() == pcm.size() &&
+			PollyAdpcm::Decode(entry, [](const char*, size_t) { return true; }, 4096);
+		for (size_t i = 0; i < pcm.size() / 2; i++)
+		{
+			double s = Sample(pcm, i), e = s - Sample(decoded, i);
+			signal += s * s;
+			noise += e * e;
+		}
+		rawBytes += pcm.size();
+		encodedBytes += entry.size();
+		seconds += length;
+	}
+	double mb = 1048576.0;
+	printf("%zu prompts, %.0f s of 16 kHz audio\n", prompts, seconds);
+	printf("%-22s %14s %14s\n", "", "PCM", "IMA-ADPCM");
+	printf("%-22s %14.1f %14.1f\n", "MB", rawBytes / mb, encodedBytes / mb);
+	printf("%-22s %14.1f %14.1f\n", "entries per MB", prompts / (rawBytes / mb), prompts / (encodedBytes / mb));
+	printf("%-22s %14.1f %14.1f\n", "MB per hour of audio", rawBytes / mb * 3600 / seconds,
+		encodedBytes / mb * 3600 / seconds);
+	printf("SNR %.1f dB; sizes and streamed pieces %s\n", 10 * std::log10(signal / noise), exact ? "match" : "DO NOT match");
+
+	// Decode throughput on a long entry, in times real time for one core
+	auto pcm = SyntheticSpeech(60, 99);
+	auto entry = PollyAdpcm::Encode(pcm);
+	size_t blocks = (entry.size() - 8) / PollyAdpcm::BlockBytes;
+	std::vector<int16_t> out(blocks * PollyAdpcm::BlockSamples);
+	auto data = reinterpret_cast<const uint8_t*>(entry.data()) + 8;
+	double scalar = Rate([&]() { PollyAdpcm::DecodeBlocks(data, blocks, out.data(), false); });
+	auto scalarOut = out;
+	double simd = Rate([&]() { PollyAdpcm::DecodeBlocks(data, blocks, out.data(), true); });
+	exact = exact && out == scalarOut;
+	printf("decode, one block at a time: %8.0f MB/s of PCM, %6.0fx real time\n", scalar * pcm.size() / mb, scalar * 60);
+	printf("decode, four blocks (SSE2):  %8.0f MB/s of PCM, %6.0fx real time\n", simd * pcm.size() / mb, simd * 60);
+
+	// A hit starts playing after its first piece, not after the whole entry
+	auto start = std::chrono::steady_clock::now();
+	double firstPieceUs = -1;
+	PollyAdpcm::Decode(entry, [&](const char*, size_t) {
+		if (firstPieceUs < 0)
+		{
+			firstPieceUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+		return true;
+	});
+	double wholeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	printf("60 s entry: first 64 KB piece after %.0f us, whole entry after %.0f us\n", firstPieceUs, wholeUs);
+	printf("SSE2 and one-block decodes %s\n", out == scalarOut ? "match" : "DO NOT match");
+	return exact ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+/******************************************************************************
+* BatchRender.cpp:
+**   Render a manifest of texts to WAV files and speech marks with Amazon Polly
+******************************************************************************/
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <direct.h>
+#endif
+#include "PollyManager.h"
+#include "PollyConfig.h"
+#include "PollyMetrics.h"
+#include "PollySdk.h"
+#include "WavWriter.h"
+#include <aws/core/utils/StringUtils.h>
+#include <aws/polly/model/VoiceId.h>
+#include "rapidjson/document.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace Aws::Polly::Model;
+
+// Polly returns 16-bit mono PCM at 16 kHz
+static const uint32_t SAMPLE_RATE = 16000;
+static const size_t WRITE_CHUNK = 64 * 1024;
+
+struct Clip
+{
+	std::string Id;
+	std::string Voice;
+	std::string Text;
+};
+
+struct Totals
+{
+	std::atomic<size_t> Rendered;
+	std::atomic<size_t> Skipped;
+	std::atomic<size_t> Failed;
+	std::atomic<uint64_t> Characters;
+};
+
+void PrintHelp(const char* exeName)
+{
+	printf("Usage: %s <manifest.jsonl> <output directory> [--jobs N] [--force]\n", exeName);
+	printf("Each manifest line is a JSON object: {\"id\": \"intro-01\", \"voice\": \"Joanna\", \"text\": \"Hello\"}\n");
+	printf("The text can be SSML. Clips whose <id>.wav and <id>.marks.json exist are skipped unless --force is given.\n");
+}
+
+static bool FileExists(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0;
+}
+
+static bool MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	int result = _mkdir(path.c_str());
+#else
+	int result = mkdir(path.c_str(), 0755);
+#endif
+	return result == 0 || errno == EEXIST;
+}
+
+// Replaces `target` with `source`, which std::rename will not do on Windows.
+static bool ReplaceFile(const std::string& source, const std::string& target)
+{
+	std::remove(target.c_str());
+	return std::rename(source.c_str(), target.c_str()) == 0;
+}
+
+static bool IsSafeId(const std::string& id)
+{
+	return !id.empty() && id[0] != '.' && std::all_of(id.begin(), id.end(), [](char c) {
+		return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+	});
+}
+
+// Reads the manifest. Returns false, after reporting every bad line, if any line is invalid.
+static bool ReadManifest(const std::string& path, std::vector<Clip>& clips)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cerr << "Cannot open " << path << std::endl;
+		return false;
+	}
+	bool valid = true;
+	std::set<std::string> ids;
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++)
+	{
+		if (lineNumber == 1 && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+		{
+			line.erase(0, 3);
+		}
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+		{
+			continue;
+		}
+		rapidjson::Document d;
+		d.Parse(line.c_str());
+		if (d.HasParseError() || !d.IsObject() || !d.HasMember("id") || !d["id"].IsString() ||
+			!d.HasMember("voice") || !d["voice"].IsString() || !d.HasMember("text") || !d["text"].IsString())
+		{
+			std::cerr << path << ":" << lineNumber << ": expected {\"id\", \"voice\", \"text\"}" << std::endl;
+			valid = false;
+			continue;
+		}
+		Clip clip;
+		clip.Id = d["id"].GetString();
+		clip.Voice = d["voice"].GetString();
+		clip.Text = std::string(d["text"].GetString(), d["text"].GetStringLength());
+		if (!IsSafeId(clip.Id))
+		{
+			std::cerr << path << ":" << lineNumber << ": id '" << clip.Id << "' must be letters, digits, '-', '_' or '.'" << std::endl;
+			valid = false;
+		}
+		else if (!ids.insert(clip.Id).second)
+		{
+			std::cerr << path << ":" << lineNumber << ": id '" << clip.Id << "' is used twice" << std::endl;
+			valid = false;
+		}
+		else if (VoiceIdMapper::GetVoiceIdForName(clip.Voice.c_str()) == VoiceId::NOT_SET)
+		{
+			std::cerr << path << ":" << lineNumber << ": unknown voice '" << clip.Voice << "'" << std::endl;
+			valid = false;
+		}
+		clips.push_back(std::move(clip));
+	}
+	return valid;
+}
+
+// Writes Polly's speech marks, one JSON object per line, as a JSON array.
+static bool WriteMarks(const std::string& path, const std::string& marks)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << "[";
+	std::istringstream lines(marks);
+	std::string line;
+	bool first = true;
+	while (std::getline(lines, line))
+	{
+		if (line.empty())
+		{
+			continue;
+		}
+		out << (first ? "\n  " : ",\n  ") << line;
+		first = false;
+	}
+	out << "\n]\n";
+	out.close();
+	return !out.fail();
+}
+
+static bool WriteWav(const std::string& path, const std::string& pcm)
+{
+	WavWriter wav(SAMPLE_RATE, 1, 16);
+	if (!wav.Open(path))
+	{
+		return false;
+	}
+	for (size_t offset = 0; offset < pcm.size(); offset += WRITE_CHUNK)
+	{
+		if (!wav.Write(pcm.data() + offset, (std::min)(WRITE_CHUNK, pcm.size() - offset)))
+		{
+			return false;
+		}
+	}
+	return wav.Close();
+}
+
+// Renders one clip. Files are written under a temporary name and renamed
+// when complete, so an interrupted run never leaves a clip that looks done.
+static bool RenderClip(const Clip& clip, const std::string& outputDir, std::string& error)
+{
+	PollyManager pm(Aws::Utils::StringUtils::ToWString(clip.Voice.c_str()).c_str());
+	auto speech = pm.GenerateSpeech(clip.Text);
+	if (!speech.IsSuccess)
+	{
+		error = speech.ErrorMessage;
+		return false;
+	}
+	auto marks = pm.GenerateSpeechMarks(clip.Text, speech.Length);
+	if (!marks.Json)
+	{
+		error = marks.ErrorMessage;
+		return false;
+	}
+
+	auto base = outputDir + "/" + clip.Id;
+	if (!WriteMarks(base + ".marks.json.part", *marks.Json) || !WriteWav(base + ".wav.part", *speech.AudioData))
+	{
+		error = "cannot write " + base;
+		return false;
+	}
+	// The WAV file goes last: its presence is what marks the clip as done
+	if (!ReplaceFile(base + ".marks.json.part", base + ".marks.json") || !ReplaceFile(base + ".wav.part", base + ".wav"))
+	{
+		error = "cannot rename " + base;
+		return false;
+	}
+	return true;
+}
+
+static void PrintProgress(const Totals& totals, size_t clipCount, std::chrono::steady_clock::duration elapsed, bool final)
+{
+	double seconds = (std::max)(0.001, std::chrono::duration<double>(elapsed).count());
+	size_t rendered = totals.Rendered.load();
+	printf("%s%zu/%zu clips: %zu rendered, %zu skipped, %zu failed in %.1fs, %.2f clips/s, %.0f characters/s\n",
+		final ? "Done. " : "", rendered + totals.Skipped.load() + totals.Failed.load(), clipCount, rendered,
+		totals.Skipped.load(), totals.Failed.load(), seconds, rendered / seconds, totals.Characters.load() / seconds);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string manifest, outputDir;
+	long jobs = PollyConfig::GetLong("BATCH_THREADS", 8);
+	bool force = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+		{
+			jobs = atol(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--force") == 0)
+		{
+			force = true;
+		}
+		else if (manifest.empty())
+		{
+			manifest = argv[i];
+		}
+		else if (outputDir.empty())
+		{
+			outputDir = argv[i];
+		}
+		else
+		{
+			manifest.clear();
+			break;
+		}
+	}
+	if (manifest.empty() || outputDir.empty() || jobs < 1)
+	{
+		PrintHelp(argv[0]);
+		return 2;
+	}
+
+	std::vector<Clip> clips;
+	if (!ReadManifest(manifest, clips))
+	{
+		return 2;
+	}
+	if (!MakeDirectory(outputDir))
+	{
+		std::cerr << "Cannot create " << outputDir << std::endl;
+		return 2;
+	}
+
+	PollySdk::Initialize();
+	PollyMetrics::StartExporter();
+
+	Totals totals;
+	totals.Rendered = 0;
+	totals.Skipped = 0;
+	totals.Failed = 0;
+	totals.Characters = 0;
+	std::atomic<size_t> nextClip(0);
+	std::atomic<size_t> running(0);
+	std::mutex outputLock;
+	auto start = std::chrono::steady_clock::now();
+	auto worker = [&]()
+	{
+		for (size_t i = nextClip++; i < clips.size(); i = nextClip++)
+		{
+			auto& clip = clips[i];
+			auto base = outputDir + "/" + clip.Id;
+			if (!force && FileExists(base + ".wav") && FileExists(base + ".marks.json"))
+			{
+				totals.Skipped++;
+				continue;
+			}
+			std::string error;
+			if (RenderClip(clip, outputDir, error))
+			{
+				totals.Rendered++;
+				totals.Characters += clip.Text.size();
+			}
+			else
+			{
+				totals.Failed++;
+				std::lock_guard<std::mutex> guard(outputLock);
+				std::cerr << clip.Id << ": " << error << std::endl;
+			}
+		}
+		running--;
+	};
+
+	// Each worker renders one clip at a time, which bounds the audio in memory
+	size_t workerCount = (std::min)(static_cast<size_t>(jobs), (std::max)(clips.size(), size_t(1)));
+	std::vector<std::thread> workers;
+	running = workerCount;
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	auto lastReport = start;
+	while (running.load() > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastReport >= std::chrono::seconds(5))
+		{
+			std::lock_guard<std::mutex> guard(outputLock);
+			PrintProgress(totals, clips.size(), now - start, false);
+			lastReport = now;
+		}
+	}
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+	PrintProgress(totals, clips.size(), std::chrono::steady_clock::now() - start, true);
+	return totals.Failed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* CanonicalBench.cpp:
+**   Replays a trace of spoken texts and compares the Polly requests and
+**   billed characters needed with raw and with canonical cache keys.
+******************************************************************************/
+#include "PollyCanonicalText.h"
+#include "PollyPhraseStore.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Texts as applications hand them to SAPI: the same prompts with stray
+// whitespace, upper-case tags and extra <speak> wrappers
+static std::vector<std::string> SyntheticTrace(size_t count)
+{
+	static const char* prompts[] = {
+		"Your call is important to us.", "Please hold while we connect you.", "Press one for sales.",
+		"Press two for support.", "The meeting starts in five minutes.", "You have a new message.",
+		"Battery low.", "Connection lost, retrying.", "Welcome back.", "Your order has shipped.",
+		"Please enter your PIN.", "That number is not valid.", "Goodbye.", "Saving your changes.",
+		"Download complete.", "Printing has finished.", "Press the pound key when you are done.",
+	};
+	const size_t promptCount = sizeof(prompts) / sizeof(prompts[0]);
+	std::mt19937 random(42);
+	std::vector<std::string> trace;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string text = prompts[random() % promptCount];
+		switch (random() % 8)
+		{
+		case 0: text += "  "; break;
+		case 1: text = " " + text + "\r\n"; break;
+		case 2: text.insert(text.find(' ') == std::string::npos ? 0 : text.find(' '), "  "); break;
+		case 3: text = "<SPEAK>" + text + "</SPEAK>"; break;
+		case 4: text = "<speak> " + text + " </speak>"; break;
+		case 5: text = "<speak><speak>" + text + "</speak></speak>"; break;
+		default: break;
+		}
+		trace.push_back(text);
+	}
+	return trace;
+}
+
+static std::vector<std::string> ReadTrace(const char* path)
+{
+	std::vector<std::string> trace;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// Line breaks inside a text are written as \n
+		for (size_t at = line.find("\\n"); at != std::string::npos; at = line.find("\\n", at + 1))
+		{
+			line.replace(at, 2, "\n");
+		}
+		trace.push_back(line);
+	}
+	return trace;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* tracePath = nullptr;
+	size_t count = 100000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+		{
+			count = static_cast<size_t>(atol(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollycanonicalbench [--trace FILE (one text per line, \\n for line breaks)] [--count N]\n");
+			return 2;
+		}
+	}
+	auto trace = tracePath != nullptr ? ReadTrace(tracePath) : SyntheticTrace(count);
+
+	// With a cache, Polly is asked once per distinct key and bills that request
+	std::unordered_set<std::string> rawKeys, canonicalKeys;
+	size_t rawBilled = 0, canonicalBilled = 0, saved = 0, bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto& text : trace)
+	{
+		bool rawSsml = text.compare(0, 6, "<speak") == 0 || text.compare(0, 6, "<SPEAK") == 0;
+		if (rawKeys.insert(PollyPhraseStore::Key("Joanna", PollyPhraseStore::PcmOutput, text)).second)
+		{
+			rawBilled += PollyCanonicalText::BilledCharacters(text, rawSsml);
+		}
+		auto canonical = PollyCanonicalText::Canonicalize(text);
+		saved += canonical.SavedCharacters;
+		bytes += text.size();
+		if (canonicalKeys.insert(PollyPhraseStore::Key("Joanna", PollyPhraseStore::PcmOutput, canonical.Text)).second)
+		{
+			canonicalBilled += PollyCanonicalText::BilledCharacters(canonical.Text, canonical.Ssml);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%zu texts from %s\n", trace.size(), tracePath != nullptr ? tracePath : "the synthetic trace");
+	printf("%-20s %12s %12s\n", "", "raw", "canonical");
+	printf("%-20s %12zu %12zu\n", "Polly requests", rawKeys.size(), canonicalKeys.size());
+	printf("%-19s %11.2f%% %11.2f%%\n", "cache hit rate", 100.0 * (trace.size() - rawKeys.size()) / trace.size(),
+		100.0 * (trace.size() - canonicalKeys.size()) / trace.size());
+	printf("%-20s %12zu %12zu\n", "billed characters", rawBilled, canonicalBilled);
+	printf("%zu billed characters saved over all texts; keys and canonical form at %.0f MB/s\n",
+		saved, bytes / seconds / 1048576);
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* CoroutineBench.cpp:
+**   Speaks growing numbers of concurrent utterances, each from its own
+**   caller thread as SAPI's Speak is, with simulated Polly latency. Each
+**   utterance asks for its chunks at once and outputs them in order on its
+**   caller thread. Compares a thread per chunk that blocks for the call,
+**   as the engine did, with coroutines on the shared executor. The call is
+**   simulated with a timer; the SDK's own connection threads are not
+**   counted in either case.
+******************************************************************************/
+#include "PollyExecutor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Threads alive that the bench started, and the most seen at once
+static std::atomic<long> s_threads(0);
+static std::atomic<long> s_peakThreads(0);
+
+struct ThreadCount
+{
+	ThreadCount()
+	{
+		long now = ++s_threads;
+		long peak = s_peakThreads.load();
+		while (now > peak && !s_peakThreads.compare_exchange_weak(peak, now))
+		{
+		}
+	}
+	~ThreadCount() { --s_threads; }
+};
+
+struct Options
+{
+	long LatencyMs = 200;
+	size_t Chunks = 3;
+	size_t ChunkBytes = 32000;
+};
+
+static std::string BlockingChunk(const Options& options)
+{
+	ThreadCount counted;
+	std::this_thread::sleep_for(std::chrono::milliseconds(options.LatencyMs));
+	return std::string(options.ChunkBytes, '\x01');
+}
+
+// Returns the bytes output, so the work is not optimized away
+static size_t SpeakBlocking(const Options& options)
+{
+	std::vector<std::future<std::string>> pending;
+	for (size_t i = 0; i < options.Chunks; i++)
+	{
+		pending.push_back(std::async(std::launch::async, [&options]() { return BlockingChunk(options); }));
+	}
+	size_t bytes = 0;
+	for (auto& chunk : pending)
+	{
+		bytes += chunk.get().size();
+	}
+	return bytes;
+}
+
+static PollyTask<std::string> CoroutineChunk(Options options)
+{
+	co_await PollyExecutor::Shared().Delay(std::chrono::milliseconds(options.LatencyMs));
+	co_return std::string(options.ChunkBytes, '\x01');
+}
+
+static PollyTask<size_t> SpeakCoroutine(Options options, PollyCallerLoop& caller)
+{
+	std::vector<PollyFuture<std::string>> pending;
+	for (size_t i = 0; i < options.Chunks; i++)
+	{
+		pending.push_back(PollyExecutor::Shared().Spawn(CoroutineChunk(options)));
+	}
+	size_t bytes = 0;
+	for (auto& chunk : pending)
+	{
+		auto audio = co_await chunk;
+		// Output happens on the caller thread, as SAPI's Write must
+		co_await caller.Schedule();
+		bytes += audio.size();
+	}
+	co_return bytes;
+}
+
+static void Measure(const char* mode, size_t utterances, const Options& options, bool coroutines)
+{
+	s_peakThreads = 0;
+	std::vector<double> latencies(utterances);
+	std::atomic<size_t> bytes(0);
+	auto start = Clock::now();
+	std::vector<std::thread> callers;
+	for (size_t i = 0; i < utterances; i++)
+	{
+		callers.emplace_back([&, i]() {
+			ThreadCount counted;
+			auto begin = Clock::now();
+			if (coroutines)
+			{
+				PollyCallerLoop caller;
+				bytes += caller.Run(SpeakCoroutine(options, caller));
+			}
+			else
+			{
+				bytes += SpeakBlocking(options);
+			}
+			latencies[i] = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+		});
+	}
+	for (auto& caller : callers)
+	{
+		caller.join();
+	}
+	double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	std::sort(latencies.begin(), latencies.end());
+	double mean = 0;
+	for (double latency : latencies)
+	{
+		mean += latency / utterances;
+	}
+	double p99 = latencies[std::min(utterances - 1, utterances * 99 / 100)];
+	long peak = s_peakThreads.load() + (coroutines ? static_cast<long>(PollyExecutor::Shared().ThreadCount()) : 0);
+	if (bytes.load() != utterances * options.Chunks * options.ChunkBytes)
+	{
+		fprintf(stderr, "Lost audio in %s\n", mode);
+		exit(1);
+	}
+	printf("%-12s %10zu %10.0f %10.1f %10.1f %12ld\n", mode, utterances, wallMs, mean, p99, peak);
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	size_t maxUtterances = 1000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc)
+		{
+			options.LatencyMs = atol(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--chunks") == 0 && i + 1 < argc)
+		{
+			options.Chunks = static_cast<size_t>(std::max(1L, atol(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--max-utterances") == 0 && i + 1 < argc)
+		{
+			maxUtterances = static_cast<size_t>(std::max(1L, atol(argv[++i])));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollycoroutinebench [--latency-ms N] [--chunks N] [--max-utterances N]\n");
+			return 2;
+		}
+	}
+
+	// Starts the executor before anything is timed
+	PollyExecutor::Shared();
+	printf("%-12s %10s %10s %10s %10s %12s\n", "mode", "utterances", "wall ms", "mean ms", "p99 ms", "peak threads");
+	for (size_t utterances = 1; utterances <= maxUtterances; utterances *= 10)
+	{
+		Measure("threads", utterances, options, false);
+		Measure("coroutines", utterances, options, true);
+	}
+	return 0;
+}
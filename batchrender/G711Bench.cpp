@@ -0,0 +1,174 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* G711Bench.cpp:
+**   Measures how many 8 kHz telephony channels one core can encode to G.711:
+**   converting the engine's 16 kHz PCM (a stand-in for SAPI's format
+**   converter), encoding 8 kHz PCM from Polly with the engine's tables, and
+**   playing a cached entry that is already encoded.
+******************************************************************************/
+#include "PollyAudioFormat.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// The ITU-T G.191 reference mu-law encoder, as a converter without tables runs it
+static uint8_t ComputeMuLaw(int sample)
+{
+	int magnitude = (sample < 0 ? ~sample >> 2 : sample >> 2) + 33;
+	if (magnitude > 0x1FFF)
+	{
+		magnitude = 0x1FFF;
+	}
+	int segment = 1;
+	for (int i = magnitude >> 6; i != 0; i >>= 1)
+	{
+		segment++;
+	}
+	int code = (8 - segment) << 4 | (15 - ((magnitude >> segment) & 0xF));
+	return static_cast<uint8_t>(sample >= 0 ? code | 0x80 : code);
+}
+
+// 16-bit little-endian PCM that sounds roughly like speech: a few drifting
+// harmonics under a syllable-rate envelope, with some noise
+static std::string SyntheticSpeech(size_t samples, int rate)
+{
+	std::mt19937 random(7);
+	std::normal_distribution<double> noise(0, 300);
+	std::string pcm(2 * samples, '\0');
+	const double pi = 3.14159265358979;
+	for (size_t i = 0; i < samples; i++)
+	{
+		double t = static_cast<double>(i) / rate;
+		double pitch = 120 + 30 * std::sin(2 * pi * 0.7 * t);
+		double envelope = 0.5 + 0.5 * std::sin(2 * pi * 4 * t);
+		double value = 0;
+		for (int harmonic = 1; harmonic <= 6; harmonic++)
+		{
+			value += std::sin(2 * pi * pitch * harmonic * t) * 6000 / harmonic;
+		}
+		value = value * envelope + noise(random);
+		int sample = static_cast<int>(std::max(-32768.0, std::min(32767.0, value)));
+		pcm[2 * i] = static_cast<char>(sample & 0xFF);
+		pcm[2 * i + 1] = static_cast<char>((sample >> 8) & 0xFF);
+	}
+	return pcm;
+}
+
+static int Sample(const std::string& pcm, size_t i)
+{
+	return static_cast<int16_t>(static_cast<uint8_t>(pcm[2 * i]) | static_cast<uint8_t>(pcm[2 * i + 1]) << 8);
+}
+
+// 16 kHz to 8 kHz with a 15-tap half-band low-pass, then mu-law per sample
+static void ConvertFrom16k(const std::string& pcm, std::string& out)
+{
+	static const double taps[8] = { 0.5, 0.3166, 0, -0.1013, 0, 0.0542, 0, -0.0300 };
+	size_t count = pcm.size() / 4;
+	out.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t center = 2 * i;
+		double value = taps[0] * Sample(pcm, center);
+		for (size_t k = 1; k < 8; k += 2)
+		{
+			int before = center >= k ? Sample(pcm, center - k) : 0;
+			int after = center + k < pcm.size() / 2 ? Sample(pcm, center + k) : 0;
+			value += taps[k] * (before + after);
+		}
+		int sample = static_cast<int>(std::max(-32768.0, std::min(32767.0, value)));
+		out[i] = static_cast<char>(ComputeMuLaw(sample));
+	}
+}
+
+// Seconds of 8 kHz audio that `run` produces per second of one core
+static double Realtime(double audioSeconds, const std::function<void()>& run)
+{
+	run();
+	int rounds = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		run();
+		rounds++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < 1.0);
+	return audioSeconds * rounds / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 60;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atof(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollyg711bench [--seconds AUDIO_SECONDS]\n");
+			return 2;
+		}
+	}
+
+	auto pcm16k = SyntheticSpeech(static_cast<size_t>(seconds * 16000), 16000);
+	auto pcm8k = SyntheticSpeech(static_cast<size_t>(seconds * 8000), 8000);
+
+	// The tables must give the reference encoder's code for every sample
+	std::string every(2 * 65536, '\0'), muLaw(65536, '\0'), aLaw(65536, '\0');
+	for (int i = 0; i < 65536; i++)
+	{
+		every[2 * i] = static_cast<char>(i & 0xFF);
+		every[2 * i + 1] = static_cast<char>(i >> 8);
+	}
+	PollyAudio::EncodeMuLaw(every.data(), 65536, &muLaw[0]);
+	PollyAudio::EncodeALaw(every.data(), 65536, &aLaw[0]);
+	int mismatches = 0;
+	for (int i = 0; i < 65536; i++)
+	{
+		mismatches += static_cast<uint8_t>(muLaw[i]) != ComputeMuLaw(static_cast<int16_t>(i));
+	}
+	bool knownCodes = static_cast<uint8_t>(muLaw[0]) == 0xFF && static_cast<uint8_t>(aLaw[0]) == 0xD5 &&
+		static_cast<uint8_t>(muLaw[0x8000]) == 0x00 && static_cast<uint8_t>(aLaw[0x8000]) == 0x2A &&
+		static_cast<uint8_t>(muLaw[0x7FFF]) == 0x80 && static_cast<uint8_t>(aLaw[0x7FFF]) == 0xAA;
+	printf("mu-law table vs computed encoder: %d of 65536 samples differ; known codes %s\n",
+		mismatches, knownCodes ? "match" : "DO NOT match");
+
+	std::string converted, encoded(pcm8k.size() / 2, '\0'), played(pcm8k.size() / 2, '\0');
+	auto cached = PollyAudio::Encode(PollyAudioFormat::MuLaw8k, pcm8k);
+	struct Path
+	{
+		const char* name;
+		std::function<void()> run;
+	};
+	Path paths[] = {
+		{ "16 kHz PCM, converted", [&]() { ConvertFrom16k(pcm16k, converted); } },
+		{ "8 kHz PCM, mu-law tables", [&]() { PollyAudio::EncodeMuLaw(pcm8k.data(), pcm8k.size() / 2, &encoded[0]); } },
+		{ "8 kHz PCM, A-law tables", [&]() { PollyAudio::EncodeALaw(pcm8k.data(), pcm8k.size() / 2, &encoded[0]); } },
+		{ "cached mu-law, copied", [&]() { memcpy(&played[0], cached.data(), cached.size()); } },
+	};
+	printf("%.0f s of audio per round\n", seconds);
+	printf("%-28s %18s\n", "", "channels per core");
+	for (auto& path : paths)
+	{
+		printf("%-28s %18.0f\n", path.name, Realtime(seconds, path.run));
+	}
+	return mismatches == 0 && knownCodes ? 0 : 1;
+}
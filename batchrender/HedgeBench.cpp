@@ -0,0 +1,191 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* HedgeBench.cpp:
+**   Sends simulated Polly requests at a steady rate, with and without
+**   hedging, and compares the latency percentiles and the extra requests.
+**   Times to first byte are mostly log-normal around LatencyMs, but a few
+**   requests stall, as a lost packet or a slow host makes them. Each
+**   request races its attempts as PollyManager::Synthesize does, with the
+**   same PollyHedgePolicy; the HEDGE_* settings other than HEDGE apply.
+**   An attempt is a timer on the shared executor.
+******************************************************************************/
+#include "PollyExecutor.h"
+#include "PollyHedge.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+	size_t Requests = 2000;
+	long IntervalMs = 4;
+	double LatencyMs = 120;
+	double StallPercent = 3;
+};
+
+// First-byte times of a request's two possible attempts, drawn up front
+struct Draw
+{
+	double AttemptMs[2];
+};
+
+struct Race
+{
+	std::atomic<int> winner;
+	PollyAsyncEvent claimed;
+
+	Race() : winner(-1) {}
+};
+
+static std::atomic<long> s_hedges(0);
+static std::atomic<long> s_hedgeWins(0);
+
+static void Launch(const std::shared_ptr<Race>& race, int attempt, double firstByteMs, PollyHedgePolicy* policy)
+{
+	auto delay = std::chrono::microseconds(static_cast<int64_t>(firstByteMs * 1000));
+	PollyExecutor::Shared().PostAfter(delay, [race, attempt, delay, policy]() {
+		// Losing attempts are samples too, as in PollyManager::Synthesize
+		if (policy != nullptr)
+		{
+			policy->RecordFirstByte(delay);
+		}
+		int expected = -1;
+		race->winner.compare_exchange_strong(expected, attempt);
+		race->claimed.Set();
+	});
+}
+
+// Milliseconds until the first byte of the winning attempt
+static PollyTask<double> Request(Draw draw, bool hedging)
+{
+	auto& policy = PollyHedgePolicy::ForAudio();
+	auto start = Clock::now();
+	auto race = std::make_shared<Race>();
+	policy.RecordRequest();
+	Launch(race, 0, draw.AttemptMs[0], hedging ? &policy : nullptr);
+	if (hedging)
+	{
+		bool decided = co_await race->claimed.WaitFor(policy.HedgeDelay());
+		if (!decided && policy.TryAcquireHedge())
+		{
+			s_hedges++;
+			Launch(race, 1, draw.AttemptMs[1], &policy);
+		}
+	}
+	co_await race->claimed.Wait();
+	if (race->winner.load() == 1)
+	{
+		s_hedgeWins++;
+	}
+	co_return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static PollyTask<std::vector<double>> Run(const std::vector<Draw>& draws, const Options& options, bool hedging)
+{
+	std::vector<PollyFuture<double>> pending;
+	auto next = Clock::now();
+	for (auto& draw : draws)
+	{
+		// Steady arrivals, however long the earlier requests take
+		auto now = Clock::now();
+		if (next > now)
+		{
+			co_await PollyExecutor::Shared().Delay(next - now);
+		}
+		next += std::chrono::milliseconds(options.IntervalMs);
+		pending.push_back(PollyExecutor::Shared().Spawn(Request(draw, hedging)));
+	}
+	std::vector<double> latencies;
+	for (auto& request : pending)
+	{
+		latencies.push_back(co_await request);
+	}
+	co_return latencies;
+}
+
+static double Percentile(const std::vector<double>& sorted, int percentile)
+{
+	return sorted[std::min(sorted.size() - 1, sorted.size() * percentile / 100)];
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+		{
+			options.Requests = static_cast<size_t>(std::max(100L, atol(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc)
+		{
+			options.LatencyMs = std::max(1.0, atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--stall-percent") == 0 && i + 1 < argc)
+		{
+			options.StallPercent = std::min(100.0, std::max(0.0, atof(argv[++i])));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollyhedgebench [--requests N] [--latency-ms N] [--stall-percent N]\n");
+			return 2;
+		}
+	}
+
+	// The same draws for both runs, so only hedging differs
+	std::mt19937 random(29);
+	std::lognormal_distribution<double> body(std::log(options.LatencyMs), 0.3);
+	std::uniform_real_distribution<double> percent(0, 100);
+	std::uniform_real_distribution<double> stall(8 * options.LatencyMs, 20 * options.LatencyMs);
+	std::vector<Draw> draws(options.Requests);
+	for (auto& draw : draws)
+	{
+		for (double& ms : draw.AttemptMs)
+		{
+			ms = percent(random) < options.StallPercent ? stall(random) : body(random);
+		}
+	}
+
+	printf("%zu requests, one every %ld ms, first byte ~%.0f ms, %.1f%% stall for %.0f-%.0f ms\n",
+		options.Requests, options.IntervalMs, options.LatencyMs, options.StallPercent,
+		8 * options.LatencyMs, 20 * options.LatencyMs);
+	printf("%-10s %8s %8s %8s %8s %8s %10s\n", "mode", "p50 ms", "p95 ms", "p99 ms", "p99.9 ms", "max ms",
+		"extra req");
+	for (int hedging = 0; hedging < 2; hedging++)
+	{
+		s_hedges = 0;
+		s_hedgeWins = 0;
+		PollyCallerLoop loop;
+		auto latencies = loop.Run(Run(draws, options, hedging != 0));
+		std::sort(latencies.begin(), latencies.end());
+		double p999 = latencies[std::min(latencies.size() - 1, latencies.size() * 999 / 1000)];
+		printf("%-10s %8.0f %8.0f %8.0f %8.0f %8.0f %9.1f%%\n", hedging ? "hedged" : "single",
+			Percentile(latencies, 50), Percentile(latencies, 95), Percentile(latencies, 99), p999,
+			latencies.back(), 100.0 * s_hedges.load() / latencies.size());
+		if (hedging)
+		{
+			printf("hedges sent: %ld, won: %ld, delay at the end: %lld ms\n", s_hedges.load(), s_hedgeWins.load(),
+				static_cast<long long>(PollyHedgePolicy::ForAudio().HedgeDelay().count()));
+		}
+	}
+	return 0;
+}
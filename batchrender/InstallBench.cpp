@@ -0,0 +1,122 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* InstallBench.cpp:
+**   Measures how long installing Polly voices takes on each machine, using
+**   the installer's diff and parallel apply against an in-memory registry.
+******************************************************************************/
+#include "VoiceRegistry.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A catalog of `count` made-up voices; `generation` changes a few language
+// names and adds voices, as a Polly update would
+static std::vector<PollyVoiceInfo> Catalog(size_t count, int generation)
+{
+	static const char* languages[][3] = {
+		{ "en-US", "US English", "Female" }, { "en-GB", "British English", "Male" },
+		{ "de-DE", "German", "Female" }, { "fr-FR", "French", "Male" }, { "ja-JP", "Japanese", "Female" },
+	};
+	std::vector<PollyVoiceInfo> voices;
+	for (size_t i = 0; i < count + generation * 5; i++)
+	{
+		auto& language = languages[i % 5];
+		PollyVoiceInfo voice;
+		voice.Id = "Voice" + std::to_string(i);
+		voice.LanguageCode = language[0];
+		voice.LanguageName = std::string(language[1]) + (generation > 0 && i % 20 == 0 ? " (updated)" : "");
+		voice.Gender = language[2];
+		voice.Lcid = static_cast<uint16_t>(0x0409 + i % 5);
+		voices.push_back(voice);
+	}
+	return voices;
+}
+
+struct Result
+{
+	size_t Changes;
+	size_t Writes;
+	double Seconds;
+};
+
+static Result Install(InMemoryVoiceRegistry& registry, const std::vector<PollyVoiceInfo>& catalog, size_t threads)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<VoiceForSAPI> desired(catalog.begin(), catalog.end());
+	size_t writesBefore = registry.Writes();
+	auto changes = PlanInstall(desired, registry.List(), true);
+	ApplyChanges(registry, changes, threads, false);
+	return Result{ changes.size(), registry.Writes() - writesBefore,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+}
+
+int main(int argc, char* argv[])
+{
+	size_t voices = 100;
+	size_t threads = 8;
+	size_t hosts = 1000;
+	long latencyMicros = 1000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--voices") == 0 && i + 1 < argc)
+		{
+			voices = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--hosts") == 0 && i + 1 < argc)
+		{
+			hosts = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--write-latency-us") == 0 && i + 1 < argc)
+		{
+			latencyMicros = atol(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollyinstallbench [--voices N] [--threads N] [--hosts N] [--write-latency-us N]\n");
+			return 2;
+		}
+	}
+
+	auto first = Catalog(voices, 0);
+	auto second = Catalog(voices, 1);
+	std::chrono::microseconds latency(latencyMicros);
+	InMemoryVoiceRegistry serial(latency), parallel(latency);
+	struct Step
+	{
+		const char* Name;
+		Result Serial;
+		Result Parallel;
+	};
+	Step steps[] = {
+		{ "first install", Install(serial, first, 1), Install(parallel, first, threads) },
+		{ "same catalog", Install(serial, first, 1), Install(parallel, first, threads) },
+		{ "catalog update", Install(serial, second, 1), Install(parallel, second, threads) },
+	};
+
+	printf("%zu voices, %ld us per registry write, %zu threads, fleet of %zu hosts\n",
+		voices, latencyMicros, threads, hosts);
+	printf("%-16s %8s %8s %12s %12s %14s\n", "step", "changes", "writes", "1 thread s", "parallel s", "fleet hours");
+	for (auto& step : steps)
+	{
+		printf("%-16s %8zu %8zu %12.3f %12.3f %14.2f\n", step.Name, step.Parallel.Changes, step.Parallel.Writes,
+			step.Serial.Seconds, step.Parallel.Seconds, step.Parallel.Seconds * hosts / 3600);
+	}
+	return 0;
+}
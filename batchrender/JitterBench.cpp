@@ -0,0 +1,168 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* JitterBench.cpp:
+**   Replays one jittered arrival trace from a local stand-in for a Polly
+**   stream through the playout buffer, against a consumer that takes
+**   audio at the pace of playback as an audio device does. Reports
+**   underruns, time starved, overruns, depth and start-up latency for
+**   several low watermarks, and the stutter of writing each chunk as it
+**   arrives. A last run writes to a consumer that takes audio at once, as
+**   a file does, which must get exactly the audio sent.
+******************************************************************************/
+#include "PollyJitterBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Arrival
+{
+	double atMs;
+	size_t bytes;
+};
+
+// Chunks of 4 KB (128 ms at 16 kHz) with log-normal variation, delivered
+// 1.1 times faster than real time between occasional stalls, which bring
+// the average just below real time, as on a congested link
+static std::vector<Arrival> StandInStream(double seconds, unsigned seed)
+{
+	const size_t chunkBytes = 4096;
+	const double bytesPerMs = 32;
+	std::mt19937 random(seed);
+	// Mean 1
+	std::lognormal_distribution<double> variation(-0.18, 0.6);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	std::vector<Arrival> arrivals;
+	double at = 150; // time to first byte
+	for (double sent = 0; sent < seconds * 1000 * bytesPerMs; sent += chunkBytes)
+	{
+		arrivals.push_back({ at, chunkBytes });
+		at += chunkBytes / bytesPerMs / 1.1 * variation(random);
+		if (uniform(random) < 0.05)
+		{
+			at += 200 + 400 * uniform(random);
+		}
+	}
+	return arrivals;
+}
+
+// Writing each chunk as it arrives: playback stalls whenever a chunk is
+// late, and the network is not read while a chunk is being written
+static void Direct(const std::vector<Arrival>& arrivals)
+{
+	double playEnd = 0, stallMs = 0, blockedMs = 0;
+	int stalls = 0;
+	for (size_t i = 0; i < arrivals.size(); i++)
+	{
+		double start = std::max(arrivals[i].atMs, playEnd);
+		if (i > 0 && arrivals[i].atMs > playEnd)
+		{
+			stalls++;
+			stallMs += arrivals[i].atMs - playEnd;
+		}
+		blockedMs += start - arrivals[i].atMs;
+		playEnd = start + arrivals[i].bytes / 32.0;
+	}
+	printf("%-18s %9d %10.0f %9s %10s %10s %10.0f %12.0f\n", "direct writes", stalls, stallMs, "-", "-", "-",
+		arrivals.front().atMs, blockedMs);
+}
+
+static bool Buffered(const std::vector<Arrival>& arrivals, uint32_t lowMs, uint32_t highMs, bool realTime)
+{
+	PollyJitterBuffer buffer(32, lowMs, highMs);
+	std::string chunk(4096, '\x01');
+	auto start = std::chrono::steady_clock::now();
+	double blockedMs = 0;
+	std::thread producer([&]() {
+		for (auto& arrival : arrivals)
+		{
+			std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<int64_t>(arrival.atMs * 1000)));
+			auto pushStart = std::chrono::steady_clock::now();
+			buffer.Push(chunk.data(), arrival.bytes);
+			blockedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pushStart).count();
+		}
+		buffer.Close();
+	});
+
+	// A real-time consumer plays each frame for its own duration and, like
+	// an audio device, takes the next once less than its queue is left
+	const auto deviceQueue = std::chrono::milliseconds(100);
+	std::string frame, played;
+	double firstMs = -1;
+	auto clock = std::chrono::steady_clock::now();
+	while (buffer.Pop(frame))
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (firstMs < 0)
+		{
+			firstMs = std::chrono::duration<double, std::milli>(now - start).count();
+			clock = now;
+		}
+		played += frame;
+		if (realTime)
+		{
+			clock = std::max(clock, now) + std::chrono::microseconds(frame.size() * 1000 / 32);
+			std::this_thread::sleep_until(clock - deviceQueue);
+		}
+	}
+	producer.join();
+
+	std::string sent;
+	for (auto& arrival : arrivals)
+	{
+		sent.append(chunk, 0, arrival.bytes);
+	}
+	auto stats = buffer.GetStats();
+	char name[32];
+	snprintf(name, sizeof(name), "buffer %u-%u ms%s", lowMs, highMs, realTime ? "" : " file");
+	printf("%-18s %9llu %10llu %9llu %10u %10u %10.0f %12.0f\n", name, static_cast<unsigned long long>(stats.Underruns),
+		static_cast<unsigned long long>(stats.StarvedMs), static_cast<unsigned long long>(stats.Overruns),
+		stats.MeanDepthMs, stats.TargetMs, firstMs, blockedMs);
+	return played == sent;
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = 10;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atof(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollyjitterbench [--seconds AUDIO_SECONDS]\n");
+			return 2;
+		}
+	}
+
+	auto arrivals = StandInStream(seconds, 5);
+	printf("%.0f s of 16 kHz audio in %zu chunks, replayed in real time\n", seconds, arrivals.size());
+	printf("%-18s %9s %10s %9s %10s %10s %10s %12s\n", "", "stutters", "starved ms", "overruns", "mean depth",
+		"target ms", "first ms", "reader wait ms");
+	Direct(arrivals);
+	bool complete = true;
+	complete = Buffered(arrivals, 0, 2000, true) && complete;
+	complete = Buffered(arrivals, 60, 2000, true) && complete;
+	complete = Buffered(arrivals, 250, 2000, true) && complete;
+	complete = Buffered(arrivals, 60, 500, true) && complete;
+	complete = Buffered(arrivals, 60, 2000, false) && complete;
+	printf("every byte %s played, with nothing added\n", complete ? "was" : "WAS NOT");
+	return complete ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* LogBench.cpp:
+**   Times the engine's two per-word loops, the tokenizer and the speech
+**   marks loop, with logging as the engine had it (a synchronous logger
+**   writing every line) and as it has it now (the asynchronous PollyLog
+**   logger, at trace level, below its level, and compiled out). Lines go
+**   to a file in the current directory, which is removed at the end.
+******************************************************************************/
+#include "LogBenchLoops.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+
+static const char* LOG_FILE = "pollylogbench.log";
+
+struct Corpus
+{
+	std::wstring Text;
+	std::vector<LogBenchMark> Marks;
+	long StreamSize;
+};
+
+// Words with the punctuation the tokenizer splits off, and one mark per word
+static Corpus MakeCorpus(size_t words)
+{
+	static const char* vocabulary[] = { "the", "account", "balance", "is", "(see", "below),", "please",
+		"press", "\"one\"", "for", "billing;", "two", "for", "support.", "thank", "you!", "your", "order",
+		"shipped:", "today?" };
+	std::mt19937 random(5);
+	Corpus corpus;
+	int timeMs = 0, byte = 0;
+	for (size_t i = 0; i < words; i++)
+	{
+		std::string word = vocabulary[random() % (sizeof(vocabulary) / sizeof(vocabulary[0]))];
+		corpus.Text.append(word.begin(), word.end());
+		corpus.Text.push_back(L' ');
+		corpus.Marks.push_back(LogBenchMark{ timeMs, byte, byte + static_cast<int>(word.size()), word });
+		timeMs += 150 + static_cast<int>(random() % 300);
+		byte += static_cast<int>(word.size()) + 1;
+	}
+	corpus.StreamSize = 32L * (timeMs + 300);
+	return corpus;
+}
+
+// Best of `rounds`, in nanoseconds per word
+static double Time(size_t words, int rounds, const std::function<void()>& run)
+{
+	double best = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		best = round == 0 ? ns : std::min(best, ns);
+	}
+	return best / words;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t words = 100000;
+	int rounds = 5;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--words") == 0 && i + 1 < argc)
+		{
+			words = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+		{
+			rounds = std::max(1, atoi(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollylogbench [--words N] [--rounds N]\n");
+			return 2;
+		}
+	}
+	auto corpus = MakeCorpus(words);
+
+	auto file = std::make_shared<spdlog::sinks::basic_file_sink_mt>(LOG_FILE, true);
+	// The logger the engine used to create, with a file instead of OutputDebugString
+	auto synchronous = std::make_shared<spdlog::logger>("synchronous", file);
+	synchronous->set_level(spdlog::level::trace);
+	// Configured as PollyLog::Get configures it
+	spdlog::init_thread_pool(8192, 1);
+	auto asynchronous = std::make_shared<spdlog::async_logger>("asynchronous", file, spdlog::thread_pool(),
+		spdlog::async_overflow_policy::overrun_oldest);
+
+	struct Case
+	{
+		const char* Name;
+		std::shared_ptr<spdlog::logger> Logger;
+		spdlog::level::level_enum Level;
+		bool CompiledIn;
+	};
+	Case cases[] = {
+		{ "synchronous, every line (before)", synchronous, spdlog::level::trace, true },
+		{ "asynchronous, LOG_LEVEL=trace", asynchronous, spdlog::level::trace, true },
+		{ "asynchronous, below LOG_LEVEL", asynchronous, spdlog::level::info, true },
+		{ "compiled out (release build)", asynchronous, spdlog::level::info, false },
+	};
+
+	printf("%zu words, best of %d rounds\n", words, rounds);
+	printf("%-34s %16s %16s\n", "", "tokenizer ns/word", "marks ns/word");
+	size_t checksum = 0;
+	for (auto& c : cases)
+	{
+		c.Logger->set_level(c.Level);
+		double tokenize = Time(words, rounds, [&]() {
+			checksum += c.CompiledIn ? LoggingCompiledIn::Tokenize(corpus.Text, c.Logger) :
+				LoggingCompiledOut::Tokenize(corpus.Text, c.Logger);
+		});
+		double marks = Time(words, rounds, [&]() {
+			checksum += c.CompiledIn ? LoggingCompiledIn::SpeechMarks(corpus.Marks, corpus.StreamSize, c.Logger) :
+				LoggingCompiledOut::SpeechMarks(corpus.Marks, corpus.StreamSize, c.Logger);
+		});
+		printf("%-34s %16.1f %16.1f\n", c.Name, tokenize, marks);
+	}
+	printf("asynchronous lines dropped when the queue was full: %zu (checksum %zu)\n",
+		spdlog::thread_pool()->overrun_counter(), checksum);
+	asynchronous.reset();
+	synchronous.reset();
+	file.reset();
+	spdlog::shutdown();
+	remove(LOG_FILE);
+	return 0;
+}
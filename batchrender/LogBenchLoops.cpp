@@ -0,0 +1,125 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* LogBenchLoops.cpp:
+**   The loops timed by pollylogbench. Built twice, with LOG_BENCH_VARIANT
+**   naming the namespace and SPDLOG_ACTIVE_LEVEL set for that variant.
+******************************************************************************/
+#include "LogBenchLoops.h"
+#include "PollyLog.h"
+#include "SpeechMark.h"
+#include <cwchar>
+#include <cwctype>
+
+namespace
+{
+	// ASCII only, which is all the bench text holds; stands in for
+	// Aws::Utils::StringUtils::FromWString
+	std::string Narrow(const wchar_t* text, size_t length)
+	{
+		std::string narrow(length, '\0');
+		for (size_t i = 0; i < length; i++)
+		{
+			narrow[i] = static_cast<char>(text[i]);
+		}
+		return narrow;
+	}
+
+	bool IsIn(wchar_t c, const wchar_t* set)
+	{
+		return wcschr(set, c) != nullptr && c != 0;
+	}
+}
+
+namespace LOG_BENCH_VARIANT
+{
+	size_t Tokenize(const std::wstring& text, const std::shared_ptr<spdlog::logger>& logger)
+	{
+		const auto& m_logger = logger;
+		size_t items = 0;
+		const wchar_t* next = text.c_str();
+		const wchar_t* end = next + text.size();
+		for (;;)
+		{
+			while (next < end && iswspace(*next))
+			{
+				next++;
+			}
+			if (next == end)
+			{
+				break;
+			}
+			const wchar_t* token = next;
+			while (next < end && !iswspace(*next))
+			{
+				next++;
+			}
+			size_t tokenLen = next - token;
+			POLLY_LOG_TRACE(m_logger, "Next token: {}", Narrow(token, tokenLen));
+			while (tokenLen > 1 && IsIn(token[0], L"(\"{'["))
+			{
+				items++;
+				token++;
+				tokenLen--;
+			}
+			items++;
+			const wchar_t* trail = next - 1;
+			while (tokenLen > 1 && (IsIn(*trail, L".!?") || IsIn(*trail, L",\";:)}']")))
+			{
+				wchar_t newstr[2] = { *trail, 0 };
+				POLLY_LOG_TRACE(m_logger, "Found trailing token: {}", Narrow(newstr, 1));
+				items++;
+				trail--;
+				tokenLen--;
+			}
+		}
+		return items;
+	}
+
+	long SpeechMarks(const std::vector<LogBenchMark>& marks, long streamSize,
+		const std::shared_ptr<spdlog::logger>& logger)
+	{
+		const auto& m_logger = logger;
+		const long bytesPerMs = 32;
+		std::vector<SpeechMark> speechMarks;
+		long bytesProcessed = 0;
+		for (const auto& mark : marks)
+		{
+			SpeechMark sm;
+			sm.StartInMs = mark.Time;
+			sm.StartByte = mark.Start;
+			sm.EndByte = mark.End;
+			sm.TimeInMs = 0;
+			sm.Text = mark.Value;
+			if (!speechMarks.empty())
+			{
+				auto& currentSm = speechMarks.back();
+				currentSm.TimeInMs = sm.StartInMs - currentSm.StartInMs;
+				currentSm.LengthInBytes = bytesPerMs * currentSm.TimeInMs;
+				bytesProcessed += currentSm.LengthInBytes;
+			}
+			POLLY_LOG_TRACE(m_logger, "Word: {}, Start: {}, End: {}, Time: {}", sm.Text, sm.StartInMs,
+				sm.EndByte, sm.TimeInMs);
+			speechMarks.push_back(sm);
+		}
+		if (!speechMarks.empty())
+		{
+			auto& sm = speechMarks.back();
+			sm.LengthInBytes = streamSize - bytesProcessed;
+			sm.TimeInMs = static_cast<int>(sm.LengthInBytes / bytesPerMs);
+			POLLY_LOG_TRACE(m_logger, "Word: {}, Start: {}, End: {}, Time: {}", sm.Text, sm.StartInMs,
+				sm.EndByte, sm.TimeInMs);
+		}
+		POLLY_LOG_DEBUG(m_logger, "Total words generated: {}", speechMarks.size());
+		return bytesProcessed;
+	}
+}
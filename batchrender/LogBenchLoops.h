@@ -0,0 +1,50 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "spdlog/spdlog.h"
+
+// The engine's two per-word logging loops, compiled twice by
+// pollylogbench: once with trace logging compiled in and once with the
+// release SPDLOG_ACTIVE_LEVEL, where POLLY_LOG_TRACE is compiled out.
+
+// One word mark, as read from Polly's speech-mark JSON
+struct LogBenchMark
+{
+	int Time;
+	int Start;
+	int End;
+	std::string Value;
+};
+
+// Trace lines compiled in, as in debug builds
+namespace LoggingCompiledIn
+{
+	// Splits text into tokens and their leading and trailing punctuation,
+	// as CTTSEngObj::AddNextSentenceItem does; returns the item count
+	size_t Tokenize(const std::wstring& text, const std::shared_ptr<spdlog::logger>& logger);
+	// Turns marks into word lengths, as PollyManager::GenerateSpeechMarks
+	// does after parsing; returns the bytes covered
+	long SpeechMarks(const std::vector<LogBenchMark>& marks, long streamSize,
+		const std::shared_ptr<spdlog::logger>& logger);
+}
+
+// Trace and debug lines compiled out, as in release builds
+namespace LoggingCompiledOut
+{
+	size_t Tokenize(const std::wstring& text, const std::shared_ptr<spdlog::logger>& logger);
+	long SpeechMarks(const std::vector<LogBenchMark>& marks, long streamSize,
+		const std::shared_ptr<spdlog::logger>& logger);
+}
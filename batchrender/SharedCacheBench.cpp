@@ -0,0 +1,191 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* SharedCacheBench.cpp:
+**   Runs several processes that speak the same prompts through one shared
+**   audio cache, and counts how many syntheses and resident copies of the
+**   audio that takes compared with a private cache per process.
+******************************************************************************/
+#include "PollySharedCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const long kCacheMb = 64;
+
+static std::string PromptKey(size_t prompt)
+{
+	return std::string("Joanna") + '\0' + "pcm16000" + '\0' + "Prompt number " + std::to_string(prompt);
+}
+
+// Stands in for the PCM that Polly would return
+static std::string PromptAudio(size_t prompt, size_t bytes)
+{
+	std::string audio(bytes, '\0');
+	for (size_t i = 0; i < bytes; i++)
+	{
+		audio[i] = static_cast<char>((prompt * 131 + i * 7) & 0xFF);
+	}
+	return audio;
+}
+
+// One engine process: speaks every prompt, in an order of its own, and
+// synthesizes only the ones no process has cached yet
+static int Worker(const std::string& path, int index, size_t prompts, size_t bytes, long synthesisMs)
+{
+	PollySharedCache cache(path, kCacheMb);
+	if (!cache.IsOpen())
+	{
+		fprintf(stderr, "%s\n", cache.Error().c_str());
+		return 1;
+	}
+	size_t syntheses = 0, hits = 0, corrupt = 0;
+	for (size_t n = 0; n < prompts; n++)
+	{
+		size_t prompt = (n * 7 + index * 13) % prompts;
+		auto expected = PromptAudio(prompt, bytes);
+		auto found = cache.Find(PromptKey(prompt));
+		if (found)
+		{
+			hits++;
+			corrupt += *found != expected;
+			continue;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(synthesisMs));
+		cache.Store(PromptKey(prompt), expected);
+		syntheses++;
+	}
+	std::ofstream(path + "." + std::to_string(index)) << syntheses << ' ' << hits << ' ' << corrupt;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t processes = 8;
+	size_t prompts = 200;
+	size_t bytes = 64 * 1024;
+	long synthesisMs = 20;
+	std::string path = "pollysharedcachebench.bin";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc)
+		{
+			int index = atoi(argv[++i]);
+			for (i++; i + 1 < argc; i += 2)
+			{
+				if (strcmp(argv[i], "--prompts") == 0) prompts = static_cast<size_t>(atol(argv[i + 1]));
+				else if (strcmp(argv[i], "--bytes") == 0) bytes = static_cast<size_t>(atol(argv[i + 1]));
+				else if (strcmp(argv[i], "--synthesis-ms") == 0) synthesisMs = atol(argv[i + 1]);
+				else if (strcmp(argv[i], "--file") == 0) path = argv[i + 1];
+			}
+			return Worker(path, index, prompts, bytes, synthesisMs);
+		}
+		else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc)
+		{
+			processes = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--prompts") == 0 && i + 1 < argc)
+		{
+			prompts = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc)
+		{
+			bytes = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--synthesis-ms") == 0 && i + 1 < argc)
+		{
+			synthesisMs = atol(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+		{
+			path = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollysharedcachebench [--processes N] [--prompts N] [--bytes N] "
+				"[--synthesis-ms N] [--file PATH]\n");
+			return 2;
+		}
+	}
+
+	std::remove(path.c_str());
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	std::atomic<int> failures(0);
+	for (size_t p = 0; p < processes; p++)
+	{
+		std::string command = std::string("\"") + argv[0] + "\" --worker " + std::to_string(p) +
+			" --prompts " + std::to_string(prompts) + " --bytes " + std::to_string(bytes) +
+			" --synthesis-ms " + std::to_string(synthesisMs) + " --file \"" + path + "\"";
+		workers.emplace_back([command, &failures]() {
+			if (std::system(command.c_str()) != 0)
+			{
+				failures++;
+			}
+		});
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t syntheses = 0, hits = 0, corrupt = 0;
+	for (size_t p = 0; p < processes; p++)
+	{
+		std::string result = path + "." + std::to_string(p);
+		size_t s = 0, h = 0, c = 0;
+		std::ifstream(result) >> s >> h >> c;
+		syntheses += s;
+		hits += h;
+		corrupt += c;
+		std::remove(result.c_str());
+	}
+
+	// Lookups per second from one process once the prompts are cached
+	PollySharedCache cache(path, kCacheMb);
+	std::vector<std::string> keys;
+	for (size_t prompt = 0; prompt < prompts; prompt++)
+	{
+		keys.push_back(PromptKey(prompt));
+	}
+	size_t cached = 0;
+	for (auto& key : keys)
+	{
+		cached += cache.Find(key) != nullptr;
+	}
+	size_t lookups = 0, found = 0;
+	auto lookupStart = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - lookupStart < std::chrono::seconds(1))
+	{
+		found += cache.Find(keys[lookups++ % keys.size()]) != nullptr;
+	}
+	double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lookupStart).count();
+
+	printf("%zu processes x %zu prompts of %zu bytes, %ld ms per synthesis\n", processes, prompts, bytes, synthesisMs);
+	printf("%-22s %12s %12s\n", "", "private", "shared");
+	printf("%-22s %12zu %12zu\n", "syntheses", processes * prompts, syntheses);
+	printf("%-22s %12zu %12zu\n", "cache hits", static_cast<size_t>(0), hits);
+	printf("%-22s %11.1fM %11.1fM\n", "resident audio", processes * prompts * bytes / 1048576.0,
+		cached * bytes / 1048576.0);
+	printf("run took %.2f s, %zu corrupt payloads, %d failed processes\n", seconds, corrupt, failures.load());
+	printf("%.0f lookups/s of %zu-byte payloads from one process (%zu of %zu found)\n",
+		lookups / lookupSeconds, bytes, found, lookups);
+	return corrupt == 0 && failures == 0 ? 0 : 1;
+}
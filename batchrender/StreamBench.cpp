@@ -0,0 +1,139 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* StreamBench.cpp:
+**   Measures the memory the streaming speech path needs for documents of
+**   growing length. Synthesis is simulated, so no AWS account is needed.
+******************************************************************************/
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <unistd.h>
+#endif
+#include "PollyExecutor.h"
+#include "PollySpeechStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+// Resident set size of this process, in bytes
+static size_t ResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	long pages = 0, resident = 0;
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm != nullptr)
+	{
+		if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+		{
+			resident = 0;
+		}
+		fclose(statm);
+	}
+	return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	// Polly PCM is 32,000 bytes a second, and speech runs at about 15
+	// characters a second
+	size_t bytesPerChar = 2000;
+	long latencyMs = 0;
+	size_t maxChars = 10 * 1024 * 1024;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bytes-per-char") == 0 && i + 1 < argc)
+		{
+			bytesPerChar = static_cast<size_t>(atol(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc)
+		{
+			latencyMs = atol(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--max-chars") == 0 && i + 1 < argc)
+		{
+			maxChars = static_cast<size_t>(atol(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollystreambench [--bytes-per-char N] [--latency-ms N] [--max-chars N]\n");
+			return 2;
+		}
+	}
+
+	// The document belongs to the caller (SAPI), so it is built and touched
+	// before the baseline is taken
+	static const wchar_t* sentence = L"The quick brown fox jumps over the lazy dog, again and again. ";
+	size_t sentenceLength = wcslen(sentence);
+	std::wstring document;
+	document.reserve(maxChars);
+	while (document.size() < maxChars)
+	{
+		document.append(sentence, std::min(sentenceLength, maxChars - document.size()));
+	}
+
+	PollySpeechStream stream([bytesPerChar, latencyMs](std::string text) -> PollyTask<PollySpeechResponse> {
+		if (latencyMs > 0)
+		{
+			co_await PollyExecutor::Shared().Delay(std::chrono::milliseconds(latencyMs));
+		}
+		PollySpeechResponse response;
+		response.AudioData = std::make_shared<const std::string>(text.size() * bytesPerChar, '\x01');
+		response.Length = static_cast<std::streamsize>(response.AudioData->size());
+		response.IsSuccess = true;
+		co_return response;
+	});
+
+	printf("%12s %8s %14s %16s %10s\n", "chars", "chunks", "audio MB", "peak growth MB", "seconds");
+	for (size_t chars = 1024; chars <= maxChars; chars *= 10)
+	{
+		size_t baseline = ResidentBytes();
+		size_t peak = baseline;
+		size_t chunks = 0;
+		uint64_t audioBytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::string error;
+		PollyCallerLoop speakThread;
+		bool succeeded = speakThread.Run(stream.Run(document.data(), chars,
+			[&](const PollySpeechResponse& audio, const wchar_t*, size_t) -> PollyTask<bool> {
+			// Stands in for SAPI taking the audio on the Speak thread
+			co_await speakThread.Schedule();
+			chunks++;
+			audioBytes += static_cast<uint64_t>(audio.Length);
+			peak = std::max(peak, ResidentBytes());
+			co_return true;
+		}, error));
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!succeeded)
+		{
+			fprintf(stderr, "Failed: %s\n", error.c_str());
+			return 1;
+		}
+		printf("%12zu %8zu %14.1f %16.1f %10.2f\n", chars, chunks, audioBytes / 1048576.0,
+			(peak - baseline) / 1048576.0, seconds);
+	}
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+/******************************************************************************
+* TrimBench.cpp:
+**   Trims synthetic responses with Polly-like leading and trailing silence
+**   and reports the silence removed, the gap left where two responses are
+**   joined, and the energy scan throughput with and without SSE2. It also
+**   checks that trimming in random pieces, as the streaming path does,
+**   gives the same audio as trimming the whole response.
+******************************************************************************/
+#include "PollySilenceTrim.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static void AppendSample(std::string& pcm, double value)
+{
+	int sample = static_cast<int>(std::max(-32768.0, std::min(32767.0, value)));
+	pcm.push_back(static_cast<char>(sample & 0xFF));
+	pcm.push_back(static_cast<char>((sample >> 8) & 0xFF));
+}
+
+// 16 kHz PCM: low noise, a stretch of speech-like harmonics, low noise
+static std::string SyntheticResponse(std::mt19937& random, double headMs, double speechMs, double tailMs)
+{
+	const int rate = 16000;
+	const double pi = 3.14159265358979;
+	std::normal_distribution<double> hiss(0, 20);
+	std::string pcm;
+	for (int i = 0; i < headMs * rate / 1000; i++)
+	{
+		AppendSample(pcm, hiss(random));
+	}
+	double pitch = 100 + random() % 120;
+	for (int i = 0; i < speechMs * rate / 1000; i++)
+	{
+		double t = static_cast<double>(i) / rate;
+		// Syllables fade in and out, down to near silence between them
+		double envelope = std::pow(std::sin(pi * 4 * t), 2);
+		double value = 0;
+		for (int harmonic = 1; harmonic <= 6; harmonic++)
+		{
+			value += std::sin(2 * pi * pitch * harmonic * t) * 5000 / harmonic;
+		}
+		AppendSample(pcm, value * envelope + hiss(random));
+	}
+	for (int i = 0; i < tailMs * rate / 1000; i++)
+	{
+		AppendSample(pcm, hiss(random));
+	}
+	return pcm;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t responses = 200;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--responses") == 0 && i + 1 < argc)
+		{
+			responses = static_cast<size_t>(atol(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: pollytrimbench [--responses N]\n");
+			return 2;
+		}
+	}
+
+	const double bytesPerMs = 32;
+	const uint32_t padMs = 50;
+	std::mt19937 random(11);
+	double headBefore = 0, tailBefore = 0, headAfter = 0, tailAfter = 0, seconds = 0;
+	bool same = true;
+	for (size_t r = 0; r < responses; r++)
+	{
+		double headMs = 80 + random() % 320, speechMs = 800 + random() % 2500, tailMs = 100 + random() % 500;
+		auto pcm = SyntheticResponse(random, headMs, speechMs, tailMs);
+		PollySilenceTrimmer whole(16000, -50, padMs);
+		auto trimmed = whole.Trim(pcm);
+
+		// The same response, arriving in pieces of random size
+		PollySilenceTrimmer streamed(16000, -50, padMs);
+		std::string pieces;
+		auto append = [&](const char* data, size_t size) {
+			pieces.append(data, size);
+			return true;
+		};
+		for (size_t at = 0; at < pcm.size();)
+		{
+			size_t size = std::min(pcm.size() - at, static_cast<size_t>(1 + random() % 5000));
+			streamed.Push(pcm.data() + at, size, append);
+			at += size;
+		}
+		streamed.Finish(append);
+		same = same && pieces == trimmed && streamed.TrimmedHeadMs() == whole.TrimmedHeadMs();
+
+		headBefore += headMs;
+		tailBefore += tailMs;
+		headAfter += headMs - whole.TrimmedHeadMs();
+		tailAfter += tailMs - (whole.TrimmedBytes() / bytesPerMs - whole.TrimmedHeadMs());
+		seconds += pcm.size() / bytesPerMs / 1000;
+	}
+	double n = static_cast<double>(responses);
+	printf("%zu responses, %.0f s of 16 kHz audio, threshold -50 dBFS, pad %u ms\n", responses, seconds, padMs);
+	printf("%-34s %10s %10s\n", "", "raw", "trimmed");
+	printf("%-34s %10.0f %10.0f\n", "leading silence, mean ms", headBefore / n, headAfter / n);
+	printf("%-34s %10.0f %10.0f\n", "trailing silence, mean ms", tailBefore / n, tailAfter / n);
+	printf("%-34s %10.0f %10.0f\n", "gap where two responses join, ms", (headBefore + tailBefore) / n,
+		(headAfter + tailAfter) / n);
+	printf("trimming in pieces %s trimming whole responses\n", same ? "matches" : "DOES NOT match");
+
+	std::string long16k = SyntheticResponse(random, 0, 60000, 0);
+	for (int simd = 0; simd < 2; simd++)
+	{
+		int rounds = 0;
+		uint64_t energy = 0;
+		auto start = std::chrono::steady_clock::now();
+		double elapsed = 0;
+		do
+		{
+			energy += PollySilenceTrimmer::Energy(long16k.data(), long16k.size() / 2, simd != 0);
+			rounds++;
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (elapsed < 1.0);
+		printf("energy scan, %-6s %8.0f MB/s, %8.0fx real time (checksum %llu)\n", simd ? "SSE2:" : "scalar:",
+			rounds * long16k.size() / elapsed / 1048576, rounds * 60 / elapsed,
+			static_cast<unsigned long long>(energy / rounds));
+	}
+	return same ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+#include "WavWriter.h"
+
+static const uint32_t HEADER_BYTES = 44;
+
+WavWriter::WavWriter(uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample)
+	: m_sampleRate(sampleRate), m_channels(channels), m_bitsPerSample(bitsPerSample), m_dataBytes(0)
+{
+}
+
+bool WavWriter::Open(const std::string& path)
+{
+	m_dataBytes = 0;
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file)
+	{
+		return false;
+	}
+	WriteHeader();
+	return m_file.good();
+}
+
+bool WavWriter::Write(const char* data, size_t size)
+{
+	m_file.write(data, static_cast<std::streamsize>(size));
+	m_dataBytes += static_cast<uint32_t>(size);
+	return m_file.good();
+}
+
+bool WavWriter::Close()
+{
+	// Chunks are padded to an even size
+	if (m_dataBytes % 2 != 0)
+	{
+		m_file.put(0);
+	}
+	m_file.seekp(0);
+	WriteHeader();
+	bool written = m_file.good();
+	m_file.close();
+	return written && !m_file.fail();
+}
+
+void WavWriter::WriteHeader()
+{
+	uint16_t blockAlign = static_cast<uint16_t>(m_channels * m_bitsPerSample / 8);
+	m_file.write("RIFF", 4);
+	Put32(HEADER_BYTES - 8 + m_dataBytes + m_dataBytes % 2);
+	m_file.write("WAVE", 4);
+	m_file.write("fmt ", 4);
+	Put32(16);
+	Put16(1); // PCM
+	Put16(m_channels);
+	Put32(m_sampleRate);
+	Put32(m_sampleRate * blockAlign);
+	Put16(blockAlign);
+	Put16(m_bitsPerSample);
+	m_file.write("data", 4);
+	Put32(m_dataBytes);
+}
+
+void WavWriter::Put16(uint16_t value)
+{
+	char bytes[2] = { static_cast<char>(value & 0xff), static_cast<char>(value >> 8) };
+	m_file.write(bytes, sizeof(bytes));
+}
+
+void WavWriter::Put32(uint32_t value)
+{
+	Put16(static_cast<uint16_t>(value & 0xffff));
+	Put16(static_cast<uint16_t>(value >> 16));
+}
@@ -0,0 +1,41 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Writes PCM audio to a WAV file as it arrives. The header is written with
+// empty sizes first and filled in by Close, so the audio never has to be
+// held in memory.
+class WavWriter
+{
+public:
+	WavWriter(uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample);
+
+	bool Open(const std::string& path);
+	bool Write(const char* data, size_t size);
+	// Fills in the RIFF and data chunk sizes and closes the file.
+	bool Close();
+
+private:
+	void WriteHeader();
+	void Put16(uint16_t value);
+	void Put32(uint32_t value);
+
+	std::ofstream m_file;
+	uint32_t m_sampleRate;
+	uint16_t m_channels;
+	uint16_t m_bitsPerSample;
+	uint32_t m_dataBytes;
+};
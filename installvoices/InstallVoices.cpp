@@ -17,34 +17,73 @@
 ******************************************************************************/
 #include "stdafx.h"
 #include <iostream>
-#include <PollyTTSEngine_i.c>
 #include <direct.h>
 #include "PollyTTSEngine.h"
 #include <aws/core/Aws.h>
 #include <aws/core/utils/Outcome.h>
 #include <aws/polly/model/DescribeVoicesRequest.h>
 #include <aws/polly/PollyClient.h>
-#include "VoiceForSapi.h"
+#include "SapiVoiceRegistry.h"
 #include <aws/core/auth/AWSCredentialsProvider.h>
+#include <aws/core/utils/StringUtils.h>
+#include <aws/polly/model/SynthesizeSpeechRequest.h>
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "PollyConfig.h"
+#include "PollyPhraseStore.h"
+#include "PollyCanonicalText.h"
+#include "PollyVoiceCatalog.h"
 
 
 using namespace Aws::Polly;
 
-typedef std::map<VoiceId, VoiceForSAPI> voice_map_t;
-typedef std::set<VoiceId> argument_set_t;
+using namespace Aws::Polly::Model;
 
-voice_map_t SelectedVoicesMap(std::wstring);
+// Voice names given on the command line, in lower case
+typedef std::set<std::wstring> argument_set_t;
+typedef std::vector<std::pair<VoiceId, std::wstring>> installed_voices_t;
+
+bool RefreshCatalog(bool);
+bool DesiredVoices(const argument_set_t&, std::vector<VoiceForSAPI>&);
 void PrintHelp(WCHAR*);
-int AddVoice(VoiceForSAPI);
-int RemoveVoice(WCHAR*);
 argument_set_t ArgumentSet(std::wstring);
+installed_voices_t InstalledVoices(std::wstring);
+std::vector<std::wstring> ReadPhrases(std::wstring);
+int WarmPhrases(std::wstring, std::wstring);
 Aws::String WStringToAwsString(const std::wstring& s);
 std::wstring AwsStringToWString(const Aws::String& s);
 
 int wmain(int argc, __in_ecount(argc) WCHAR* argv[])
 {
 	HRESULT hr = S_OK;
-	if (argc > 3 || argc < 2)
+	if (argc >= 2 && wcscmp(argv[1], L"warm") == 0 && argc <= 4)
+	{
+		CoInitialize(NULL);
+		std::wstring voiceList = argc >= 3 && wcscmp(argv[2], L"*") != 0 ? argv[2] : L"";
+		std::wstring phraseFile = argc == 4 ? argv[3] : L"";
+		if (!WarmPhrases(voiceList, phraseFile))
+		{
+			hr = E_FAIL;
+		}
+		CoUninitialize();
+	}
+	else if (argc == 2 && wcscmp(argv[1], L"refresh") == 0)
+	{
+		Aws::SDKOptions options;
+		InitAPI(options);
+		if (!RefreshCatalog(true))
+		{
+			hr = E_FAIL;
+		}
+		ShutdownAPI(options);
+	}
+	else if (argc > 3 || argc < 2)
 	{
 		PrintHelp(argv[0]);
 		hr = E_INVALIDARG;
@@ -53,39 +92,41 @@ int wmain(int argc, __in_ecount(argc) WCHAR* argv[])
 	{
 		CoInitialize(NULL);
 
-		std::wstring voiceList = L"";
-		if (argc == 3) {
-			voiceList = argv[2];
-		}
-
-		voice_map_t voices = SelectedVoicesMap(voiceList);
-
+		argument_set_t selected = ArgumentSet(argc == 3 ? argv[2] : L"");
+		SapiVoiceRegistry registry;
+		std::vector<VoiceForSAPI> desired;
+		std::vector<VoiceChange> changes;
 		if (wcscmp(argv[1], L"install") == 0)
-		{			
-			
-			for (auto& voice : voices)
+		{
+			if (DesiredVoices(selected, desired))
 			{
-				std::wcout << L"Installing " << voice.second.tokenKeyName << " - ";
-				std::wcout << voice.second.langIndependentName << std::endl;
-
-				AddVoice(voice.second);
-			}						
-		}
-		else if (wcscmp(argv[1], L"uninstall") == 0)
-		{			
-			for (auto& voice : voices)
+				// Only a full install removes the voices Polly no longer offers
+				changes = PlanInstall(desired, registry.List(), selected.empty());
+			}
+			else
 			{
-				std::wcout << L"Removing " << voice.second.tokenKeyName << " - ";
-				std::wcout << voice.second.langIndependentName << std::endl;
-
-				RemoveVoice(voice.second.tokenKeyName);
+				hr = E_FAIL;
 			}
 		}
+		else if (wcscmp(argv[1], L"uninstall") == 0)
+		{
+			changes = PlanUninstall(registry.List(), selected);
+		}
 		else {
 			PrintHelp(argv[0]);
 			hr = E_INVALIDARG;
 		}
 
+		if (SUCCEEDED(hr))
+		{
+			std::wcout << changes.size() << L" voice changes to apply" << std::endl;
+			size_t threads = (std::max)(1L, PollyConfig::GetLong("INSTALL_THREADS", 8));
+			if (ApplyChanges(registry, changes, threads) > 0)
+			{
+				hr = E_FAIL;
+			}
+		}
+
 		CoUninitialize();
 	}
 
@@ -98,100 +139,229 @@ void PrintHelp(WCHAR* exeName)
 	printf("Usage to install some voices   : > %ws install Joanna,Filiz\n", exeName);
 	printf("Usage to uninstall all voices : > %ws uninstall \n", exeName);
 	printf("Usage to uninstall some voices   : > %ws uninstall Joanna,Filiz\n", exeName);
+	printf("Usage to download the list of Polly voices again : > %ws refresh \n", exeName);
+	printf("Usage to pre-synthesize phrases for all installed voices : > %ws warm \n", exeName);
+	printf("Usage to pre-synthesize phrases for some voices : > %ws warm Joanna,Filiz [phrases.txt]\n", exeName);
+	printf("Usage to pre-synthesize a phrase file for all voices : > %ws warm * phrases.txt\n", exeName);
 }
 
 
-voice_map_t SelectedVoicesMap(std::wstring voiceList)
+// Refreshes the voice catalog from Polly when it is missing or older than
+// VOICE_CATALOG_TTL_HOURS, or always if `force` is set. Needs InitAPI.
+bool RefreshCatalog(bool force)
+{
+	auto& catalog = PollyVoiceCatalog::Instance();
+	if (!force && !catalog.IsStale())
+	{
+		return true;
+	}
+	Aws::Polly::PollyClient pc = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>("InstallVoices",
+		PollyConfig::GetString("PROFILE", "polly-windows").c_str());
+	std::string error;
+	if (!catalog.Refresh(pc, error))
+	{
+		std::cout << "Unable to refresh the voice catalog: " << error << std::endl;
+		return false;
+	}
+	std::cout << "Refreshed the voice catalog " << catalog.Path() << std::endl;
+	return true;
+}
+
+// The catalog voices named in `selected`, or all of them
+bool DesiredVoices(const argument_set_t& selected, std::vector<VoiceForSAPI>& voices)
 {
 	Aws::SDKOptions options;
 	InitAPI(options);
-	Aws::Polly::PollyClient pc = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>("InstallVoices", "polly-windows");
-	voice_map_t pollyVoices;
-	boolean isSelected(false);
-	boolean isAllSelected(voiceList.size() < 1);
-	DescribeVoicesRequest describeVoices;
-	
-	auto voicesOutcome = pc.DescribeVoices(describeVoices);
-	if (voicesOutcome.IsSuccess())
-	{
-		auto voiceSet = ArgumentSet(voiceList);
-		for (auto& voice : voicesOutcome.GetResult().GetVoices())
-		{
-			if (!isAllSelected && (voiceSet.find(voice.GetId()) != voiceSet.end())) {
-				isSelected = true;
-			}
-			if (isSelected || isAllSelected)
-			{
-				VoiceForSAPI v4sp(voice);
-				pollyVoices.insert(std::make_pair(voice.GetId(), v4sp));
-				isSelected = false;
-			}
-		}
-	}
-	else
+	// A catalog that could not be refreshed is still better than none
+	RefreshCatalog(false);
+	ShutdownAPI(options);
+	auto& catalog = PollyVoiceCatalog::Instance();
+	if (!catalog.IsLoaded())
 	{
 		std::cout << "Error while getting voices" << std::endl;
-		std::cout << voicesOutcome.GetError().GetMessageW();
+		return false;
 	}
-	ShutdownAPI(options);
-	return pollyVoices;
+	for (auto& voice : catalog.Voices())
+	{
+		std::wstring id(voice.Id.begin(), voice.Id.end());
+		std::transform(id.begin(), id.end(), id.begin(), towlower);
+		if (selected.empty() || selected.find(id) != selected.end())
+		{
+			voices.emplace_back(voice);
+		}
+	}
+	return true;
 }
 
-int AddVoice(VoiceForSAPI voiceForSapi)
+installed_voices_t InstalledVoices(std::wstring voiceList)
 {
-	HRESULT hr = S_OK;
+	installed_voices_t voices;
+	auto voiceSet = ArgumentSet(voiceList);
+	CComPtr<IEnumSpObjectTokens> cpEnum;
+	if (FAILED(SpEnumTokens(SPCAT_VOICES, L"Vendor=Amazon", NULL, &cpEnum)))
+	{
+		return voices;
+	}
+
 	CComPtr<ISpObjectToken> cpToken;
-	CComPtr<ISpDataKey> cpDataKeyAttribs;
-
-	hr = SpCreateNewTokenEx(
-		SPCAT_VOICES,
-		voiceForSapi.tokenKeyName,
-		&CLSID_PollyTTSEngine,
-		voiceForSapi.langDependentName,
-		voiceForSapi.langid,
-		voiceForSapi.langIndependentName,
-		&cpToken,
-		&cpDataKeyAttribs);
-
-	//--- Set additional attributes for searching and the path to the
-	//    voice data file we just created.
-	if (SUCCEEDED(hr))
-	{
-		hr = cpDataKeyAttribs->SetStringValue(L"Gender", voiceForSapi.gender);
-		if (SUCCEEDED(hr))
+	while (cpEnum->Next(1, &cpToken, NULL) == S_OK)
+	{
+		CComPtr<ISpDataKey> cpDataKeyAttribs;
+		CSpDynamicString voiceId;
+		CSpDynamicString description;
+		if (SUCCEEDED(cpToken->OpenKey(L"Attributes", &cpDataKeyAttribs)) &&
+			SUCCEEDED(cpDataKeyAttribs->GetStringValue(L"VoiceId", &voiceId)) &&
+			SUCCEEDED(SpGetDescription(cpToken, &description)))
 		{
-			hr = cpDataKeyAttribs->SetStringValue(L"Name", voiceForSapi.name);
+			VoiceId voice = VoiceIdMapper::GetVoiceIdForName(WStringToAwsString(voiceId.m_psz));
+			std::wstring name = voiceId.m_psz;
+			std::transform(name.begin(), name.end(), name.begin(), towlower);
+			if (voiceSet.empty() || voiceSet.find(name) != voiceSet.end())
+			{
+				voices.push_back(std::make_pair(voice, std::wstring(description.m_psz)));
+			}
 		}
-		if (SUCCEEDED(hr))
+		cpToken.Release();
+	}
+	return voices;
+}
+
+// Reads one phrase per line from a UTF-8 file. Empty lines and lines
+// starting with '#' are skipped.
+std::vector<std::wstring> ReadPhrases(std::wstring phraseFile)
+{
+	std::vector<std::wstring> phrases;
+	std::ifstream file(phraseFile);
+	std::string line;
+	while (getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
 		{
-			hr = cpDataKeyAttribs->SetStringValue(L"VoiceId", voiceForSapi.voiceId);
+			line.pop_back();
 		}
-		if (SUCCEEDED(hr))
+		if (line.empty() || line[0] == '#')
 		{
-			hr = cpDataKeyAttribs->SetStringValue(L"Language", voiceForSapi.languageText);
+			continue;
 		}
-		if (SUCCEEDED(hr))
+		int length = MultiByteToWideChar(CP_UTF8, 0, line.c_str(), (int)line.size(), NULL, 0);
+		std::wstring phrase(length, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, line.c_str(), (int)line.size(), &phrase[0], length);
+		phrases.push_back(phrase);
+	}
+	return phrases;
+}
+
+// Synthesizes one output of a phrase and writes it to the phrase store
+bool WarmPhrase(Aws::Polly::PollyClient& pc, VoiceId voice, const Aws::String& text, bool speechMarks,
+	Aws::String& error)
+{
+	// Stored under the same canonical text that the engine will look up
+	auto canonical = PollyCanonicalText::Canonicalize(text.c_str());
+	SynthesizeSpeechRequest request;
+	request.SetVoiceId(voice);
+	request.SetText(canonical.Text.c_str());
+	request.SetTextType(canonical.Ssml ? TextType::ssml : TextType::text);
+	request.SetSampleRate("16000");
+	if (speechMarks)
+	{
+		request.SetOutputFormat(OutputFormat::json);
+		request.AddSpeechMarkTypes(SpeechMarkType::word);
+	}
+	else
+	{
+		request.SetOutputFormat(OutputFormat::pcm);
+	}
+
+	auto outcome = pc.SynthesizeSpeech(request);
+	if (!outcome.IsSuccess())
+	{
+		error = outcome.GetError().GetMessageW();
+		return false;
+	}
+	std::ostringstream body;
+	body << outcome.GetResult().GetAudioStream().rdbuf();
+	auto key = PollyPhraseStore::Key(VoiceIdMapper::GetNameForVoiceId(voice).c_str(),
+		speechMarks ? PollyPhraseStore::MarksOutput : PollyPhraseStore::PcmOutput, canonical.Text);
+	if (!PollyPhraseStore::Instance().Store(key, body.str()))
+	{
+		error = "Unable to write to " + Aws::String(PollyPhraseStore::Instance().Directory().c_str());
+		return false;
+	}
+	return true;
+}
+
+// Pre-synthesizes the Control Panel preview sentence and the phrase file
+// (phrases.txt next to this program by default) for the installed voices,
+// so that the engine can play them without calling Polly.
+int WarmPhrases(std::wstring voiceList, std::wstring phraseFile)
+{
+	if (PollyPhraseStore::Instance().Directory().empty())
+	{
+		std::cout << "No phrase store directory is configured" << std::endl;
+		return 0;
+	}
+	if (phraseFile.empty())
+	{
+		WCHAR modulePath[MAX_PATH];
+		GetModuleFileNameW(NULL, modulePath, MAX_PATH);
+		phraseFile = modulePath;
+		phraseFile = phraseFile.substr(0, phraseFile.find_last_of(L"\\") + 1) + L"phrases.txt";
+	}
+	auto phrases = ReadPhrases(phraseFile);
+	auto voices = InstalledVoices(voiceList);
+	std::wcout << L"Pre-synthesizing " << phrases.size() + 1 << L" phrases for " << voices.size() << L" voices" << std::endl;
+
+	Aws::SDKOptions options;
+	InitAPI(options);
+	int succeeded = 1;
+	{
+		Aws::Polly::PollyClient pc = Aws::MakeShared<Aws::Auth::ProfileConfigFileAWSCredentialsProvider>("InstallVoices",
+			PollyConfig::GetString("PROFILE", "polly-windows").c_str());
+		std::atomic<size_t> nextVoice(0);
+		std::mutex outputLock;
+		auto worker = [&]()
+		{
+			for (size_t i = nextVoice++; i < voices.size(); i = nextVoice++)
+			{
+				auto& voice = voices[i];
+				// The sentence Control Panel speaks when a voice is selected
+				std::vector<std::wstring> voicePhrases = phrases;
+				voicePhrases.insert(voicePhrases.begin(),
+					L"You have selected " + voice.second + L" as the computer's default voice.");
+				for (auto& phrase : voicePhrases)
+				{
+					// Convert the same way the engine does, so that the keys match
+					auto text = Aws::Utils::StringUtils::FromWString(phrase.c_str());
+					Aws::String error;
+					bool warmed = WarmPhrase(pc, voice.first, text, false, error) &&
+						WarmPhrase(pc, voice.first, text, true, error);
+					if (!warmed)
+					{
+						std::lock_guard<std::mutex> guard(outputLock);
+						std::wcout << L"Unable to pre-synthesize '" << phrase << L"' for " << voice.second << L": ";
+						std::cout << error << std::endl;
+						succeeded = 0;
+					}
+				}
+				std::lock_guard<std::mutex> guard(outputLock);
+				std::wcout << L"Pre-synthesized phrases for " << voice.second << std::endl;
+			}
+		};
+
+		size_t threadCount = std::min<size_t>(voices.size(),
+			(std::max)(1L, PollyConfig::GetLong("WARM_THREADS", 8)));
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threadCount; i++)
 		{
-			hr = cpDataKeyAttribs->SetStringValue(L"Age", voiceForSapi.age);
+			threads.emplace_back(worker);
 		}
-		if (SUCCEEDED(hr))
+		for (auto& thread : threads)
 		{
-			hr = cpDataKeyAttribs->SetStringValue(L"Vendor", voiceForSapi.vendor);
+			thread.join();
 		}
 	}
-	return SUCCEEDED(hr);
-}
-
-int RemoveVoice(WCHAR* tokenKeyName)
-{
-	std::wstring subKey;
-	subKey = L"SOFTWARE\\Microsoft\\Speech\\Voices\\Tokens\\";
-	subKey += tokenKeyName;
-	long result = SHDeleteKey(HKEY_LOCAL_MACHINE, subKey.c_str());
-	if (result == ERROR_SUCCESS) {
-		return SUCCEEDED(S_OK);
-	}
-	return FAILED(result);
+	ShutdownAPI(options);
+	return succeeded;
 }
 
 argument_set_t ArgumentSet(std::wstring str)
@@ -205,8 +375,8 @@ argument_set_t ArgumentSet(std::wstring str)
 	{
 		std::wstring subStr;
 		getline(wss, subStr, L',');
-		VoiceId voice = VoiceIdMapper::GetVoiceIdForName(WStringToAwsString(subStr));
-		argSet.insert(voice);
+		std::transform(subStr.begin(), subStr.end(), subStr.begin(), towlower);
+		argSet.insert(subStr);
 	}
 	return argSet;
 }
@@ -0,0 +1,133 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#include "stdafx.h"
+#include <PollyTTSEngine_i.c>
+#include "PollyTTSEngine.h"
+#include "SapiVoiceRegistry.h"
+
+namespace
+{
+	const wchar_t* kTokensKey = L"SOFTWARE\\Microsoft\\Speech\\Voices\\Tokens\\";
+}
+
+registered_voices_t SapiVoiceRegistry::List()
+{
+	registered_voices_t voices;
+	CComPtr<IEnumSpObjectTokens> cpEnum;
+	if (FAILED(SpEnumTokens(SPCAT_VOICES, L"Vendor=Amazon", NULL, &cpEnum)))
+	{
+		return voices;
+	}
+
+	CComPtr<ISpObjectToken> cpToken;
+	while (cpEnum->Next(1, &cpToken, NULL) == S_OK)
+	{
+		CSpDynamicString tokenId;
+		if (SUCCEEDED(cpToken->GetId(&tokenId)))
+		{
+			std::wstring key = tokenId.m_psz;
+			RegisteredVoice& voice = voices[key.substr(key.find_last_of(L'\\') + 1)];
+			CSpDynamicString description;
+			if (SUCCEEDED(cpToken->GetStringValue(NULL, &description)))
+			{
+				voice.Description = description.m_psz;
+			}
+			CComPtr<ISpDataKey> cpDataKeyAttribs;
+			if (SUCCEEDED(cpToken->OpenKey(L"Attributes", &cpDataKeyAttribs)))
+			{
+				for (int i = static_cast<int>(VoiceForSAPI::FirstAttribute); i < VoiceForSAPI::FieldCount; i++)
+				{
+					const wchar_t* name = VoiceForSAPI::AttributeName(static_cast<VoiceForSAPI::Field>(i));
+					CSpDynamicString value;
+					if (SUCCEEDED(cpDataKeyAttribs->GetStringValue(name, &value)))
+					{
+						voice.Attributes[name] = value.m_psz;
+					}
+				}
+			}
+		}
+		cpToken.Release();
+	}
+	return voices;
+}
+
+bool SapiVoiceRegistry::Add(const VoiceForSAPI& voice)
+{
+	HRESULT hr = S_OK;
+	CComPtr<ISpObjectToken> cpToken;
+	CComPtr<ISpDataKey> cpDataKeyAttribs;
+
+	hr = SpCreateNewTokenEx(
+		SPCAT_VOICES,
+		voice.tokenKeyName(),
+		&CLSID_PollyTTSEngine,
+		voice.description(),
+		voice.LangId(),
+		voice.description(),
+		&cpToken,
+		&cpDataKeyAttribs);
+
+	//--- Set additional attributes for searching
+	for (int i = static_cast<int>(VoiceForSAPI::FirstAttribute); SUCCEEDED(hr) && i < VoiceForSAPI::FieldCount; i++)
+	{
+		auto field = static_cast<VoiceForSAPI::Field>(i);
+		hr = cpDataKeyAttribs->SetStringValue(VoiceForSAPI::AttributeName(field), voice.Get(field));
+	}
+	return SUCCEEDED(hr);
+}
+
+bool SapiVoiceRegistry::Update(const VoiceForSAPI& voice, const std::vector<VoiceForSAPI::Field>& fields)
+{
+	CComPtr<ISpObjectToken> cpToken;
+	std::wstring tokenId = std::wstring(SPCAT_VOICES) + L"\\Tokens\\" + voice.tokenKeyName();
+	HRESULT hr = SpGetTokenFromId(tokenId.c_str(), &cpToken);
+	CComPtr<ISpDataKey> cpDataKeyAttribs;
+	if (SUCCEEDED(hr))
+	{
+		hr = cpToken->OpenKey(L"Attributes", &cpDataKeyAttribs);
+	}
+	for (size_t i = 0; SUCCEEDED(hr) && i < fields.size(); i++)
+	{
+		if (fields[i] == VoiceForSAPI::Field::Description)
+		{
+			// The default value, and the one named after the language id
+			wchar_t langHex[8];
+			swprintf_s(langHex, L"%X", voice.LangId());
+			hr = cpToken->SetStringValue(NULL, voice.description());
+			if (SUCCEEDED(hr))
+			{
+				hr = cpToken->SetStringValue(langHex, voice.description());
+			}
+		}
+		else
+		{
+			hr = cpDataKeyAttribs->SetStringValue(VoiceForSAPI::AttributeName(fields[i]), voice.Get(fields[i]));
+		}
+	}
+	return SUCCEEDED(hr);
+}
+
+bool SapiVoiceRegistry::Remove(const std::wstring& tokenKeyName)
+{
+	return SHDeleteKey(HKEY_LOCAL_MACHINE, (kTokensKey + tokenKeyName).c_str()) == ERROR_SUCCESS;
+}
+
+void SapiVoiceRegistry::BeginThread()
+{
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+}
+
+void SapiVoiceRegistry::EndThread()
+{
+	CoUninitialize();
+}
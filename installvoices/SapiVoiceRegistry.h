@@ -0,0 +1,28 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include "VoiceRegistry.h"
+
+// Voice tokens under SPCAT_VOICES in HKEY_LOCAL_MACHINE. Each worker thread
+// joins the multithreaded COM apartment.
+class SapiVoiceRegistry : public IVoiceRegistry
+{
+public:
+	registered_voices_t List() override;
+	bool Add(const VoiceForSAPI& voice) override;
+	bool Update(const VoiceForSAPI& voice, const std::vector<VoiceForSAPI::Field>& fields) override;
+	bool Remove(const std::wstring& tokenKeyName) override;
+
+	void BeginThread() override;
+	void EndThread() override;
+};
@@ -11,26 +11,49 @@ or implied.See the License for the specific language governing
 permissions and limitations under the License. */
 
 #pragma once
-#include "aws/polly/model/Voice.h"	
-
-using namespace Aws::Polly::Model;
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "PollyVoiceInfo.h"
 
+// Everything SAPI needs to register one Polly voice. The strings are kept
+// back to back in one buffer, so a descriptor is a single allocation that
+// copies and frees like any value.
 class VoiceForSAPI
 {
-	std::pair<int, const wchar_t*> GetVoiceHexValue(LanguageCode code);
-	static wchar_t* AWSStringToWchar(Aws::String);
 public:
-	WCHAR * tokenKeyName;
-	const WCHAR * langIndependentName;
-	const WCHAR * langDependentName;
-	WORD langid; 
-	const WCHAR * gender = L"NOT_SET";
-	const WCHAR * name;
-	const WCHAR * voiceId;
-	const WCHAR * languageText;
-	const WCHAR * age;
-	const WCHAR * vendor = L"Amazon";
-
-	VoiceForSAPI(Aws::Polly::Model::Voice);
+	enum class Field
+	{
+		TokenKeyName,  // TTS_AMZN_EN-US_JOANNA
+		Description,   // Amazon Polly Joanna - US English
+		// Values under the token's Attributes key
+		Gender,
+		Name,
+		VoiceId,
+		Language,
+		Age,
+		Vendor,
+		Count
+	};
+	static const Field FirstAttribute = Field::Gender;
+	static const int FieldCount = static_cast<int>(Field::Count);
+
+	explicit VoiceForSAPI(const PollyVoiceInfo& voice);
+
+	const wchar_t* Get(Field field) const { return m_strings.c_str() + m_offsets[static_cast<int>(field)]; }
+	// Value name under Attributes, or nullptr for a field that is not an attribute
+	static const wchar_t* AttributeName(Field field);
+	uint16_t LangId() const { return m_langId; }
+
+	const wchar_t* tokenKeyName() const { return Get(Field::TokenKeyName); }
+	const wchar_t* description() const { return Get(Field::Description); }
+
 	void PrintVoice() const;
-};
\ No newline at end of file
+
+private:
+	void Set(Field field, const std::wstring& value);
+
+	std::wstring m_strings;
+	size_t m_offsets[FieldCount];
+	uint16_t m_langId;
+};
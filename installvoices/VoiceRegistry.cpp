@@ -0,0 +1,229 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#include "VoiceRegistry.h"
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+	RegisteredVoice AsRegistered(const VoiceForSAPI& voice)
+	{
+		RegisteredVoice registered;
+		registered.Description = voice.description();
+		for (int i = static_cast<int>(VoiceForSAPI::FirstAttribute); i < VoiceForSAPI::FieldCount; i++)
+		{
+			auto field = static_cast<VoiceForSAPI::Field>(i);
+			registered.Attributes[VoiceForSAPI::AttributeName(field)] = voice.Get(field);
+		}
+		return registered;
+	}
+}
+
+InMemoryVoiceRegistry::InMemoryVoiceRegistry(std::chrono::microseconds writeLatency)
+	: m_writeLatency(writeLatency), m_writes(0)
+{
+}
+
+void InMemoryVoiceRegistry::Write()
+{
+	if (m_writeLatency.count() > 0)
+	{
+		std::this_thread::sleep_for(m_writeLatency);
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_writes++;
+}
+
+registered_voices_t InMemoryVoiceRegistry::List()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_voices;
+}
+
+bool InMemoryVoiceRegistry::Add(const VoiceForSAPI& voice)
+{
+	// The token with its description, then each attribute, as SAPI does
+	for (int i = static_cast<int>(VoiceForSAPI::FirstAttribute) - 1; i < VoiceForSAPI::FieldCount; i++)
+	{
+		Write();
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_voices[voice.tokenKeyName()] = AsRegistered(voice);
+	return true;
+}
+
+bool InMemoryVoiceRegistry::Update(const VoiceForSAPI& voice, const std::vector<VoiceForSAPI::Field>& fields)
+{
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		Write();
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_voices.find(voice.tokenKeyName());
+	if (found == m_voices.end())
+	{
+		return false;
+	}
+	for (auto field : fields)
+	{
+		if (field == VoiceForSAPI::Field::Description)
+		{
+			found->second.Description = voice.description();
+		}
+		else
+		{
+			found->second.Attributes[VoiceForSAPI::AttributeName(field)] = voice.Get(field);
+		}
+	}
+	return true;
+}
+
+bool InMemoryVoiceRegistry::Remove(const std::wstring& tokenKeyName)
+{
+	Write();
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_voices.erase(tokenKeyName) > 0;
+}
+
+size_t InMemoryVoiceRegistry::Writes() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_writes;
+}
+
+std::vector<VoiceChange> PlanInstall(const std::vector<VoiceForSAPI>& desired, const registered_voices_t& registered,
+	bool removeOthers)
+{
+	std::vector<VoiceChange> changes;
+	std::map<std::wstring, const VoiceForSAPI*> wanted;
+	for (auto& voice : desired)
+	{
+		wanted[voice.tokenKeyName()] = &voice;
+		auto found = registered.find(voice.tokenKeyName());
+		if (found == registered.end())
+		{
+			changes.push_back(VoiceChange{ VoiceChange::Add, voice.tokenKeyName(), &voice, {} });
+			continue;
+		}
+
+		VoiceChange update{ VoiceChange::Update, voice.tokenKeyName(), &voice, {} };
+		if (found->second.Description != voice.description())
+		{
+			update.Fields.push_back(VoiceForSAPI::Field::Description);
+		}
+		for (int i = static_cast<int>(VoiceForSAPI::FirstAttribute); i < VoiceForSAPI::FieldCount; i++)
+		{
+			auto field = static_cast<VoiceForSAPI::Field>(i);
+			auto value = found->second.Attributes.find(VoiceForSAPI::AttributeName(field));
+			if (value == found->second.Attributes.end() || value->second != voice.Get(field))
+			{
+				update.Fields.push_back(field);
+			}
+		}
+		if (!update.Fields.empty())
+		{
+			changes.push_back(update);
+		}
+	}
+	if (removeOthers)
+	{
+		for (auto& voice : registered)
+		{
+			if (wanted.find(voice.first) == wanted.end())
+			{
+				changes.push_back(VoiceChange{ VoiceChange::Remove, voice.first, nullptr, {} });
+			}
+		}
+	}
+	return changes;
+}
+
+std::vector<VoiceChange> PlanUninstall(const registered_voices_t& registered, const std::set<std::wstring>& voiceIds)
+{
+	std::vector<VoiceChange> changes;
+	for (auto& voice : registered)
+	{
+		auto id = voice.second.Attributes.find(VoiceForSAPI::AttributeName(VoiceForSAPI::Field::VoiceId));
+		std::wstring name = id != voice.second.Attributes.end() ? id->second : L"";
+		std::transform(name.begin(), name.end(), name.begin(), towlower);
+		if (voiceIds.empty() || voiceIds.find(name) != voiceIds.end())
+		{
+			changes.push_back(VoiceChange{ VoiceChange::Remove, voice.first, nullptr, {} });
+		}
+	}
+	return changes;
+}
+
+size_t ApplyChanges(IVoiceRegistry& registry, const std::vector<VoiceChange>& changes, size_t threads,
+	bool print)
+{
+	std::atomic<size_t> next(0);
+	std::atomic<size_t> failed(0);
+	std::mutex outputLock;
+	auto worker = [&]()
+	{
+		registry.BeginThread();
+		for (size_t i = next++; i < changes.size(); i = next++)
+		{
+			auto& change = changes[i];
+			bool applied = false;
+			const wchar_t* action = L"";
+			switch (change.What)
+			{
+			case VoiceChange::Add:
+				action = L"Installing ";
+				applied = registry.Add(*change.Voice);
+				break;
+			case VoiceChange::Update:
+				action = L"Updating ";
+				applied = registry.Update(*change.Voice, change.Fields);
+				break;
+			case VoiceChange::Remove:
+				action = L"Removing ";
+				applied = registry.Remove(change.TokenKeyName);
+				break;
+			}
+			if (!applied)
+			{
+				failed++;
+			}
+			if (!print)
+			{
+				continue;
+			}
+			std::lock_guard<std::mutex> guard(outputLock);
+			std::wcout << action << change.TokenKeyName;
+			if (change.Voice != nullptr)
+			{
+				std::wcout << L" - " << change.Voice->description();
+			}
+			std::wcout << (applied ? L"" : L" failed") << std::endl;
+		}
+		registry.EndThread();
+	};
+
+	size_t threadCount = std::min(changes.size(), std::max<size_t>(threads, 1));
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+	return failed.load();
+}
@@ -0,0 +1,99 @@
+/*  Copyright 2017 - 2018 Amazon.com, Inc. or its affiliates.All Rights Reserved.
+Licensed under the Amazon Software License(the "License").You may not use
+this file except in compliance with the License.A copy of the License is
+located at
+
+http://aws.amazon.com/asl/
+
+and in the "LICENSE" file accompanying this file.This file is distributed
+on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, express
+or implied.See the License for the specific language governing
+permissions and limitations under the License. */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "VoiceForSapi.h"
+
+// A voice token as it is registered: its description and the values under
+// its Attributes key.
+struct RegisteredVoice
+{
+	std::wstring Description;
+	std::map<std::wstring, std::wstring> Attributes;
+};
+
+// Registered Amazon voices by token key name
+typedef std::map<std::wstring, RegisteredVoice> registered_voices_t;
+
+// Where voice tokens are registered. SapiVoiceRegistry writes the SAPI
+// token registry; InMemoryVoiceRegistry keeps them in a map, for trying
+// out installs on any platform. Add, Update and Remove may be called from
+// several threads at once.
+class IVoiceRegistry
+{
+public:
+	virtual ~IVoiceRegistry() {}
+
+	virtual registered_voices_t List() = 0;
+	virtual bool Add(const VoiceForSAPI& voice) = 0;
+	// Rewrites the given fields of a voice that is already registered
+	virtual bool Update(const VoiceForSAPI& voice, const std::vector<VoiceForSAPI::Field>& fields) = 0;
+	virtual bool Remove(const std::wstring& tokenKeyName) = 0;
+
+	// Called on each worker thread before its first change and after its last
+	virtual void BeginThread() {}
+	virtual void EndThread() {}
+};
+
+class InMemoryVoiceRegistry : public IVoiceRegistry
+{
+public:
+	// Each value written waits `writeLatency`, to stand in for the registry
+	explicit InMemoryVoiceRegistry(std::chrono::microseconds writeLatency = std::chrono::microseconds(0));
+
+	registered_voices_t List() override;
+	bool Add(const VoiceForSAPI& voice) override;
+	bool Update(const VoiceForSAPI& voice, const std::vector<VoiceForSAPI::Field>& fields) override;
+	bool Remove(const std::wstring& tokenKeyName) override;
+
+	size_t Writes() const;
+
+private:
+	void Write();
+
+	std::chrono::microseconds m_writeLatency;
+	mutable std::mutex m_lock;
+	registered_voices_t m_voices;
+	size_t m_writes;
+};
+
+// One change to the registered voices
+struct VoiceChange
+{
+	enum Kind { Add, Update, Remove };
+
+	Kind What;
+	std::wstring TokenKeyName;
+	const VoiceForSAPI* Voice;                  // Not set for Remove
+	std::vector<VoiceForSAPI::Field> Fields;    // Changed fields, for Update
+};
+
+// Changes that make `registered` match `desired`. Registered voices that
+// are not desired are removed only if `removeOthers` is set.
+std::vector<VoiceChange> PlanInstall(const std::vector<VoiceForSAPI>& desired, const registered_voices_t& registered,
+	bool removeOthers);
+
+// Removals of the registered voices whose VoiceId is in `voiceIds` (lower
+// case), or of every registered voice if it is empty.
+std::vector<VoiceChange> PlanUninstall(const registered_voices_t& registered, const std::set<std::wstring>& voiceIds);
+
+// Applies `changes` on up to `threads` threads, printing each one if
+// `print` is set. Returns the number of changes that failed.
+size_t ApplyChanges(IVoiceRegistry& registry, const std::vector<VoiceChange>& changes, size_t threads,
+	bool print = true);